@@ -14,6 +14,9 @@
 
 #pragma once
 
+// meson options, the build directory is on the include path
+#include "../../config.h"
+
 //---- Define assertion handler. Defaults to calling assert().
 // If your macro uses multiple statements, make sure is enclosed in a 'do { .. } while (0)' block so it can be used as a single statement.
 //#define IM_ASSERT(_EXPR)  MyAssert(_EXPR)
@@ -117,6 +120,85 @@
 // Another way to allow large meshes while keeping 16-bit indices is to handle ImDrawCmd::VtxOffset in your renderer.
 // Read about ImGuiBackendFlags_RendererHasVtxOffset for details.
 //#define ImDrawIdx unsigned int
+#if E_IMGUI_INDEX32
+#define ImDrawIdx unsigned int
+#endif
+
+//---- Compact 12 byte vertex, half float position and 16 bit fixed point uv.
+// The renderer reads the layout from the formats the imgui layer reports.
+// Half floats hold every half pixel up to 1024 and every pixel up to 2048,
+// positions past that snap to 2 pixels, so keep this to small framebuffers.
+#if E_COMPACT_VERTICES
+#include <string.h>
+
+struct EHalf {
+    unsigned short bits;
+    EHalf() = default;
+    EHalf(float f) {
+        unsigned int x;
+        memcpy(&x, &f, sizeof(x));
+        unsigned int sign = (x >> 16) & 0x8000u;
+        x &= 0x7fffffffu;
+        if (x >= 0x47800000u) {  // past 65504, inf or nan
+            unsigned int inf = x > 0x7f800000u ? 0x7e00u : 0x7c00u;
+            bits = (unsigned short)(sign | inf);
+        }
+        else if (x < 0x38800000u) {  // subnormal, far below a pixel
+            bits = (unsigned short)sign;
+        }
+        else {
+            // rebias the exponent and round to nearest even
+            x += 0xc8000fffu + ((x >> 13) & 1u);
+            bits = (unsigned short)(sign | (x >> 13));
+        }
+    }
+    operator float() const {
+        unsigned int sign = (bits & 0x8000u) << 16;
+        unsigned int exp = (bits >> 10) & 0x1fu;
+        unsigned int mant = bits & 0x3ffu;
+        unsigned int x;
+        if (exp == 0) {
+            float f = (float)mant * (1.0f / 16777216.0f);
+            return sign ? -f : f;
+        }
+        if (exp == 31) {
+            x = sign | 0x7f800000u | (mant << 13);
+        }
+        else {
+            x = sign | ((exp + 112) << 23) | (mant << 13);
+        }
+        float f;
+        memcpy(&f, &x, sizeof(f));
+        return f;
+    }
+};
+
+struct EUnorm16 {
+    unsigned short bits;
+    EUnorm16() = default;
+    EUnorm16(float f)
+        : bits(f <= 0.0f   ? (unsigned short)0
+               : f >= 1.0f ? (unsigned short)65535
+                           : (unsigned short)(f * 65535.0f + 0.5f)) {}
+    operator float() const { return (float)bits * (1.0f / 65535.0f); }
+};
+
+// imgui writes and reads pos and uv as ImVec2 and through .x and .y, the
+// metrics window prints the raw bits of a vertex
+#define IMGUI_OVERRIDE_DRAWVERT_STRUCT_LAYOUT                                   \
+    template <typename T> struct EVertVec2 {                                    \
+        T x, y;                                                                 \
+        EVertVec2() = default;                                                  \
+        EVertVec2(float xIn, float yIn) : x(xIn), y(yIn) {}                     \
+        EVertVec2(const ImVec2& v) : x(v.x), y(v.y) {}                          \
+        operator ImVec2() const { return ImVec2(x, y); }                        \
+    };                                                                          \
+    struct ImDrawVert {                                                         \
+        EVertVec2<EHalf> pos;                                                   \
+        EVertVec2<EUnorm16> uv;                                                 \
+        ImU32 col;                                                              \
+    }
+#endif
 
 //---- Override ImDrawCallback signature (will need to modify renderer backends accordingly)
 //struct ImDrawList;
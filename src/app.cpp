@@ -2,26 +2,82 @@
 
 #include "context.h"
 #include "display.h"
+#include "heap.h"
+#include "renderer.h"
 #include "window.h"
 
 #include "imgui_layer.hpp"
+#include "record_benchmark.hpp"
+#include "resize_benchmark.hpp"
 
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <imgui.h>
 #include <iostream>
+#include <stdexcept>
 
 #include <string>
 
+namespace {
+void Check(void* any) {
+    if (eGetResult(any) != E_SUCCESS) {
+        throw std::runtime_error(std::to_string(eGetResult(any)));
+    }
+}
+
+#if E_VERBOSE_MESSAGING
+// Process CPU time per wall second, printed every few seconds and on the
+// first wake up after a longer sleep. An idle window should stay near 0%.
+struct CpuUsage {
+    std::chrono::steady_clock::time_point start;
+    EDisplayStats stats;
+};
+
+void ReportCpuUsage(EDisplay display, CpuUsage* usage) {
+    auto now = std::chrono::steady_clock::now();
+    std::chrono::duration<double> seconds = now - usage->start;
+    if (seconds.count() < 5.0) {
+        return;
+    }
+    EDisplayStats stats{};
+    eGetDisplayStats(display, &stats);
+    double cpu = static_cast<double>(
+      stats.processCpuNanoseconds - usage->stats.processCpuNanoseconds);
+    (void)std::printf("CPU %.1f%% of a core over %.1f s, %llu frames rendered, "
+                      "%llu skipped\n",
+      cpu / 1e7 / seconds.count(),
+      seconds.count(),
+      static_cast<unsigned long long>(
+        stats.renderedFrames - usage->stats.renderedFrames),
+      static_cast<unsigned long long>(
+        stats.skippedFrames - usage->stats.skippedFrames));
+    usage->start = now;
+    usage->stats = stats;
+}
+#endif
+}  // namespace
 
 App::App(AppCreateInfo& info) {
     (void)std::cout;
-    auto Check = [](void* any) {
-        if (eGetResult(any) != E_SUCCESS) {
-            throw std::exception(std::to_string(eGetResult(any)).c_str());
-        }
-    };
+#if E_ALLOC_CHECK
+    // installed before anything allocates, so every block carries its scope
+    EHostTrackerCreateInfo htci{};
+    eCreateHostTracker(&m_tracker, &htci);
+    Check(m_tracker);
+    eSetHostAllocator(eGetHostTrackerAllocator(m_tracker));
+#endif
+    if (info.headlessFrames > 0) {
+        RunHeadless(info);
+        return;
+    }
 
     EWindowCreateInfo wci{};
     wci.title = info.title;
     wci.size = { info.size.width, info.size.height };
+    wci.presentMode = info.presentMode;
+    wci.frameRateLimit = info.frameRateLimit;
+    wci.framesInFlight = info.framesInFlight;
     eCreateWindow(&m_window, &wci);
     Check(m_window);
 
@@ -33,34 +89,184 @@ App::App(AppCreateInfo& info) {
 
     eBeginImgui(m_display, m_context, m_window);
 
+#if E_RESIZE_BENCHMARK
+    ResizeBenchmark benchmark(m_window);
+#endif
+#if E_RECORD_BENCHMARK
+    RecordBenchmark recordBenchmark(m_window, m_display, eGetImguiRenderer());
+#endif
+#if E_VERBOSE_MESSAGING
+    CpuUsage cpuUsage{ std::chrono::steady_clock::now(), {} };
+    eGetDisplayStats(m_display, &cpuUsage.stats);
+#endif
+
     while (!static_cast<bool>(eWindowShouldClose(m_window))) {
-        ePollEvents();
+#if E_RESIZE_BENCHMARK
+        benchmark.Step();
+#endif
+        // only spin while something changed, otherwise sleep until an
+        // event, a producer's ePostWakeUp() or the next imgui animation step
+        if (static_cast<bool>(eWindowIsDirty(m_window))) {
+            eBeginCpuPhase(m_display, E_CPU_PHASE_POLL);
+            ePollEvents();
+            eEndCpuPhase(m_display, E_CPU_PHASE_POLL);
+        }
+        else {
+            eWaitEvents(m_window, eGetImguiWaitTimeout());
+        }
         if (static_cast<bool>(eWindowShouldResize(m_window))) {
             eResizeWindow(m_display, m_context, m_window);
             Check(m_display);
         }
         if (static_cast<bool>(eWindowIsMinimized(m_window))) {
+            eWaitEvents(m_window, -1.0);
             continue;
         }
 
+        eBeginCpuPhase(m_display, E_CPU_PHASE_BUILD);
         eDrawImgui(m_display, m_context, m_window);
+        eEndCpuPhase(m_display, E_CPU_PHASE_BUILD);
+#if E_RECORD_BENCHMARK
+        recordBenchmark.Step();
+#endif
+        eWindowFrameBuilt(m_window);
 
+        // a frame submitted after a suboptimal acquire is still presented,
+        // the swapchain is recreated at the top of the next iteration
         if (!static_cast<bool>(eWindowShouldResize(m_window))) {
             eRenderFrame(m_display, m_context, m_window);
             Check(m_display);
+            eDisplayFrame(m_display, m_context, m_window);
+            Check(m_display);
         }
 
-        if (!static_cast<bool>(eWindowShouldResize(m_window))) {
-            eDisplayFrame(m_display, m_context);
-            Check(m_display);
+        ePaceFrame(m_window);
+#if E_VERBOSE_MESSAGING
+        ReportCpuUsage(m_display, &cpuUsage);
+#endif
+    }
+}
+
+// No window, surface or GLFW, so it runs on CI machines without a display
+// server, with lavapipe standing in for the GPU.
+void App::RunHeadless(const AppCreateInfo& info) {
+    auto startup = std::chrono::steady_clock::now();
+    eCreateHeadlessContext(&m_context);
+    Check(m_context);
+
+    EOffscreenDisplayCreateInfo odci{};
+    odci.width = info.size.width;
+    odci.height = info.size.height;
+    odci.framesInFlight = info.framesInFlight;
+    eCreateOffscreenDisplay(&m_display, m_context, &odci);
+    Check(m_display);
+
+    eBeginImgui(m_display, m_context, nullptr);
+    std::chrono::duration<double, std::milli> startupMs =
+      std::chrono::steady_clock::now() - startup;
+
+#if E_ALLOC_CHECK
+    // the first frames grow the draw storage and upload the font, after that
+    // only the driver may allocate
+    const uint32_t warmUpFrames = std::min(8u, info.headlessFrames / 2);
+    const uint32_t steadyScopes = ((1u << E_MEMORY_SCOPE_COUNT) - 1)
+      & ~(1u << E_MEMORY_SCOPE_VULKAN);
+#endif
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < info.headlessFrames; ++i) {
+#if E_ALLOC_CHECK
+        if (i == warmUpFrames) {
+            eExpectNoHostAllocations(m_tracker, steadyScopes);
         }
+#endif
+        eBeginCpuPhase(m_display, E_CPU_PHASE_BUILD);
+        eDrawImgui(m_display, m_context, nullptr);
+        eEndCpuPhase(m_display, E_CPU_PHASE_BUILD);
+        eRenderFrame(m_display, m_context, nullptr);
+        Check(m_display);
+        eDisplayFrame(m_display, m_context, nullptr);
+        Check(m_display);
+    }
+    eWaitForQueues(m_context);
+    std::chrono::duration<double> seconds =
+      std::chrono::steady_clock::now() - start;
+
+    (void)std::printf("Rendered %u frames offscreen in %.3f s, %.1f frames/s\n",
+      info.headlessFrames,
+      seconds.count(),
+      static_cast<double>(info.headlessFrames) / seconds.count());
+
+    ERendererStats stats{};
+    eGetRendererStats(eGetImguiRenderer(), &stats);
+    // run twice, the first run against a deleted cache file, to compare a
+    // cold start with one that finds the pipeline cache
+    (void)std::printf("Started in %.1f ms, %.1f ms of it building pipelines\n",
+      startupMs.count(),
+      static_cast<double>(stats.pipelineCreateNanoseconds) / 1e6);
+
+    // compare builds with and without the index32 and compact-vertices
+    // options, all frames draw the same demo so the last one stands for all
+    (void)std::printf("%zu byte vertices, %zu byte indices: %.1f KiB uploaded "
+                      "per frame, %u draws for %u commands\n",
+      sizeof(ImDrawVert),
+      sizeof(ImDrawIdx),
+      static_cast<double>(stats.bytesUploaded)
+        / static_cast<double>(info.headlessFrames) / 1024.0,
+      stats.frameDraws,
+      stats.frameDrawCmds);
+
+    EMemoryStats memory{};
+    eGetMemoryStats(m_context, &memory);
+    (void)std::printf("%u allocations in %u blocks, %.1f of %.1f MiB used, "
+                      "%u dedicated allocations\n",
+      memory.allocationCount,
+      memory.blockCount,
+      static_cast<double>(memory.allocatedBytes) / (1024.0 * 1024.0),
+      static_cast<double>(memory.blockBytes) / (1024.0 * 1024.0),
+      memory.dedicatedCount);
+
+    EMemoryBudget budget{};
+    eGetMemoryBudget(m_context, &budget);
+    (void)std::printf("%.1f of %.1f MiB device local memory budget used%s, "
+                      "%u textures evicted\n",
+      static_cast<double>(budget.usage) / (1024.0 * 1024.0),
+      static_cast<double>(budget.budget) / (1024.0 * 1024.0),
+      budget.estimated ? " (estimated)" : "",
+      stats.texturesEvicted);
+
+#if E_ALLOC_CHECK
+    eExpectNoHostAllocations(m_tracker, 0);
+    static const char* const scopeNames[E_MEMORY_SCOPE_COUNT] = {
+        "context", "window", "display", "renderer", "texture", "vulkan", "imgui"
+    };
+    EHostMemoryStats host{};
+    eGetHostMemoryStats(m_tracker, &host);
+    for (uint32_t i = 0; i < E_MEMORY_SCOPE_COUNT; ++i) {
+        (void)std::printf("%-8s %8.1f KiB in %llu blocks, %llu allocations\n",
+          scopeNames[i],
+          static_cast<double>(host.bytes[i]) / 1024.0,
+          static_cast<unsigned long long>(host.count[i]),
+          static_cast<unsigned long long>(host.allocations[i]));
     }
+    if (host.unexpectedAllocations != 0) {
+        (void)std::printf("%llu host allocations in steady state frames\n",
+          static_cast<unsigned long long>(host.unexpectedAllocations));
+        throw std::runtime_error(
+          std::to_string(E_UNEXPECTED_HOST_ALLOCATION));
+    }
+#endif
 }
 
 App::~App() {
-    eEndImgui(m_context);
     eWaitForQueues(m_context);
+    eEndImgui(m_context);
     eDestroyDisplay(m_display, m_context);
     eDestroyContext(m_context);
-    eDestroyWindow(m_window);
+    if (m_window != nullptr) {
+        eDestroyWindow(m_window);
+    }
+#if E_ALLOC_CHECK
+    eSetHostAllocator(nullptr);
+    eDestroyHostTracker(m_tracker);
+#endif
 }
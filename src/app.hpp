@@ -7,6 +7,12 @@ struct AppCreateInfo {
         int width;
         int height;
     } size{};
+    EPresentMode presentMode{ E_PRESENT_MODE_FIFO };
+    double frameRateLimit{ 0.0 };
+    uint32_t framesInFlight{ 0 };
+    // renders this many frames offscreen as fast as possible and reports
+    // the frame rate instead of opening a window, 0 opens the window
+    uint32_t headlessFrames{ 0 };
 };
 
 class App {
@@ -20,7 +26,12 @@ public:
     auto operator=(App&&) noexcept -> App& = default;
 
 private:
+    void RunHeadless(const AppCreateInfo& info);
+
     EWindow m_window{ nullptr };
     EContext m_context{ nullptr };
     EDisplay m_display{ nullptr };
+#if E_ALLOC_CHECK
+    EHostTracker m_tracker{ nullptr };
+#endif
 };
@@ -0,0 +1,479 @@
+#include "atlas.h"
+
+#include "core.h"
+#include "renderer.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define STBRP_STATIC
+#define STB_RECT_PACK_IMPLEMENTATION
+#include "imstb_rectpack.h"
+
+
+// one node per column is what stb_rect_pack wants for best results
+struct EAtlasPacker {
+    stbrp_context context;
+    stbrp_node nodes[];
+};
+
+static void AddPage(EIconAtlas atlas);
+static int RepackPage(EIconAtlas atlas,
+  uint32_t pageIndex,
+  uint32_t width,
+  uint32_t height,
+  uint32_t* xOut,
+  uint32_t* yOut);
+static uint32_t AcquireIconId(EIconAtlas atlas);
+static void CopyIcon(unsigned char* dst,
+  const unsigned char* src,
+  uint32_t pageSize,
+  uint32_t dstX,
+  uint32_t dstY,
+  uint32_t srcX,
+  uint32_t srcY,
+  uint32_t srcPitch,
+  uint32_t width,
+  uint32_t height);
+static void UpdatePage(EIconAtlas atlas, EContext context, uint32_t index);
+static int EvictPage(void* userData, ETexture texture);
+
+E_EXTERN void eCreateIconAtlas(EIconAtlas* atlasOut,
+  EIconAtlasCreateInfo* infoIn) {
+    if (!atlasOut) {
+        return;
+    }
+    EIconAtlas atlas = eAlloc(sizeof(*atlas), E_MEMORY_SCOPE_TEXTURE);
+    if (!atlas) {
+        *atlasOut = NULL;
+        return;
+    }
+    *atlasOut = atlas;
+    *atlas = (struct EIconAtlas_t){ 0 };
+    if (!infoIn) {
+        atlas->result = E_CREATE_INFO_MISSING;
+        return;
+    }
+    if (!infoIn->renderer) {
+        atlas->result = E_CREATE_INFO_MISSING_VALUE;
+        return;
+    }
+    atlas->renderer = infoIn->renderer;
+    atlas->pageSize =
+      infoIn->pageSize ? infoIn->pageSize : E_DEFAULT_ATLAS_PAGE_SIZE;
+}
+
+// Page textures may still be drawn, they are retired behind the frames in
+// flight like any other replaced texture.
+E_EXTERN void eDestroyIconAtlas(EIconAtlas atlas, EContext context) {
+    if (!atlas) {
+        return;
+    }
+    for (uint32_t i = 0; i < atlas->pageCount; ++i) {
+        struct EAtlasPage* page = &atlas->pages[i];
+        eRetireTexture(page->shown, atlas->renderer, context);
+        eRetireTexture(page->pending, atlas->renderer, context);
+        eFree(page->packer);
+        eFree(page->pixels);
+    }
+    eFree(atlas->icons);
+    eFree(atlas);
+}
+
+// Packs a tightly packed RGBA8 image into the first page with room for it.
+// When none has, the page with the most space left behind by removed icons
+// is repacked, and only then a new page is started. The icon can be drawn
+// once eGetIconUv says so, after eUpdateIconAtlas uploaded its page.
+E_EXTERN EResult eAddIcon(EIconAtlas atlas,
+  const void* pixels,
+  uint32_t width,
+  uint32_t height,
+  uint32_t* idOut) {
+    *idOut = 0;
+    if (atlas->result != E_SUCCESS) {
+        return atlas->result;
+    }
+    if (!pixels || !width || !height) {
+        return E_CREATE_INFO_MISSING_VALUE;
+    }
+    uint32_t paddedWidth = width + 2 * E_ATLAS_PADDING;
+    uint32_t paddedHeight = height + 2 * E_ATLAS_PADDING;
+    if (paddedWidth > atlas->pageSize || paddedHeight > atlas->pageSize) {
+        return E_ATLAS_FULL;
+    }
+
+    uint32_t pageIndex = { 0 };
+    uint32_t x = { 0 };
+    uint32_t y = { 0 };
+    int packed = { 0 };
+    for (uint32_t i = 0; i < atlas->pageCount && !packed; ++i) {
+        packed = ePackRect(
+          atlas->pages[i].packer, paddedWidth, paddedHeight, &x, &y);
+        pageIndex = i;
+    }
+    if (!packed) {
+        uint64_t mostDead = { 0 };
+        for (uint32_t i = 0; i < atlas->pageCount; ++i) {
+            if (atlas->pages[i].deadArea > mostDead) {
+                mostDead = atlas->pages[i].deadArea;
+                pageIndex = i;
+            }
+        }
+        if (mostDead) {
+            packed =
+              RepackPage(atlas, pageIndex, paddedWidth, paddedHeight, &x, &y);
+        }
+    }
+    if (!packed && atlas->pageCount < E_MAX_ATLAS_PAGES) {
+        AddPage(atlas);
+        if (atlas->result != E_SUCCESS) {
+            return atlas->result;
+        }
+        pageIndex = atlas->pageCount - 1;
+        packed = ePackRect(
+          atlas->pages[pageIndex].packer, paddedWidth, paddedHeight, &x, &y);
+    }
+    if (!packed) {
+        return E_ATLAS_FULL;
+    }
+
+    uint32_t id = AcquireIconId(atlas);
+    if (!id) {
+        return E_MALLOC_FAILURE;
+    }
+    struct EAtlasPage* page = &atlas->pages[pageIndex];
+    atlas->icons[id] = (struct EAtlasIcon){
+        .live = 1,
+        .page = pageIndex,
+        .x = x + E_ATLAS_PADDING,
+        .y = y + E_ATLAS_PADDING,
+        .width = width,
+        .height = height,
+    };
+    CopyIcon(page->pixels,
+      pixels,
+      atlas->pageSize,
+      atlas->icons[id].x,
+      atlas->icons[id].y,
+      0,
+      0,
+      width,
+      width,
+      height);
+    page->liveCount++;
+    page->dirty = 1;
+    *idOut = id;
+    return E_SUCCESS;
+}
+
+// The space is reclaimed by the next repack of the page, or right away when
+// it was the last icon on it.
+E_EXTERN void eRemoveIcon(EIconAtlas atlas, uint32_t id) {
+    if (!id || id >= atlas->iconCapacity || !atlas->icons[id].live) {
+        return;
+    }
+    struct EAtlasIcon* icon = &atlas->icons[id];
+    struct EAtlasPage* page = &atlas->pages[icon->page];
+    page->liveCount--;
+    page->deadArea += (uint64_t)(icon->width + 2 * E_ATLAS_PADDING)
+                      * (icon->height + 2 * E_ATLAS_PADDING);
+    if (page->liveCount == 0) {
+        eResetRectPacker(page->packer, atlas->pageSize);
+        memset(page->pixels, 0, (size_t)atlas->pageSize * atlas->pageSize * 4);
+        page->deadArea = 0;
+    }
+    *icon = (struct EAtlasIcon){ .nextFree = atlas->firstFree };
+    atlas->firstFree = id;
+}
+
+// Starts uploads of pages that changed and switches pages whose upload
+// finished over to the new texture. Call once per frame before the UV of
+// any icon is looked up.
+E_EXTERN void eUpdateIconAtlas(EIconAtlas atlas, EContext context) {
+    for (uint32_t i = 0; i < atlas->pageCount; ++i) {
+        UpdatePage(atlas, context, i);
+    }
+}
+
+// Returns 0 while the icon is not drawable yet, uvOut is left untouched.
+// Icons of a page the renderer evicted come back with the next
+// eUpdateIconAtlas after the first lookup.
+E_EXTERN int eGetIconUv(EIconAtlas atlas, uint32_t id, EIconUv* uvOut) {
+    if (!id || id >= atlas->iconCapacity) {
+        return 0;
+    }
+    const struct EAtlasIcon* icon = &atlas->icons[id];
+    struct EAtlasPage* page = &atlas->pages[icon->page];
+    if (icon->live && page->evicted) {
+        page->evicted = 0;
+        page->dirty = 1;
+    }
+    if (!icon->live || !icon->shown) {
+        return 0;
+    }
+    float size = (float)atlas->pageSize;
+    uvOut->textureId = eGetTextureId(atlas->pages[icon->page].shown);
+    uvOut->uv0[0] = (float)icon->shownX / size;
+    uvOut->uv0[1] = (float)icon->shownY / size;
+    uvOut->uv1[0] = (float)(icon->shownX + icon->width) / size;
+    uvOut->uv1[1] = (float)(icon->shownY + icon->height) / size;
+    return 1;
+}
+
+// Square pages only, NULL when out of memory.
+E_EXTERN void* eCreateRectPacker(uint32_t pageSize) {
+    struct EAtlasPacker* packer = eAlloc(
+      sizeof(*packer) + sizeof(stbrp_node) * pageSize, E_MEMORY_SCOPE_TEXTURE);
+    if (!packer) {
+        return NULL;
+    }
+    eResetRectPacker(packer, pageSize);
+    return packer;
+}
+
+// forgets every rect packed so far
+E_EXTERN void eResetRectPacker(void* packerIn, uint32_t pageSize) {
+    struct EAtlasPacker* packer = packerIn;
+    stbrp_init_target(&packer->context,
+      (int)pageSize,
+      (int)pageSize,
+      packer->nodes,
+      (int)pageSize);
+}
+
+// Leaves the packer as it was when the rect doesn't fit.
+E_EXTERN int ePackRect(void* packerIn,
+  uint32_t width,
+  uint32_t height,
+  uint32_t* xOut,
+  uint32_t* yOut) {
+    struct EAtlasPacker* packer = packerIn;
+    stbrp_rect rect = {
+        .w = (stbrp_coord)width,
+        .h = (stbrp_coord)height,
+    };
+    if (!stbrp_pack_rects(&packer->context, &rect, 1)) {
+        return 0;
+    }
+    *xOut = (uint32_t)rect.x;
+    *yOut = (uint32_t)rect.y;
+    return 1;
+}
+
+static void AddPage(EIconAtlas atlas) {
+    if (atlas->result != E_SUCCESS) {
+        return;
+    }
+    struct EAtlasPage* page = &atlas->pages[atlas->pageCount];
+    *page = (struct EAtlasPage){ 0 };
+    page->packer = eCreateRectPacker(atlas->pageSize);
+    page->pixels = eCalloc(
+      (size_t)atlas->pageSize * atlas->pageSize, 4, E_MEMORY_SCOPE_TEXTURE);
+    if (!page->packer || !page->pixels) {
+        eFree(page->packer);
+        eFree(page->pixels);
+        *page = (struct EAtlasPage){ 0 };
+        atlas->result = E_MALLOC_FAILURE;
+        return;
+    }
+    atlas->pageCount++;
+}
+
+// Packs the live icons of the page together with the new rect from scratch,
+// all at once since stb_rect_pack does better sorting a whole set by height.
+// On success the icons are moved in the page pixels, the page textures keep
+// their old layout until the next upload replaced them.
+static int RepackPage(EIconAtlas atlas,
+  uint32_t pageIndex,
+  uint32_t width,
+  uint32_t height,
+  uint32_t* xOut,
+  uint32_t* yOut) {
+    struct EAtlasPage* page = &atlas->pages[pageIndex];
+    uint32_t rectCount = { page->liveCount + 1 };
+    stbrp_rect* rects =
+      eAlloc(sizeof(*rects) * rectCount, E_MEMORY_SCOPE_TEXTURE);
+    struct EAtlasPacker* packer = eCreateRectPacker(atlas->pageSize);
+    unsigned char* pixels = eCalloc(
+      (size_t)atlas->pageSize * atlas->pageSize, 4, E_MEMORY_SCOPE_TEXTURE);
+    int packed = { rects && packer && pixels };
+
+    if (packed) {
+        uint32_t count = { 0 };
+        for (uint32_t id = 1; id < atlas->iconCapacity; ++id) {
+            const struct EAtlasIcon* icon = &atlas->icons[id];
+            if (icon->live && icon->page == pageIndex) {
+                rects[count++] = (stbrp_rect){
+                    .id = (int)id,
+                    .w = (stbrp_coord)(icon->width + 2 * E_ATLAS_PADDING),
+                    .h = (stbrp_coord)(icon->height + 2 * E_ATLAS_PADDING),
+                };
+            }
+        }
+        rects[count] = (stbrp_rect){
+            .w = (stbrp_coord)width,
+            .h = (stbrp_coord)height,
+        };
+        packed = stbrp_pack_rects(&packer->context, rects, (int)rectCount);
+    }
+    if (packed) {
+        for (uint32_t i = 0; i + 1 < rectCount; ++i) {
+            struct EAtlasIcon* icon = &atlas->icons[rects[i].id];
+            uint32_t x = (uint32_t)rects[i].x + E_ATLAS_PADDING;
+            uint32_t y = (uint32_t)rects[i].y + E_ATLAS_PADDING;
+            CopyIcon(pixels,
+              page->pixels,
+              atlas->pageSize,
+              x,
+              y,
+              icon->x,
+              icon->y,
+              atlas->pageSize,
+              icon->width,
+              icon->height);
+            icon->x = x;
+            icon->y = y;
+        }
+        *xOut = (uint32_t)rects[rectCount - 1].x;
+        *yOut = (uint32_t)rects[rectCount - 1].y;
+
+        eFree(page->packer);
+        eFree(page->pixels);
+        page->packer = packer;
+        page->pixels = pixels;
+        page->deadArea = 0;
+        page->dirty = 1;
+        packer = NULL;
+        pixels = NULL;
+    }
+    eFree(rects);
+    eFree(packer);
+    eFree(pixels);
+    return packed;
+}
+
+// Reuses the ids of removed icons first, 0 when out of memory.
+static uint32_t AcquireIconId(EIconAtlas atlas) {
+    if (atlas->firstFree) {
+        uint32_t id = { atlas->firstFree };
+        atlas->firstFree = atlas->icons[id].nextFree;
+        return id;
+    }
+    // id 0 stays unused, it means no icon
+    uint32_t used = atlas->iconCapacity ? atlas->iconCapacity : 1;
+    uint32_t capacity = atlas->iconCapacity ? atlas->iconCapacity * 2 : 64;
+    struct EAtlasIcon* icons =
+      eRealloc(atlas->icons, sizeof(*icons) * capacity, E_MEMORY_SCOPE_TEXTURE);
+    if (!icons) {
+        return 0;
+    }
+    memset(icons + used, 0, sizeof(*icons) * (capacity - used));
+    atlas->icons = icons;
+    atlas->iconCapacity = capacity;
+    // chain the new slots past the one handed out now
+    for (uint32_t id = capacity - 1; id > used; --id) {
+        icons[id].nextFree = atlas->firstFree;
+        atlas->firstFree = id;
+    }
+    return used;
+}
+
+static void CopyIcon(unsigned char* dst,
+  const unsigned char* src,
+  uint32_t pageSize,
+  uint32_t dstX,
+  uint32_t dstY,
+  uint32_t srcX,
+  uint32_t srcY,
+  uint32_t srcPitch,
+  uint32_t width,
+  uint32_t height) {
+    for (uint32_t row = 0; row < height; ++row) {
+        memcpy(dst + ((size_t)(dstY + row) * pageSize + dstX) * 4,
+          src + ((size_t)(srcY + row) * srcPitch + srcX) * 4,
+          (size_t)width * 4);
+    }
+}
+
+// A page has at most one upload in flight. The icons remember where they
+// were when it started, so the page can be repacked meanwhile and the
+// uploaded texture still gets drawn with the layout it was made from.
+static void UpdatePage(EIconAtlas atlas, EContext context, uint32_t index) {
+    if (atlas->result != E_SUCCESS) {
+        return;
+    }
+    struct EAtlasPage* page = &atlas->pages[index];
+
+    if (page->pending) {
+        EResult res = eGetResult(page->pending);
+        if (res != E_SUCCESS) {
+            atlas->result = res;
+            return;
+        }
+        if (!eTextureIsReady(page->pending)) {
+            return;
+        }
+        eRetireTexture(page->shown, atlas->renderer, context);
+        page->shown = page->pending;
+        page->pending = NULL;
+        for (uint32_t id = 1; id < atlas->iconCapacity; ++id) {
+            struct EAtlasIcon* icon = &atlas->icons[id];
+            if (icon->live && icon->page == index) {
+                icon->shown = icon->inPending;
+                icon->shownX = icon->pendingX;
+                icon->shownY = icon->pendingY;
+                icon->inPending = 0;
+            }
+        }
+    }
+
+    if (!page->dirty) {
+        return;
+    }
+    ETextureCreateInfo tci = {
+        .pixels = page->pixels,
+        .width = atlas->pageSize,
+        .height = atlas->pageSize,
+        .evict = EvictPage,
+        .evictUserData = atlas,
+    };
+    eCreateTexture(&page->pending, atlas->renderer, context, &tci);
+    if (!page->pending) {
+        atlas->result = E_MALLOC_FAILURE;
+        return;
+    }
+    page->dirty = 0;
+    page->evicted = 0;
+    for (uint32_t id = 1; id < atlas->iconCapacity; ++id) {
+        struct EAtlasIcon* icon = &atlas->icons[id];
+        if (icon->live && icon->page == index) {
+            icon->inPending = 1;
+            icon->pendingX = icon->x;
+            icon->pendingY = icon->y;
+        }
+    }
+}
+
+// The renderer takes back a shown page that wasn't drawn for a while, the
+// pixels stay and are uploaded again once an icon of the page is looked up.
+// A pending texture is about to be shown, it stays.
+static int EvictPage(void* userData, ETexture texture) {
+    EIconAtlas atlas = userData;
+    for (uint32_t i = 0; i < atlas->pageCount; ++i) {
+        struct EAtlasPage* page = &atlas->pages[i];
+        if (page->shown != texture) {
+            continue;
+        }
+        page->shown = NULL;
+        // a pending upload brings the page back by itself
+        page->evicted = !page->pending;
+        for (uint32_t id = 1; id < atlas->iconCapacity; ++id) {
+            struct EAtlasIcon* icon = &atlas->icons[id];
+            if (icon->live && icon->page == i) {
+                icon->shown = 0;
+            }
+        }
+        return 1;
+    }
+    return 0;
+}
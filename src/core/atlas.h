@@ -0,0 +1,15 @@
+#pragma once
+
+#include "../graphics.h"
+
+E_EXTERN void eCreateIconAtlas(EIconAtlas* atlasOut,
+  EIconAtlasCreateInfo* infoIn);
+E_EXTERN void eDestroyIconAtlas(EIconAtlas atlas, EContext context);
+E_EXTERN EResult eAddIcon(EIconAtlas atlas,
+  const void* pixels,
+  uint32_t width,
+  uint32_t height,
+  uint32_t* idOut);
+E_EXTERN void eRemoveIcon(EIconAtlas atlas, uint32_t id);
+E_EXTERN void eUpdateIconAtlas(EIconAtlas atlas, EContext context);
+E_EXTERN int eGetIconUv(EIconAtlas atlas, uint32_t id, EIconUv* uvOut);
@@ -26,45 +26,150 @@ static void DestroyDebugUtilsMessengerEXT(VkInstance instance,
 
 static void SelectPhysicalDevice(EContext context);
 static void SelectGraphicsQueueFamilyIndex(EContext context);
+static void SelectDeviceFeatures(EContext context);
 static void CreateLogicalDevice(EContext context);
+static void CreateTimelines(EContext context);
+static void CreateUploadSlots(EContext context);
+static void CreatePipelineCache(EContext context);
+static void SavePipelineCache(EContext context);
 static void CreateInstance(EContext context);
 
 
-// VkInstance initialization
-E_EXTERN void eCreateContext(EContext* contextOut) {
+static void CreateContext(EContext* contextOut, int headless) {
     if (!contextOut) {
         return;
     }
-    EContext context = malloc(sizeof(*context));
+    EContext context = eAlloc(sizeof(*context), E_MEMORY_SCOPE_CONTEXT);
     if (!context) {
         *contextOut = NULL;
         return;
     }
     *contextOut = context;
     *context = (struct EContext_t){ 0 };
+    context->vkAllocator = eGetVkAllocator();
+    context->headless = headless;
 
     CreateInstance(context);
     SelectPhysicalDevice(context);
     SelectGraphicsQueueFamilyIndex(context);
+    SelectDeviceFeatures(context);
     CreateLogicalDevice(context);
+    eCreateAllocator(context);
+    CreateTimelines(context);
+    CreateUploadSlots(context);
+    CreatePipelineCache(context);
+}
+
+// VkInstance initialization
+E_EXTERN void eCreateContext(EContext* contextOut) {
+    CreateContext(contextOut, 0);
+}
+
+// Without any WSI extension, for offscreen displays only. Doesn't need GLFW
+// or a display server, so it also runs on a software rasterizer on CI.
+E_EXTERN void eCreateHeadlessContext(EContext* contextOut) {
+    CreateContext(contextOut, 1);
 }
 
 // cleanup
 E_EXTERN void eDestroyContext(EContext context) {
-    free(context->exts);
+    SavePipelineCache(context);
+    vkDestroyPipelineCache(
+      context->device, context->pipelineCache, context->vkAllocator);
+    for (uint32_t i = 0; i < E_UPLOAD_SLOTS; ++i) {
+        eDestroyStreamBuffer(context, &context->uploads[i].staging);
+        vkDestroyFence(
+          context->device, context->uploads[i].fence, context->vkAllocator);
+    }
+    vkDestroyCommandPool(
+      context->device, context->uploadCommandPool, context->vkAllocator);
+    vkDestroySemaphore(context->device,
+      context->graphicsTimeline.semaphore,
+      context->vkAllocator);
+    vkDestroySemaphore(context->device,
+      context->transferTimeline.semaphore,
+      context->vkAllocator);
+    eFree(context->exts);
 #if E_ENABLE_ERROR_CALLBACK
     DestroyDebugUtilsMessengerEXT(
-      context->instance, context->debugMessenger, NULL);
+      context->instance, context->debugMessenger, context->vkAllocator);
 #endif
-    vkDestroyDevice(context->device, NULL);
-    vkDestroyInstance(context->instance, NULL);
-    free(context);
+    eDestroyAllocator(context);
+    vkDestroyDevice(context->device, context->vkAllocator);
+    vkDestroyInstance(context->instance, context->vkAllocator);
+    eFree(context);
 }
 
 E_EXTERN void eWaitForQueues(EContext context) {
     vkDeviceWaitIdle(context->device);
 }
 
+E_EXTERN uint32_t eFindMemoryType(EContext context,
+  uint32_t typeBits,
+  uint32_t propertyFlags) {
+    const VkPhysicalDeviceMemoryProperties* props =
+      &context->allocator.properties;
+    for (uint32_t i = 0; i < props->memoryTypeCount; ++i) {
+        if ((typeBits & (1u << i))
+            && (props->memoryTypes[i].propertyFlags & propertyFlags)
+                 == propertyFlags) {
+            return i;
+        }
+    }
+    return UINT32_MAX;
+}
+
+// Grows the buffer geometrically so that steady state users never allocate.
+// The old buffer is destroyed right away, the caller guarantees the GPU no
+// longer uses it.
+E_EXTERN EResult eReserveStreamBuffer(EContext context,
+  struct EStreamBuffer* stream,
+  VkDeviceSize size,
+  VkBufferUsageFlags usage) {
+    if (stream->size >= size) {
+        return E_SUCCESS;
+    }
+    VkResult err = { 0 };
+
+    VkDeviceSize newSize = { stream->size ? stream->size : 64 * 1024 };
+    while (newSize < size) {
+        newSize *= 2;
+    }
+    eDestroyStreamBuffer(context, stream);
+
+    VkBufferCreateInfo bci = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .size = newSize,
+        .usage = usage,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+    };
+    err = vkCreateBuffer(
+      context->device, &bci, context->vkAllocator, &stream->buffer);
+    if (err != VK_SUCCESS) {
+        return E_CREATE_BUFFER_FAILURE;
+    }
+
+    // host visible memory is always mapped by the allocator
+    EResult result = eAllocateBufferMemory(context,
+      stream->buffer,
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
+        | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+      &stream->allocation);
+    if (result != E_SUCCESS) {
+        return result;
+    }
+    stream->mapped = stream->allocation.mapped;
+    stream->size = newSize;
+    return E_SUCCESS;
+}
+
+E_EXTERN void
+  eDestroyStreamBuffer(EContext context, struct EStreamBuffer* stream) {
+    vkDestroyBuffer(context->device, stream->buffer, context->vkAllocator);
+    eFreeMemory(context, &stream->allocation);
+    *stream = (struct EStreamBuffer){ 0 };
+}
+
 static void SelectGraphicsQueueFamilyIndex(EContext context) {
     if (context->result != E_SUCCESS) {
         return;
@@ -72,20 +177,194 @@ static void SelectGraphicsQueueFamilyIndex(EContext context) {
     uint32_t count = { 0 };
     vkGetPhysicalDeviceQueueFamilyProperties(
       context->physicalDevice, &count, NULL);
-    VkQueueFamilyProperties* props = malloc(sizeof(*props) * count);
+    VkQueueFamilyProperties* props =
+      eAlloc(sizeof(*props) * count, E_MEMORY_SCOPE_CONTEXT);
     if (!props) {
         context->result = E_MALLOC_FAILURE;
         return;
     }
     vkGetPhysicalDeviceQueueFamilyProperties(
       context->physicalDevice, &count, props);
-    for (int i = 0; i < count; ++i) {
-        if (props->queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+
+    context->graphicsQueueFamilyIndex = UINT32_MAX;
+    for (uint32_t i = 0; i < count; ++i) {
+        if (props[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) {
             context->graphicsQueueFamilyIndex = i;
-            return;
+            context->timestampValidBits = props[i].timestampValidBits;
+            break;
+        }
+    }
+    if (context->graphicsQueueFamilyIndex == UINT32_MAX) {
+        context->result = E_NO_AVAILABLE_GRAPHICS_QUEUES;
+        eFree(props);
+        return;
+    }
+
+    // a transfer only family usually maps to a dedicated DMA engine,
+    // graphics queue implicitly supports transfers so it's the fallback.
+    // eUpdateTexture copies glyph sized regions at any texel, which needs
+    // a transfer granularity of one texel, graphics families always have it.
+    context->transferQueueFamilyIndex = context->graphicsQueueFamilyIndex;
+    for (uint32_t i = 0; i < count; ++i) {
+        VkQueueFlags flags = props[i].queueFlags;
+        VkExtent3D granularity = props[i].minImageTransferGranularity;
+        if ((flags & VK_QUEUE_TRANSFER_BIT)
+            && !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))
+            && granularity.width == 1 && granularity.height == 1
+            && granularity.depth == 1) {
+            context->transferQueueFamilyIndex = i;
+            break;
+        }
+    }
+    eFree(props);
+}
+
+static int IsDeviceExtensionSupported(EContext context, const char* name) {
+    uint32_t count = { 0 };
+    if (vkEnumerateDeviceExtensionProperties(
+          context->physicalDevice, NULL, &count, NULL)
+        != VK_SUCCESS) {
+        return 0;
+    }
+    VkExtensionProperties* props =
+      eAlloc(sizeof(*props) * count, E_MEMORY_SCOPE_CONTEXT);
+    if (!props) {
+        return 0;
+    }
+    int found = { 0 };
+    if (vkEnumerateDeviceExtensionProperties(
+          context->physicalDevice, NULL, &count, props)
+        == VK_SUCCESS) {
+        for (uint32_t i = 0; i < count && !found; ++i) {
+            found = strcmp(props[i].extensionName, name) == 0;
+        }
+    }
+    eFree(props);
+    return found;
+}
+
+static void AddDeviceExtension(EContext context, const char* name) {
+    if (context->deviceExtsCount < E_MAX_DEVICE_EXTENSIONS) {
+        context->deviceExts[context->deviceExtsCount++] = name;
+    }
+}
+
+// Decides which optional device features get used, everything optional has
+// a fallback path.
+static void SelectDeviceFeatures(EContext context) {
+    if (context->result != E_SUCCESS) {
+        return;
+    }
+    if (!context->headless) {
+        AddDeviceExtension(context, VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+    }
+
+    // features are queried through one chain, a struct is only chained when
+    // its version or extension is there
+    VkPhysicalDeviceFeatures2 pdf = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+    };
+    VkPhysicalDeviceTimelineSemaphoreFeatures tsf = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES,
+    };
+    VkPhysicalDeviceDynamicRenderingFeatures drf = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES,
+    };
+    int dynamicRenderingExt = { 0 };
+
+    VkPhysicalDeviceDescriptorIndexingFeatures dif = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES,
+    };
+    int descriptorIndexingExt = { 0 };
+
+#if E_ENABLE_TIMELINE_SEMAPHORE
+    // core in 1.2
+    if (context->apiVersion >= VK_API_VERSION_1_2) {
+        tsf.pNext = pdf.pNext;
+        pdf.pNext = &tsf;
+    }
+#endif
+#if E_ENABLE_BINDLESS
+    // core in 1.2, the EXT extension only needs maintenance3 from 1.1
+    if (context->apiVersion < VK_API_VERSION_1_2) {
+        descriptorIndexingExt = context->apiVersion >= VK_API_VERSION_1_1
+                                && IsDeviceExtensionSupported(context,
+                                  VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+    }
+    if (context->apiVersion >= VK_API_VERSION_1_2 || descriptorIndexingExt) {
+        dif.pNext = pdf.pNext;
+        pdf.pNext = &dif;
+    }
+#endif
+#if E_ENABLE_DYNAMIC_RENDERING
+    // core in 1.3, the KHR extension's dependencies are all core in 1.2
+    if (context->apiVersion < VK_API_VERSION_1_3) {
+        dynamicRenderingExt = context->apiVersion >= VK_API_VERSION_1_2
+                              && IsDeviceExtensionSupported(context,
+                                VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME);
+    }
+    if (context->apiVersion >= VK_API_VERSION_1_3 || dynamicRenderingExt) {
+        drf.pNext = pdf.pNext;
+        pdf.pNext = &drf;
+    }
+#endif
+    if (context->apiVersion >= VK_API_VERSION_1_1 && pdf.pNext) {
+        vkGetPhysicalDeviceFeatures2(context->physicalDevice, &pdf);
+    }
+
+    context->timelineSemaphores = tsf.timelineSemaphore == VK_TRUE;
+    context->dynamicRendering = drf.dynamicRendering == VK_TRUE;
+    if (context->dynamicRendering && dynamicRenderingExt) {
+        AddDeviceExtension(context, VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME);
+    }
+
+    // the whole texture table is one descriptor array in the fragment stage
+    const VkPhysicalDeviceLimits* limits = &context->properties.limits;
+    context->descriptorIndexing =
+      dif.descriptorBindingPartiallyBound == VK_TRUE
+      && dif.descriptorBindingUpdateUnusedWhilePending == VK_TRUE
+      && pdf.features.shaderSampledImageArrayDynamicIndexing == VK_TRUE
+      && limits->maxPerStageDescriptorSamplers >= E_MAX_TEXTURES
+      && limits->maxPerStageDescriptorSampledImages >= E_MAX_TEXTURES
+      && limits->maxDescriptorSetSamplers >= E_MAX_TEXTURES
+      && limits->maxDescriptorSetSampledImages >= E_MAX_TEXTURES;
+    if (context->descriptorIndexing && descriptorIndexingExt) {
+        AddDeviceExtension(context, VK_KHR_MAINTENANCE3_EXTENSION_NAME);
+        AddDeviceExtension(context, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+    }
+
+    // only a query, eGetMemoryBudget estimates the budget without it
+    context->memoryBudget = context->apiVersion >= VK_API_VERSION_1_1
+                            && IsDeviceExtensionSupported(
+                              context, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    if (context->memoryBudget) {
+        AddDeviceExtension(context, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    }
+}
+
+static void LoadDeviceFunctions(EContext context) {
+    if (context->dynamicRendering) {
+        int core = { context->apiVersion >= VK_API_VERSION_1_3 };
+        context->cmdBeginRendering =
+          (PFN_vkCmdBeginRenderingKHR)vkGetDeviceProcAddr(context->device,
+            core ? "vkCmdBeginRendering" : "vkCmdBeginRenderingKHR");
+        context->cmdEndRendering =
+          (PFN_vkCmdEndRenderingKHR)vkGetDeviceProcAddr(context->device,
+            core ? "vkCmdEndRendering" : "vkCmdEndRenderingKHR");
+        if (!context->cmdBeginRendering || !context->cmdEndRendering) {
+            context->dynamicRendering = 0;
+        }
+    }
+    if (context->timelineSemaphores) {
+        context->waitSemaphores = (PFN_vkWaitSemaphoresKHR)vkGetDeviceProcAddr(
+          context->device, "vkWaitSemaphores");
+        context->getSemaphoreCounterValue =
+          (PFN_vkGetSemaphoreCounterValueKHR)vkGetDeviceProcAddr(
+            context->device, "vkGetSemaphoreCounterValue");
+        if (!context->waitSemaphores || !context->getSemaphoreCounterValue) {
+            context->timelineSemaphores = 0;
         }
     }
-    context->result = E_NO_AVAILABLE_GRAPHICS_QUEUES;
 }
 
 static void CreateLogicalDevice(EContext context) {
@@ -95,25 +374,70 @@ static void CreateLogicalDevice(EContext context) {
 
     VkResult err = { 0 };
 
-    const char* deviceExt[1] = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
     const float queuePriorities[1] = { 1.f };
 
-    VkDeviceQueueCreateInfo dqcis[1] = { (VkDeviceQueueCreateInfo){
-      .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
-      .pQueuePriorities = queuePriorities,
-      .queueCount = 1,
-      .queueFamilyIndex = context->graphicsQueueFamilyIndex,
-    } };
+    VkDeviceQueueCreateInfo dqcis[2] = {
+        (VkDeviceQueueCreateInfo){
+          .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+          .pQueuePriorities = queuePriorities,
+          .queueCount = 1,
+          .queueFamilyIndex = context->graphicsQueueFamilyIndex,
+        },
+        (VkDeviceQueueCreateInfo){
+          .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+          .pQueuePriorities = queuePriorities,
+          .queueCount = 1,
+          .queueFamilyIndex = context->transferQueueFamilyIndex,
+        },
+    };
+    const uint32_t dqciCount = {
+        context->transferQueueFamilyIndex == context->graphicsQueueFamilyIndex
+          ? 1
+          : 2
+    };
+
+    // optional features are chained in front of each other
+    const void* features = { NULL };
+    VkPhysicalDeviceDynamicRenderingFeatures drf = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES,
+        .dynamicRendering = VK_TRUE,
+    };
+    if (context->dynamicRendering) {
+        drf.pNext = (void*)features;
+        features = &drf;
+    }
+    VkPhysicalDeviceTimelineSemaphoreFeatures tsf = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES,
+        .timelineSemaphore = VK_TRUE,
+    };
+    if (context->timelineSemaphores) {
+        tsf.pNext = (void*)features;
+        features = &tsf;
+    }
+    VkPhysicalDeviceDescriptorIndexingFeatures dif = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES,
+        .descriptorBindingPartiallyBound = VK_TRUE,
+        .descriptorBindingUpdateUnusedWhilePending = VK_TRUE,
+    };
+    VkPhysicalDeviceFeatures enabledFeatures = { 0 };
+    if (context->descriptorIndexing) {
+        dif.pNext = (void*)features;
+        features = &dif;
+        enabledFeatures.shaderSampledImageArrayDynamicIndexing = VK_TRUE;
+    }
 
     VkDeviceCreateInfo dci = (VkDeviceCreateInfo){
         .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
-        .enabledExtensionCount = sizeof(deviceExt) / sizeof(*deviceExt),
-        .ppEnabledExtensionNames = deviceExt,
-        .queueCreateInfoCount = sizeof(dqcis) / sizeof(*dqcis),
+        .pNext = features,
+        .pEnabledFeatures = &enabledFeatures,
+        .enabledExtensionCount = context->deviceExtsCount,
+        .ppEnabledExtensionNames = context->deviceExts,
+        .queueCreateInfoCount = dqciCount,
         .pQueueCreateInfos = dqcis,
     };
 
-    err = vkCreateDevice(context->physicalDevice, &dci, NULL, &context->device);
+    err = vkCreateDevice(
+      context->physicalDevice, &dci, context->vkAllocator, &context->device);
     if (err != VK_SUCCESS) {
         context->result = E_CREATE_DEVICE_FAILURE;
         return;
@@ -121,6 +445,273 @@ static void CreateLogicalDevice(EContext context) {
 
     vkGetDeviceQueue(
       context->device, context->graphicsQueueFamilyIndex, 0, &context->queue);
+    vkGetDeviceQueue(context->device,
+      context->transferQueueFamilyIndex,
+      0,
+      &context->transferQueue);
+
+    LoadDeviceFunctions(context);
+}
+
+static void CreateUploadSlots(EContext context) {
+    if (context->result != E_SUCCESS) {
+        return;
+    }
+    VkResult err = { 0 };
+
+    VkCommandPoolCreateInfo cpci = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+        .queueFamilyIndex = context->transferQueueFamilyIndex,
+    };
+    err = vkCreateCommandPool(context->device,
+      &cpci,
+      context->vkAllocator,
+      &context->uploadCommandPool);
+    if (err != VK_SUCCESS) {
+        context->result = E_CREATE_COMMAND_POOL_FAILURE;
+        return;
+    }
+
+    for (uint32_t i = 0; i < E_UPLOAD_SLOTS; ++i) {
+        struct EUploadSlot* slot = &context->uploads[i];
+
+        VkCommandBufferAllocateInfo cbai = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+            .commandBufferCount = 1,
+            .commandPool = context->uploadCommandPool,
+            .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        };
+        err = vkAllocateCommandBuffers(
+          context->device, &cbai, &slot->commandBuffer);
+        if (err != VK_SUCCESS) {
+            context->result = E_CREATE_COMMAND_BUFFER_FAILURE;
+            return;
+        }
+
+        if (context->timelineSemaphores) {
+            continue;
+        }
+        VkFenceCreateInfo fci = {
+            .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+            .flags = VK_FENCE_CREATE_SIGNALED_BIT,
+        };
+        err = vkCreateFence(
+          context->device, &fci, context->vkAllocator, &slot->fence);
+        if (err != VK_SUCCESS) {
+            context->result = E_CREATE_FENCE_FAILURE;
+            return;
+        }
+    }
+}
+
+// One timeline per queue, values signaled from two queues running
+// concurrently wouldn't be increasing on a shared one.
+static void CreateTimelines(EContext context) {
+    if (context->result != E_SUCCESS || !context->timelineSemaphores) {
+        return;
+    }
+    VkResult err = { 0 };
+
+    VkSemaphoreTypeCreateInfo stci = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+        .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+        .initialValue = 0,
+    };
+    VkSemaphoreCreateInfo sci = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+        .pNext = &stci,
+    };
+    err = vkCreateSemaphore(context->device,
+      &sci,
+      context->vkAllocator,
+      &context->graphicsTimeline.semaphore);
+    if (err != VK_SUCCESS) {
+        context->result = E_CREATE_SEMAPHORE_FAILURE;
+        return;
+    }
+    err = vkCreateSemaphore(context->device,
+      &sci,
+      context->vkAllocator,
+      &context->transferTimeline.semaphore);
+    if (err != VK_SUCCESS) {
+        context->result = E_CREATE_SEMAPHORE_FAILURE;
+    }
+}
+
+static void UpdateTimeline(EContext context, struct ETimeline* timeline) {
+    uint64_t value = { 0 };
+    if (timeline->completed < timeline->submitted
+        && context->getSemaphoreCounterValue(
+             context->device, timeline->semaphore, &value)
+             == VK_SUCCESS
+        && value > timeline->completed) {
+        timeline->completed = value;
+    }
+}
+
+// Refreshes the completed values, afterwards "is X done" is an integer
+// compare. In fence mode they are advanced by the fence waits instead.
+E_EXTERN void eUpdateTimelines(EContext context) {
+    if (!context->timelineSemaphores) {
+        return;
+    }
+    UpdateTimeline(context, &context->graphicsTimeline);
+    UpdateTimeline(context, &context->transferTimeline);
+}
+
+// Blocks until the timeline reached value, timeline mode only.
+E_EXTERN EResult eWaitTimeline(EContext context,
+  struct ETimeline* timeline,
+  uint64_t value) {
+    if (value <= timeline->completed) {
+        return E_SUCCESS;
+    }
+    VkSemaphoreWaitInfo swi = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+        .semaphoreCount = 1,
+        .pSemaphores = &timeline->semaphore,
+        .pValues = &value,
+    };
+    if (context->waitSemaphores(context->device, &swi, UINT64_MAX)
+        != VK_SUCCESS) {
+        return E_SYNC_FAILURE;
+    }
+    timeline->completed = value;
+    return E_SUCCESS;
+}
+
+static EResult WaitForUploadSlot(EContext context, struct EUploadSlot* slot) {
+    if (context->timelineSemaphores) {
+        return eWaitTimeline(context, &context->transferTimeline, slot->value);
+    }
+    if (vkWaitForFences(context->device, 1, &slot->fence, 1, UINT64_MAX)
+        != VK_SUCCESS) {
+        return E_SYNC_FAILURE;
+    }
+    return E_SUCCESS;
+}
+
+static void RetireUploadSlot(EContext context, struct EUploadSlot* slot) {
+    if (slot->texture) {
+        if (slot->region) {
+            slot->texture->regionUpload = NULL;
+        }
+        else {
+            slot->texture->upload = NULL;
+        }
+        slot->texture = NULL;
+        context->uploadEpoch++;
+    }
+}
+
+// Non blocking, marks textures whose upload finished as ready to be sampled.
+E_EXTERN void eUpdateUploads(EContext context) {
+    eUpdateTimelines(context);
+    for (uint32_t i = 0; i < E_UPLOAD_SLOTS; ++i) {
+        struct EUploadSlot* slot = &context->uploads[i];
+        if (!slot->texture) {
+            continue;
+        }
+        if (context->timelineSemaphores
+              ? slot->value <= context->transferTimeline.completed
+              : vkGetFenceStatus(context->device, slot->fence) == VK_SUCCESS) {
+            RetireUploadSlot(context, slot);
+        }
+    }
+}
+
+// Returns a free slot with its command buffer ready for recording. Only waits
+// when every slot is still in flight, and then only on a single upload.
+E_EXTERN struct EUploadSlot* eAcquireUploadSlot(EContext context) {
+    eUpdateUploads(context);
+
+    struct EUploadSlot* slot = { NULL };
+    for (uint32_t i = 0; i < E_UPLOAD_SLOTS && !slot; ++i) {
+        if (!context->uploads[i].texture) {
+            slot = &context->uploads[i];
+        }
+    }
+    if (!slot) {
+        slot = &context->uploads[context->uploadNext];
+        context->uploadNext = (context->uploadNext + 1) % E_UPLOAD_SLOTS;
+        if (WaitForUploadSlot(context, slot) != E_SUCCESS) {
+            return NULL;
+        }
+        RetireUploadSlot(context, slot);
+    }
+    if (vkResetCommandBuffer(slot->commandBuffer, 0) != VK_SUCCESS) {
+        return NULL;
+    }
+    VkCommandBufferBeginInfo cbbi = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+    };
+    if (vkBeginCommandBuffer(slot->commandBuffer, &cbbi) != VK_SUCCESS) {
+        return NULL;
+    }
+    return slot;
+}
+
+E_EXTERN EResult eSubmitUpload(EContext context,
+  struct EUploadSlot* slot,
+  ETexture texture,
+  int region) {
+    VkResult err = { 0 };
+
+    err = vkEndCommandBuffer(slot->commandBuffer);
+    if (err != VK_SUCCESS) {
+        return E_UPLOAD_FAILURE;
+    }
+    struct ETimeline* timeline = &context->transferTimeline;
+    uint64_t value = { timeline->submitted + 1 };
+    VkTimelineSemaphoreSubmitInfo tssi = {
+        .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+        .signalSemaphoreValueCount = 1,
+        .pSignalSemaphoreValues = &value,
+    };
+    VkSubmitInfo si = {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .commandBufferCount = 1,
+        .pCommandBuffers = &slot->commandBuffer,
+    };
+    if (context->timelineSemaphores) {
+        si.pNext = &tssi;
+        si.signalSemaphoreCount = 1;
+        si.pSignalSemaphores = &timeline->semaphore;
+    }
+    else {
+        err = vkResetFences(context->device, 1, &slot->fence);
+        if (err != VK_SUCCESS) {
+            return E_SYNC_FAILURE;
+        }
+    }
+    err = vkQueueSubmit(context->transferQueue, 1, &si, slot->fence);
+    if (err != VK_SUCCESS) {
+        return E_UPLOAD_FAILURE;
+    }
+    timeline->submitted = value;
+    slot->value = value;
+    slot->texture = texture;
+    slot->region = region;
+    if (region) {
+        texture->regionUpload = slot;
+    }
+    else {
+        texture->upload = slot;
+    }
+    return E_SUCCESS;
+}
+
+// Blocks until the given texture's uploads are done, used before destruction.
+E_EXTERN void eWaitForUpload(EContext context, ETexture texture) {
+    struct EUploadSlot* slots[2] = { texture->upload, texture->regionUpload };
+    for (uint32_t i = 0; i < 2; ++i) {
+        if (slots[i]) {
+            (void)WaitForUploadSlot(context, slots[i]);
+            RetireUploadSlot(context, slots[i]);
+        }
+    }
 }
 
 #if E_ENABLE_ERROR_CALLBACK
@@ -174,10 +765,12 @@ static void CreateInstance(EContext context) {
 
     const char** reqExt = { NULL };
     uint32_t reqExtCount = { 0 };
-    reqExt = glfwGetRequiredInstanceExtensions(&reqExtCount);
-    if (!reqExt) {
-        context->result = E_GLFW_FAILURE;
-        return;
+    if (!context->headless) {
+        reqExt = glfwGetRequiredInstanceExtensions(&reqExtCount);
+        if (!reqExt) {
+            context->result = E_GLFW_FAILURE;
+            return;
+        }
     }
 
     // additional required extensions
@@ -192,8 +785,28 @@ static void CreateInstance(EContext context) {
     };
     const uint32_t addReqExtCount = { sizeof(addReqExt) / sizeof(*addReqExt) };
 
+    // 1.0 loaders don't know vkEnumerateInstanceVersion and reject anything
+    // newer than 1.0 in apiVersion
+    context->apiVersion = VK_API_VERSION_1_0;
+    PFN_vkEnumerateInstanceVersion enumerateInstanceVersion =
+      (PFN_vkEnumerateInstanceVersion)vkGetInstanceProcAddr(
+        NULL, "vkEnumerateInstanceVersion");
+    if (enumerateInstanceVersion
+        && enumerateInstanceVersion(&context->apiVersion) != VK_SUCCESS) {
+        context->apiVersion = VK_API_VERSION_1_0;
+    }
+    if (context->apiVersion > VK_API_VERSION_1_3) {
+        context->apiVersion = VK_API_VERSION_1_3;
+    }
+    VkApplicationInfo ai = {
+        .sType = VK_STRUCTURE_TYPE_APPLICATION_INFO,
+        .pApplicationName = "EldenSheet",
+        .apiVersion = context->apiVersion,
+    };
+
     VkInstanceCreateInfo ici = { 0 };
     ici.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+    ici.pApplicationInfo = &ai;
 #ifdef VK_KHR_PORTABILITY_ENUMERATION_EXTENSION_NAME
     ici.flags |= VK_INSTANCE_CREATE_ENUMERATE_PORTABILITY_BIT_KHR;
 #endif
@@ -224,12 +837,13 @@ static void CreateInstance(EContext context) {
         return;
     }
 
-    props = malloc(sizeof(*props) * propCount);
+    props = eAlloc(sizeof(*props) * propCount, E_MEMORY_SCOPE_CONTEXT);
     // Worst case scenario malloc. Small sizes so doesn't really matter.
-    context->exts =
-      malloc(sizeof(*context->exts) * (propCount + addReqExtCount));
+    context->exts = eAlloc(
+      sizeof(*context->exts) * (propCount + addReqExtCount),
+      E_MEMORY_SCOPE_CONTEXT);
     if (!props || !context->exts) {
-        free(props);
+        eFree(props);
         context->result = E_MALLOC_FAILURE;
         return;
     }
@@ -237,7 +851,7 @@ static void CreateInstance(EContext context) {
     err = vkEnumerateInstanceExtensionProperties(NULL, &propCount, props);
     if (err != VK_SUCCESS) {
         context->result = E_ENUMERATE_FAILURE;
-        free(props);
+        eFree(props);
         return;
     }
 
@@ -275,17 +889,19 @@ static void CreateInstance(EContext context) {
 
     ici.enabledExtensionCount = context->extsCount;
     ici.ppEnabledExtensionNames = context->exts;
-    err = vkCreateInstance(&ici, NULL, &context->instance);
+    err = vkCreateInstance(&ici, context->vkAllocator, &context->instance);
     if (err != VK_SUCCESS) {
         context->result = E_CREATE_INSTANCE_FAILURE;
-        free(props);
+        eFree(props);
         return;
     }
-    free(props);
+    eFree(props);
 
 #if E_ENABLE_ERROR_CALLBACK
-    err = CreateDebugUtilsMessengerEXT(
-      context->instance, &duimci, NULL, &context->debugMessenger);
+    err = CreateDebugUtilsMessengerEXT(context->instance,
+      &duimci,
+      context->vkAllocator,
+      &context->debugMessenger);
     if (err != VK_SUCCESS) {
         context->result = E_FAILURE;
     }
@@ -304,7 +920,8 @@ static void SelectPhysicalDevice(EContext context) {
         context->result = E_ENUMERATE_FAILURE;
         return;
     }
-    VkPhysicalDevice* devices = malloc(sizeof(*devices) * deviceCount);
+    VkPhysicalDevice* devices =
+      eAlloc(sizeof(*devices) * deviceCount, E_MEMORY_SCOPE_CONTEXT);
     if (!devices) {
         context->result = E_MALLOC_FAILURE;
         return;
@@ -312,7 +929,7 @@ static void SelectPhysicalDevice(EContext context) {
     err = vkEnumeratePhysicalDevices(context->instance, &deviceCount, devices);
     if (err != VK_SUCCESS) {
         context->result = E_ENUMERATE_FAILURE;
-        free(devices);
+        eFree(devices);
         return;
     }
     VkPhysicalDeviceProperties prop = { 0 };
@@ -323,11 +940,141 @@ static void SelectPhysicalDevice(EContext context) {
             break;
         }
     }
-    if (deviceCount > 0) {
+    if (!context->physicalDevice && deviceCount > 0) {
         context->physicalDevice = devices[0];
     }
-    else {
+    if (!context->physicalDevice) {
         context->result = E_NO_AVAILABLE_PHYSICAL_DEVICES;
+        eFree(devices);
+        return;
+    }
+    vkGetPhysicalDeviceProperties(
+      context->physicalDevice, &context->properties);
+    if (context->properties.apiVersion < context->apiVersion) {
+        context->apiVersion = context->properties.apiVersion;
+    }
+    eFree(devices);
+}
+
+#if E_ENABLE_PIPELINE_CACHE
+// cache data is only valid for one exact driver, so every driver gets a file
+static void
+  GetPipelineCachePath(EContext context, char* pathOut, size_t size) {
+    (void)snprintf(pathOut,
+      size,
+      "pipeline_cache_%08x_%08x_%08x.bin",
+      context->properties.vendorID,
+      context->properties.deviceID,
+      context->properties.driverVersion);
+}
+
+// Returns 1 if data starts with a header written by this very device/driver.
+static int IsPipelineCacheCompatible(EContext context,
+  const unsigned char* data,
+  size_t size) {
+    // VkPipelineCacheHeaderVersionOne
+    uint32_t header[4] = { 0 };
+    if (size < sizeof(header) + VK_UUID_SIZE) {
+        return 0;
+    }
+    memcpy(header, data, sizeof(header));
+    return header[0] >= sizeof(header) + VK_UUID_SIZE
+           && header[1] == VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+           && header[2] == context->properties.vendorID
+           && header[3] == context->properties.deviceID
+           && memcmp(data + sizeof(header),
+                context->properties.pipelineCacheUUID,
+                VK_UUID_SIZE)
+                == 0;
+}
+#endif
+
+static void CreatePipelineCache(EContext context) {
+    if (context->result != E_SUCCESS) {
+        return;
     }
-    free(devices);
+    VkResult err = { 0 };
+
+    unsigned char* data = { NULL };
+    size_t size = { 0 };
+
+#if E_ENABLE_PIPELINE_CACHE
+    char path[64] = { 0 };
+    GetPipelineCachePath(context, path, sizeof(path));
+    FILE* file = eOpenFile(path, "rb");
+    if (file) {
+        long fileSize = { 0 };
+        if (fseek(file, 0, SEEK_END) == 0 && (fileSize = ftell(file)) > 0
+            && fseek(file, 0, SEEK_SET) == 0) {
+            data = eAlloc((size_t)fileSize, E_MEMORY_SCOPE_CONTEXT);
+        }
+        if (data
+            && fread(data, 1, (size_t)fileSize, file) == (size_t)fileSize) {
+            size = (size_t)fileSize;
+        }
+        (void)fclose(file);
+    }
+    // a stale cache is harmless to drop, the driver might not be as forgiving
+    if (size && !IsPipelineCacheCompatible(context, data, size)) {
+        size = 0;
+    }
+#if E_VERBOSE_MESSAGING
+    printf("Pipeline cache %s: %s\n", path, size ? "loaded" : "cold");
+#endif
+#endif
+
+    VkPipelineCacheCreateInfo pcci = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+        .initialDataSize = size,
+        .pInitialData = size ? data : NULL,
+    };
+    err = vkCreatePipelineCache(
+      context->device, &pcci, context->vkAllocator, &context->pipelineCache);
+    if (err != VK_SUCCESS && size) {
+        // retry empty, the cache is an optimization only
+        pcci.initialDataSize = 0;
+        pcci.pInitialData = NULL;
+        err = vkCreatePipelineCache(context->device,
+          &pcci,
+          context->vkAllocator,
+          &context->pipelineCache);
+    }
+    if (err != VK_SUCCESS) {
+        context->pipelineCache = VK_NULL_HANDLE;
+    }
+    eFree(data);
+}
+
+static void SavePipelineCache(EContext context) {
+#if E_ENABLE_PIPELINE_CACHE
+    if (!context->pipelineCache) {
+        return;
+    }
+    VkResult err = { 0 };
+
+    size_t size = { 0 };
+    err = vkGetPipelineCacheData(
+      context->device, context->pipelineCache, &size, NULL);
+    if (err != VK_SUCCESS || size == 0) {
+        return;
+    }
+    unsigned char* data = eAlloc(size, E_MEMORY_SCOPE_CONTEXT);
+    if (!data) {
+        return;
+    }
+    err = vkGetPipelineCacheData(
+      context->device, context->pipelineCache, &size, data);
+    if (err == VK_SUCCESS) {
+        char path[64] = { 0 };
+        GetPipelineCachePath(context, path, sizeof(path));
+        FILE* file = eOpenFile(path, "wb");
+        if (file) {
+            (void)fwrite(data, 1, size, file);
+            (void)fclose(file);
+        }
+    }
+    eFree(data);
+#else
+    (void)context;
+#endif
 }
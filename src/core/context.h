@@ -3,5 +3,12 @@
 #include "../graphics.h"
 
 E_EXTERN void eCreateContext(EContext* contextOut);
+E_EXTERN void eCreateHeadlessContext(EContext* contextOut);
 E_EXTERN void eDestroyContext(EContext context);
 E_EXTERN void eWaitForQueues(EContext context);
+E_EXTERN void eUpdateUploads(EContext context);
+E_EXTERN uint32_t eFindMemoryType(EContext context,
+  uint32_t typeBits,
+  uint32_t propertyFlags);
+E_EXTERN void eGetMemoryStats(EContext context, EMemoryStats* statsOut);
+E_EXTERN void eGetMemoryBudget(EContext context, EMemoryBudget* budgetOut);
@@ -6,6 +6,53 @@
 
 #include "../graphics.h"
 
+#include <stdio.h>
+
+// of eAlloc, what malloc guarantees on the supported platforms
+#define E_HOST_ALIGNMENT 16
+// device extensions the context may enable
+#define E_MAX_DEVICE_EXTENSIONS 8
+
+// threads recording secondary command buffers, including the caller
+#define E_MAX_RECORD_THREADS 8
+// draw data with fewer batches is recorded inline, splitting isn't worth it
+#define E_PARALLEL_RECORD_MIN_BATCHES 4096
+
+// upper bound of frames in flight, independent of the swapchain
+#define E_MAX_FRAMES 4
+#define E_DEFAULT_FRAMES_IN_FLIGHT 2
+#define E_MAX_SWAPCHAIN_IMAGES 8
+// swapchains replaced by resizes that may still be in use by the GPU
+#define E_MAX_RETIRED_SWAPCHAINS 4
+// staging buffers kept around for texture uploads
+#define E_UPLOAD_SLOTS 4
+// frames built after an event, imgui needs a couple to settle hover/nav state
+#define E_DIRTY_FRAMES 3
+// texture ids available, also the array size in shader.frag with E_BINDLESS
+#define E_MAX_TEXTURES 1024
+// pipeline sets replaced by shader reloads while frames in flight use them
+#define E_MAX_RETIRED_PIPELINES 4
+// frames between memory budget checks, the query isn't free
+#define E_RESIDENCY_INTERVAL 16
+// frames a texture has to go undrawn before it may be evicted
+#define E_RESIDENCY_IDLE_FRAMES 60
+#define E_DEFAULT_RESIDENCY_FRACTION 0.9f
+#define E_MAX_ATLAS_PAGES 8
+#define E_DEFAULT_ATLAS_PAGE_SIZE 1024
+// transparent border around atlas icons, keeps linear filtering from
+// bleeding neighbours in
+#define E_ATLAS_PADDING 1
+#define E_MAX_GLYPH_PAGES 16
+#define E_DEFAULT_GLYPH_PAGE_SIZE 512
+// bytes of glyph page textures kept before pages are evicted
+#define E_DEFAULT_GLYPH_BUDGET (4u << 20)
+// pixel size the distance field font is baked at, and the size it is drawn
+// at before any zoom
+#define E_SDF_FONT_SIZE 32.f
+#define E_DEFAULT_FONT_SIZE 13.f
+// texels from the outline to where the distance field saturates
+#define E_SDF_SPREAD 4
+
 struct EWindow_t {
     EResult result;
     GLFWwindow* window;
@@ -15,59 +62,307 @@ struct EWindow_t {
         int height;
     } size;
     int shouldResize;
+    int dirtyFrames;  // frames left to build before the window may idle
+    EPresentMode presentMode;
+    uint32_t framesInFlight;
+    double frameInterval;  // seconds, 0 when not pacing
+    double nextFrameTime;
+    void* sleepTimer;  // HANDLE of a waitable timer on windows
+};
+
+// device memory blocks the allocator splits up, allocations bigger than
+// half a block get memory of their own
+#define E_MEMORY_BLOCK_SIZE ((VkDeviceSize)64 << 20)
+// size classes of the TLSF free lists, 16 per power of two
+#define E_TLSF_SL_BITS 4
+#define E_TLSF_SL_COUNT (1 << E_TLSF_SL_BITS)
+#define E_TLSF_FL_COUNT 48
+#define E_NO_MEMORY_NODE UINT32_MAX
+
+// a range of a block, CPU side since device memory can't hold headers
+struct EMemoryNode {
+    VkDeviceSize offset;
+    VkDeviceSize size;
+    uint32_t prevPhys;  // neighbours by offset, never both free
+    uint32_t nextPhys;
+    uint32_t prevFree;  // free list of its size class, unused nodes chain
+    uint32_t nextFree;  // through nextFree too
+    int free;
+};
+
+struct EMemoryBlock {
+    VkDeviceMemory memory;
+    VkDeviceSize size;
+    void* mapped;  // the whole block, host visible memory only
+    uint32_t memoryType;
+    int optimal;
+    struct EMemoryNode* nodes;
+    uint32_t nodeCount;
+    uint32_t nodeCapacity;
+    uint32_t firstUnused;
+    uint64_t flMap;  // first levels with a free node
+    uint32_t slMap[E_TLSF_FL_COUNT];
+    uint32_t heads[E_TLSF_FL_COUNT][E_TLSF_SL_COUNT];
+    uint32_t allocationCount;
+};
+
+// Blocks of one memory type. Buffers and optimally tiled images don't share
+// blocks, which keeps bufferImageGranularity out of the placement.
+struct EMemoryPool {
+    struct EMemoryBlock** blocks;
+    uint32_t blockCount;
+    uint32_t blockCapacity;
+};
+
+struct EAllocator {
+    VkPhysicalDeviceMemoryProperties properties;
+    VkDeviceSize blockSizes[VK_MAX_MEMORY_HEAPS];
+    struct EMemoryPool pools[VK_MAX_MEMORY_TYPES][2];  // linear, optimal
+    EMemoryStats stats;
+    // by heap, block and dedicated bytes held, and the part of them that
+    // allocations use
+    VkDeviceSize heapBytes[VK_MAX_MEMORY_HEAPS];
+    VkDeviceSize heapUsedBytes[VK_MAX_MEMORY_HEAPS];
+};
+
+struct EAllocation {
+    VkDeviceMemory memory;
+    VkDeviceSize offset;
+    VkDeviceSize size;
+    void* mapped;  // NULL unless host visible
+    struct EMemoryBlock* block;  // NULL when the memory is its own
+    uint32_t node;
+    uint32_t heap;
+};
+
+// persistently mapped host visible buffer, grows but never shrinks
+struct EStreamBuffer {
+    VkBuffer buffer;
+    struct EAllocation allocation;
+    VkDeviceSize size;
+    void* mapped;
+};
+
+// Linear allocator for data that lives for one frame. Pushes hand out
+// offsets only, eCommitArena then grows the buffer to fit all of them
+// before anything is written.
+struct EArena {
+    struct EStreamBuffer stream;
+    VkDeviceSize head;
+};
+
+// Progress of one queue. Values are handed out on submit, work tagged with a
+// value is done once completed reaches it.
+struct ETimeline {
+    VkSemaphore semaphore;  // VK_NULL_HANDLE in fence mode
+    uint64_t submitted;
+    uint64_t completed;
+};
+
+struct EUploadSlot {
+    VkCommandBuffer commandBuffer;
+    VkFence fence;  // fence mode only
+    uint64_t value;  // transfer timeline value of the last submit
+    struct EStreamBuffer staging;
+    ETexture texture;  // NULL when slot is free
+    int region;  // uploading regions of a texture that is already drawn
 };
 
 struct EContext_t {
     EResult result;
+    // passed to every Vulkan call that takes one, see eSetHostAllocator
+    const VkAllocationCallbacks* vkAllocator;
     VkInstance instance;
 #if E_ENABLE_ERROR_CALLBACK
     VkDebugUtilsMessengerEXT debugMessenger;
 #endif
     VkPhysicalDevice physicalDevice;
+    VkPhysicalDeviceProperties properties;
+    int headless;  // no surface or swapchain extensions
+    uint32_t apiVersion;  // min of instance and device version
+    const char* deviceExts[E_MAX_DEVICE_EXTENSIONS];
+    uint32_t deviceExtsCount;
+    int dynamicRendering;
+    PFN_vkCmdBeginRenderingKHR cmdBeginRendering;
+    PFN_vkCmdEndRenderingKHR cmdEndRendering;
+    int descriptorIndexing;
+    int memoryBudget;  // VK_EXT_memory_budget reports per heap budgets
+    int timelineSemaphores;
+    PFN_vkWaitSemaphoresKHR waitSemaphores;
+    PFN_vkGetSemaphoreCounterValueKHR getSemaphoreCounterValue;
+    struct ETimeline graphicsTimeline;  // frames and deferred deletion
+    struct ETimeline transferTimeline;  // uploads
     VkDevice device;
+    VkPipelineCache pipelineCache;
     VkQueue queue;
+    VkQueue transferQueue;  // same as queue if no transfer only family
     const char** exts;
     uint32_t extsCount;
     uint32_t graphicsQueueFamilyIndex;
+    uint32_t transferQueueFamilyIndex;
+    uint32_t timestampValidBits;  // of the graphics queue, 0 if unsupported
+    VkCommandPool uploadCommandPool;
+    struct EUploadSlot uploads[E_UPLOAD_SLOTS];
+    uint32_t uploadNext;
+    uint64_t uploadEpoch;  // bumped whenever a texture becomes drawable
+    struct EAllocator allocator;
 };
 
+// one per frame in flight, used round robin by frame number
 struct EFrame {
     VkCommandPool commandPool;
     VkCommandBuffer commandBuffer;
-    VkFence fence;
-    VkFramebuffer frameBuffer;
+    VkFence fence;  // fence mode only
+    VkSemaphore imageAvailable;
+    uint64_t serial;  // graphics timeline value of the last submit
+    // the frame's start, each timed draw list's start and the frame's end,
+    // VK_NULL_HANDLE without timestamp support
+    VkQueryPool queryPool;
+    uint32_t timedLists;
+    int queriesWritten;  // results to be read once the frame finished
+};
+
+// one per swapchain image, indexed by the acquired image index
+struct ESwapchainImage {
     VkImage image;
+    // offscreen images only, swapchains own theirs
+    struct EAllocation allocation;
     VkImageView imageView;
+    VkFramebuffer frameBuffer;
+    VkSemaphore renderFinished;
 };
 
-struct EFrameSemaphores {
-    VkSemaphore imageAvailable;
-    VkSemaphore renderFinished;
+// objects of a replaced swapchain, destroyed once the GPU passed its serial
+struct ERetiredSwapchain {
+    VkSwapchainKHR swapchain;
+    struct ESwapchainImage images[E_MAX_SWAPCHAIN_IMAGES];
+    uint32_t imageCount;
+    uint64_t serial;
 };
 
 struct EDisplay_t {
     EResult result;
-    struct EFrame* frames;
-    struct EFrameSemaphores* semaphores;
+    ERenderer renderer;
+    // renders into its own image ring instead of a swapchain, one image per
+    // frame in flight, and presents nothing
+    int offscreen;
+    VkImageLayout finalLayout;  // what the image is left in after a frame
+    struct EFrame frames[E_MAX_FRAMES];
+    struct ESwapchainImage images[E_MAX_SWAPCHAIN_IMAGES];
     VkSurfaceKHR surface;
     VkSwapchainKHR swapchain;
     VkSurfaceFormatKHR surfaceFormat;
     VkPresentModeKHR presentMode;
     VkRenderPass renderPass;
+    VkFormat renderPassFormat;
     VkClearValue clearValue;
+    struct ERetiredSwapchain retired[E_MAX_RETIRED_SWAPCHAINS];
+    uint32_t retiredCount;
     uint32_t frameCount;
-    uint32_t frameCurrentIndex;
-    uint32_t semaphoreCount;
-    uint32_t semaphoreCurrentIndex;
+    uint32_t frameIndex;
+    uint32_t imageCount;
+    uint32_t imageIndex;
     int width;  // glfw forces int
     int height;
+    uint64_t presentedHash;  // draw data hash of the last presented frame
+    uint64_t pendingHash;
+    int presentedValid;
+    int frameSkipped;
+    EDisplayStats stats;
+    EFrameTimings timings;
+    uint64_t cpuPhaseStart[E_CPU_PHASE_COUNT];
+    uint64_t cpuNanoseconds[E_CPU_PHASE_COUNT];  // of the frame being built
 };
 
 struct ETexture_t {
-    VkDeviceMemory memory;
+    EResult result;
+    struct EAllocation allocation;
     VkImage image;
     VkImageView imageView;
-    VkDescriptorSet descriptorSet;
+    VkDescriptorSet descriptorSet;  // without descriptor indexing only
+    uint32_t id;  // index into the renderer's texture table, never 0
+    uint32_t width;
+    uint32_t height;
+    int alphaOnly;  // one byte per texel
+    int distanceField;
+    int dynamic;  // sampled in the general layout
+    struct EUploadSlot* upload;  // pending upload, NULL once sampleable
+    struct EUploadSlot* regionUpload;  // pending eUpdateTexture
+    uint64_t lastDrawn;  // renderer frame it was last batched in
+    int (*evict)(void* userData, ETexture texture);  // NULL once retired
+    void* evictUserData;
+};
+
+// what is left of one or more draw commands after culling and merging,
+// ready to be recorded
+struct EBatch {
+    VkRect2D scissor;
+    ETexture texture;  // NULL keeps whatever is bound
+    uint32_t list;
+    uint32_t firstIndex;  // into the frame's index buffer
+    int32_t vertexOffset;
+    uint32_t indexCount;
+    // draws this many instances from the cell buffer instead when nonzero
+    uint32_t firstCell;
+    uint32_t cellCount;
+};
+
+struct ERetiredTexture {
+    ETexture texture;
+    uint64_t serial;  // graphics timeline value of the last frame using it
+};
+
+struct ERenderFrame {
+    // vertices, indices and per instance ECellRects, one after the other
+    struct EArena arena;
+    VkDeviceSize vertexOffset;
+    VkDeviceSize indexOffset;
+    VkDeviceSize cellOffset;
+    // one pool per recording thread, pools aren't externally synchronized
+    VkCommandPool pools[E_MAX_RECORD_THREADS];
+    VkCommandBuffer secondaries[E_MAX_RECORD_THREADS];
+    uint32_t poolCount;
+    uint32_t secondaryCount;  // recorded this frame, 0 when recorded inline
+    int prepared;  // draw data was uploaded and has something to draw
+};
+
+typedef void (*EWorkFn)(void* arg, uint32_t index);
+
+// persistent threads for fork join work
+struct EWorkerPool {
+    struct EWorkerShared* shared;
+    uint32_t count;  // including the calling thread
+};
+
+// Pipelines a batch may draw with. The first four draw imgui geometry and
+// differ in how the texture is sampled, the alpha and sdf bits match the
+// texture's alphaOnly and distanceField.
+enum EPipelineKind {
+    E_PIPELINE_IMGUI = 0,
+    E_PIPELINE_ALPHA = 1,
+    E_PIPELINE_SDF = 2,
+    E_PIPELINE_SDF_ALPHA = 3,
+    E_PIPELINE_CELLS,
+    E_PIPELINE_COUNT,
+};
+
+struct ERetiredPipelines {
+    VkPipeline pipelines[E_PIPELINE_COUNT];
+    uint64_t serial;  // graphics timeline value of the last frame using them
+};
+
+// shader modules the pipelines are built from
+enum EShaderStage {
+    E_SHADER_VERT = 0,
+    E_SHADER_FRAG,  // specialized per texture variant
+    E_SHADER_CELL_VERT,
+    E_SHADER_CELL_FRAG,
+    E_SHADER_COUNT,
+};
+
+struct EShaderCode {
+    const uint32_t* code;
+    size_t size;  // bytes
 };
 
 struct ERenderer_t {
@@ -75,10 +370,180 @@ struct ERenderer_t {
     VkSampler sampler;
     VkDescriptorSetLayout descSetLayout;
     VkDescriptorPool descPool;
+    VkDescriptorSet textureSet;  // whole texture table, bindless only
     VkPipelineLayout pipelineLayout;
-    VkPipeline pipeline;
-    VkShaderModule vertShader;
-    VkShaderModule fragShader;
+    VkPipeline pipelines[E_PIPELINE_COUNT];
+    VkShaderModule shaders[E_SHADER_COUNT];
+    // of the imgui vertices, kept for rebuilding the pipelines
+    VkVertexInputAttributeDescription vertexAttrs[3];
+    struct ERetiredPipelines retiredPipelines[E_MAX_RETIRED_PIPELINES];
+    uint32_t retiredPipelineCount;
+    struct EShaderReload* reload;  // NULL unless built with shader-reload
     uint32_t descPoolSize;
-    ETexture texture;
+    uint32_t vertSize;
+    uint32_t indexSize;
+    const EDrawData* drawData;
+    struct EBatch* batches;  // of the frame being recorded
+    uint32_t batchCount;
+    uint32_t batchCapacity;
+    struct ERenderFrame frames[E_MAX_FRAMES];
+    ETexture textures[E_MAX_TEXTURES];  // by id, 0 stays unused
+    uint32_t textureHint;  // where the search for a free id starts
+    // replaced while frames in flight may still sample them
+    struct ERetiredTexture* retiredTextures;
+    uint32_t retiredTextureCount;
+    uint32_t retiredTextureCapacity;
+    struct EWorkerPool workers;  // started on the first big frame
+    uint32_t recordThreads;
+    float residencyFraction;
+    uint64_t frameCount;  // draw data prepared, the clock of lastDrawn
+    ERendererStats stats;
+};
+
+struct EAtlasIcon {
+    int live;
+    uint32_t page;
+    uint32_t x;  // top left of the icon without padding in the page pixels
+    uint32_t y;
+    uint32_t width;
+    uint32_t height;
+    uint32_t pendingX;  // position in the page texture being uploaded
+    uint32_t pendingY;
+    int inPending;
+    uint32_t shownX;  // position in the page texture being drawn
+    uint32_t shownY;
+    int shown;
+    uint32_t nextFree;  // free list link, 0 ends it
+};
+
+struct EAtlasPage {
+    void* packer;  // stb_rect_pack state, private to atlas.c
+    unsigned char* pixels;  // CPU copy the page textures are made from
+    ETexture shown;  // drawn from, replaced once pending finished uploading
+    ETexture pending;
+    uint32_t liveCount;
+    uint64_t deadArea;  // padded pixels of removed icons, reclaimed by repacks
+    int dirty;  // pixels changed since the last upload started
+    int evicted;  // shown was handed to the renderer, uploaded again on use
+};
+
+struct EIconAtlas_t {
+    EResult result;
+    ERenderer renderer;
+    uint32_t pageSize;
+    struct EAtlasPage pages[E_MAX_ATLAS_PAGES];
+    uint32_t pageCount;
+    struct EAtlasIcon* icons;  // by id, 0 stays unused
+    uint32_t iconCapacity;
+    uint32_t firstFree;
 };
+
+struct EGlyph {
+    uint32_t key;  // codepoint + 1, 0 marks an empty slot
+    int32_t page;  // -1 for glyphs without pixels, like spaces
+    uint32_t x;  // top left of the bitmap without padding in the page
+    uint32_t y;
+    uint32_t width;
+    uint32_t height;
+    float offset[2];  // of the bitmap from the pen at the top left of a line
+    float advance;
+    uint64_t generation;  // of the page upload that brings it in
+};
+
+struct EGlyphPage {
+    void* packer;  // stb_rect_pack state
+    ETexture texture;  // dynamic, created by eUpdateGlyphCache
+    ETexture evicted;  // replaced by an eviction, retired by the next update
+    uint64_t lastUsed;  // frame a glyph on it was last looked up or added
+    uint64_t generation;  // given to glyphs added since the last upload
+    uint64_t submittedGeneration;
+    uint64_t readyGeneration;  // glyphs up to it are drawable
+    // glyphs added since the last upload, their pixels one after the other
+    ETextureRegion* regions;
+    uint32_t regionCount;
+    uint32_t regionCapacity;
+    unsigned char* staged;
+    size_t stagedSize;
+    size_t stagedCapacity;
+};
+
+struct EGlyphCache_t {
+    EResult result;
+    ERenderer renderer;
+    void* font;  // stbtt_fontinfo, private to glyphs.c
+    float scale;  // font units to pixels
+    float ascent;  // pixels from the top of a line to the baseline
+    uint32_t pageSize;
+    uint32_t maxPages;  // what the memory budget allows
+    struct EGlyphPage pages[E_MAX_GLYPH_PAGES];
+    uint32_t pageCount;
+    struct EGlyph* glyphs;  // open addressing by key
+    uint32_t glyphCapacity;  // power of two
+    uint32_t glyphCount;
+    uint64_t frame;
+};
+
+// helpers shared between core modules
+E_EXTERN void* eAlloc(size_t size, EMemoryScope scope);
+E_EXTERN void* eCalloc(size_t count, size_t size, EMemoryScope scope);
+E_EXTERN void* eRealloc(void* memory, size_t size, EMemoryScope scope);
+E_EXTERN void eFree(void* memory);
+E_EXTERN const VkAllocationCallbacks* eGetVkAllocator(void);
+#if E_ENABLE_SHADER_RELOAD
+E_EXTERN struct EShaderReload* eCreateShaderReload(void);
+E_EXTERN void eDestroyShaderReload(struct EShaderReload* reload);
+E_EXTERN const struct EShaderCode*
+  ePollShaderReload(struct EShaderReload* reload, int bindless);
+#endif
+E_EXTERN void eCreateAllocator(EContext context);
+E_EXTERN void eDestroyAllocator(EContext context);
+E_EXTERN EResult eAllocateMemory(EContext context,
+  const VkMemoryRequirements* req,
+  VkMemoryPropertyFlags flags,
+  int optimal,
+  struct EAllocation* allocationOut);
+E_EXTERN void eFreeMemory(EContext context, struct EAllocation* allocation);
+E_EXTERN EResult eAllocateBufferMemory(EContext context,
+  VkBuffer buffer,
+  VkMemoryPropertyFlags flags,
+  struct EAllocation* allocationOut);
+E_EXTERN EResult eAllocateImageMemory(EContext context,
+  VkImage image,
+  VkMemoryPropertyFlags flags,
+  struct EAllocation* allocationOut);
+E_EXTERN void eResetArena(struct EArena* arena);
+E_EXTERN VkDeviceSize
+  eArenaPush(struct EArena* arena, VkDeviceSize size, VkDeviceSize alignment);
+E_EXTERN EResult eCommitArena(EContext context,
+  struct EArena* arena,
+  VkBufferUsageFlags usage);
+E_EXTERN EResult eReserveStreamBuffer(EContext context,
+  struct EStreamBuffer* stream,
+  VkDeviceSize size,
+  VkBufferUsageFlags usage);
+E_EXTERN void
+  eDestroyStreamBuffer(EContext context, struct EStreamBuffer* stream);
+E_EXTERN struct EUploadSlot* eAcquireUploadSlot(EContext context);
+E_EXTERN EResult eSubmitUpload(EContext context,
+  struct EUploadSlot* slot,
+  ETexture texture,
+  int region);
+E_EXTERN void eWaitForUpload(EContext context, ETexture texture);
+E_EXTERN void eUpdateTimelines(EContext context);
+E_EXTERN uint32_t eGetCpuCount(void);
+E_EXTERN EResult eCreateWorkerPool(struct EWorkerPool* pool, uint32_t count);
+E_EXTERN void eDestroyWorkerPool(struct EWorkerPool* pool);
+E_EXTERN void eRunWorkers(struct EWorkerPool* pool, EWorkFn fn, void* arg);
+E_EXTERN EResult eWaitTimeline(EContext context,
+  struct ETimeline* timeline,
+  uint64_t value);
+E_EXTERN uint64_t eNowNanoseconds(void);
+E_EXTERN uint64_t eProcessCpuNanoseconds(void);
+E_EXTERN FILE* eOpenFile(const char* path, const char* mode);
+E_EXTERN void* eCreateRectPacker(uint32_t pageSize);
+E_EXTERN void eResetRectPacker(void* packer, uint32_t pageSize);
+E_EXTERN int ePackRect(void* packer,
+  uint32_t width,
+  uint32_t height,
+  uint32_t* xOut,
+  uint32_t* yOut);
@@ -1,27 +1,47 @@
 #include "display.h"
 
+#include "context.h"
 #include "core.h"
+#include "renderer.h"
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-static void CleanFrames(EDisplay display, EContext context);
+static void CleanImages(EDisplay display, EContext context);
+static void RetireSwapchain(EDisplay display, EContext context);
+static void CollectRetired(EDisplay display, EContext context, int waitAll);
+static EResult WaitForFrame(EContext context, struct EFrame* frame);
+static void
+  ReadTimestamps(EDisplay display, EContext context, struct EFrame* frame);
 static void CreateSurface(EDisplay display, EContext context, EWindow window);
 static void SelectSurfaceFormat(EDisplay display, EContext context);
-static void SelectPresentMode(EDisplay display);
+static void
+  SelectPresentMode(EDisplay display, EContext context, EWindow window);
 static void CreateSwapchain(EDisplay display, EContext context, EWindow window);
 static void CreateRenderPass(EDisplay display, EContext context);
 static void CreateImageViews(EDisplay display, EContext context);
 static void CreateFrameBuffer(EDisplay display, EContext context);
-static void CreateCommandBuffer(EDisplay display, EContext context);
+static void CreateImageSemaphores(EDisplay display, EContext context);
+static void
+  CreateFrames(EDisplay display, EContext context, uint32_t framesInFlight);
+static void CreateOffscreenImages(EDisplay display, EContext context);
+static void BeginRendering(EDisplay display,
+  EContext context,
+  struct EFrame* frame,
+  struct ESwapchainImage* image,
+  int secondaries);
+static void EndRendering(EDisplay display,
+  EContext context,
+  struct EFrame* frame,
+  struct ESwapchainImage* image);
 
 E_EXTERN void
   eCreateDisplay(EDisplay* displayOut, EContext context, EWindow window) {
     if (!displayOut || !context || !window) {
         return;
     }
-    EDisplay display = malloc(sizeof(*display));
+    EDisplay display = eAlloc(sizeof(*display), E_MEMORY_SCOPE_DISPLAY);
     if (!display) {
         *displayOut = NULL;
         return;
@@ -30,63 +50,130 @@ E_EXTERN void
     *display = (struct EDisplay_t){ 0 };
 
     glfwGetFramebufferSize(window->window, &display->width, &display->height);
+    display->finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 
     CreateSurface(display, context, window);
     SelectSurfaceFormat(display, context);
-    SelectPresentMode(display);
+    SelectPresentMode(display, context, window);
     CreateSwapchain(display, context, window);
     CreateRenderPass(display, context);
     CreateImageViews(display, context);
     CreateFrameBuffer(display, context);
-    CreateCommandBuffer(display, context);
+    CreateImageSemaphores(display, context);
+    CreateFrames(display, context, window->framesInFlight);
+}
+
+// Same eRenderFrame/eDisplayFrame contract as a window's display, with a
+// NULL window. Every frame is rendered, unchanged or not, there is nothing
+// on screen that could be kept.
+E_EXTERN void eCreateOffscreenDisplay(EDisplay* displayOut,
+  EContext context,
+  EOffscreenDisplayCreateInfo* infoIn) {
+    if (!displayOut || !context) {
+        return;
+    }
+    EDisplay display = eAlloc(sizeof(*display), E_MEMORY_SCOPE_DISPLAY);
+    if (!display) {
+        *displayOut = NULL;
+        return;
+    }
+    *displayOut = display;
+    *display = (struct EDisplay_t){ 0 };
+    if (!infoIn) {
+        display->result = E_CREATE_INFO_MISSING;
+        return;
+    }
+    if (infoIn->width <= 0 || infoIn->height <= 0) {
+        display->result = E_CREATE_INFO_MISSING_VALUE;
+        return;
+    }
+    display->offscreen = 1;
+    display->width = infoIn->width;
+    display->height = infoIn->height;
+    // what swapchains mostly come in, keeps pixel tests comparable
+    display->surfaceFormat = (VkSurfaceFormatKHR){
+        .format = VK_FORMAT_B8G8R8A8_UNORM,
+        .colorSpace = VK_COLORSPACE_SRGB_NONLINEAR_KHR,
+    };
+    display->finalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+
+    CreateFrames(display, context, infoIn->framesInFlight);
+    CreateOffscreenImages(display, context);
+    CreateRenderPass(display, context);
+    CreateImageViews(display, context);
+    CreateFrameBuffer(display, context);
 }
 
 E_EXTERN void eDestroyDisplay(EDisplay display, EContext context) {
+    CollectRetired(display, context, 1);
+    CleanImages(display, context);
     struct EFrame* curF = { NULL };
     while (display->frameCount--) {
         curF = &display->frames[display->frameCount];
-        vkDestroyFramebuffer(context->device, curF->frameBuffer, NULL);
-        vkDestroyImageView(context->device, curF->imageView, NULL);
-        vkDestroyFence(context->device, curF->fence, NULL);
-        vkDestroyCommandPool(context->device, curF->commandPool, NULL);
-    }
-    struct EFrameSemaphores* curS = { NULL };
-    while (display->semaphoreCount--) {
-        curS = &display->semaphores[display->semaphoreCount];
-        vkDestroySemaphore(context->device, curS->imageAvailable, NULL);
-        vkDestroySemaphore(context->device, curS->renderFinished, NULL);
+        vkDestroySemaphore(
+          context->device, curF->imageAvailable, context->vkAllocator);
+        vkDestroyFence(context->device, curF->fence, context->vkAllocator);
+        vkDestroyQueryPool(
+          context->device, curF->queryPool, context->vkAllocator);
+        vkDestroyCommandPool(
+          context->device, curF->commandPool, context->vkAllocator);
     }
 
-    vkDestroyRenderPass(context->device, display->renderPass, NULL);
-    vkDestroySwapchainKHR(context->device, display->swapchain, NULL);
-    vkDestroySurfaceKHR(context->instance, display->surface, NULL);
-    free(display);
+    vkDestroyRenderPass(
+      context->device, display->renderPass, context->vkAllocator);
+    // the WSI functions may not even be loaded for offscreen displays
+    if (!display->offscreen) {
+        vkDestroySwapchainKHR(
+          context->device, display->swapchain, context->vkAllocator);
+        vkDestroySurfaceKHR(
+          context->instance, display->surface, context->vkAllocator);
+    }
+    eFree(display);
 }
 
-E_EXTERN void eDisplayFrame(EDisplay display, EContext context) {
-    if (display->result != E_SUCCESS) {
+E_EXTERN void
+  eDisplayFrame(EDisplay display, EContext context, EWindow window) {
+    if (display->result != E_SUCCESS || display->frameSkipped) {
+        // what was spent on a frame that never showed isn't carried over
+        memset(display->cpuNanoseconds, 0, sizeof(display->cpuNanoseconds));
         return;
     }
     VkResult err = { 0 };
 
-    VkSemaphore renderFinished =
-      display->semaphores[display->semaphoreCurrentIndex].renderFinished;
-
-    VkPresentInfoKHR pi = {
-        .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
-        .pImageIndices = &display->frameCurrentIndex,
-        .pSwapchains = &display->swapchain,
-        .swapchainCount = 1,
-        .waitSemaphoreCount = 1,
-        .pWaitSemaphores = &renderFinished,
-    };
-    err = vkQueuePresentKHR(context->queue, &pi);
-    if (err != VK_SUCCESS) {
-        display->result = E_FRAME_DISPLAY_ERROR;
-        return;
+    if (!display->offscreen) {
+        VkSemaphore renderFinished =
+          display->images[display->imageIndex].renderFinished;
+
+        VkPresentInfoKHR pi = {
+            .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
+            .pImageIndices = &display->imageIndex,
+            .pSwapchains = &display->swapchain,
+            .swapchainCount = 1,
+            .waitSemaphoreCount = 1,
+            .pWaitSemaphores = &renderFinished,
+        };
+        eBeginCpuPhase(display, E_CPU_PHASE_PRESENT);
+        err = vkQueuePresentKHR(context->queue, &pi);
+        eEndCpuPhase(display, E_CPU_PHASE_PRESENT);
+        // the present still waits on renderFinished, so like an acquire the
+        // swapchain is only recreated before the next frame
+        if (err == VK_ERROR_OUT_OF_DATE_KHR || err == VK_SUBOPTIMAL_KHR) {
+            window->shouldResize = 1;
+        }
+        else if (err != VK_SUCCESS) {
+            display->presentedValid = 0;
+            display->result = E_FRAME_DISPLAY_ERROR;
+            return;
+        }
     }
-    display->semaphoreCurrentIndex =
-      (display->semaphoreCurrentIndex + 1) % display->semaphoreCount;
+    display->presentedHash = display->pendingHash;
+    display->presentedValid = 1;
+    display->stats.renderedFrames++;
+    memcpy(display->timings.cpuNanoseconds,
+      display->cpuNanoseconds,
+      sizeof(display->cpuNanoseconds));
+    memset(display->cpuNanoseconds, 0, sizeof(display->cpuNanoseconds));
+    display->frameIndex = (display->frameIndex + 1) % display->frameCount;
 }
 
 E_EXTERN void
@@ -99,34 +186,214 @@ E_EXTERN void
     CreateRenderPass(display, context);
     CreateImageViews(display, context);
     CreateFrameBuffer(display, context);
-    CreateCommandBuffer(display, context);
+    CreateImageSemaphores(display, context);
 
-    display->frameCurrentIndex = 0;
+    display->presentedValid = 0;
     window->shouldResize = 0;
 }
 
+E_EXTERN void eGetDisplayStats(EDisplay display, EDisplayStats* statsOut) {
+    if (!display || !statsOut) {
+        return;
+    }
+    *statsOut = display->stats;
+    statsOut->processCpuNanoseconds = eProcessCpuNanoseconds();
+}
+
+// Phases are summed up per frame, a phase can be timed more than once.
+E_EXTERN void eBeginCpuPhase(EDisplay display, ECpuPhase phase) {
+    display->cpuPhaseStart[phase] = eNowNanoseconds();
+}
+
+E_EXTERN void eEndCpuPhase(EDisplay display, ECpuPhase phase) {
+    display->cpuNanoseconds[phase] +=
+      eNowNanoseconds() - display->cpuPhaseStart[phase];
+}
+
+E_EXTERN void eGetFrameTimings(EDisplay display, EFrameTimings* timingsOut) {
+    if (!display || !timingsOut) {
+        return;
+    }
+    *timingsOut = display->timings;
+}
+
+// Copies the image of the last displayed frame of an offscreen display into
+// pixelsOut, width * height tightly packed BGRA8 texels. Waits for the
+// device, meant for pixel tests rather than every frame.
+E_EXTERN EResult
+  eReadDisplayPixels(EDisplay display, EContext context, void* pixelsOut) {
+    if (!display->offscreen || display->result != E_SUCCESS) {
+        return E_FAILURE;
+    }
+    if (display->stats.renderedFrames == 0) {
+        return E_FAILURE;
+    }
+    VkResult err = { 0 };
+    EResult res = { E_SUCCESS };
+    VkDeviceSize size = (VkDeviceSize)display->width * display->height * 4;
+
+    if (vkDeviceWaitIdle(context->device) != VK_SUCCESS) {
+        return E_SYNC_FAILURE;
+    }
+    struct EStreamBuffer staging = { 0 };
+    VkCommandPool pool = { VK_NULL_HANDLE };
+    VkCommandBuffer cmd = { VK_NULL_HANDLE };
+    VkFence fence = { VK_NULL_HANDLE };
+
+    res = eReserveStreamBuffer(
+      context, &staging, size, VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+    VkCommandPoolCreateInfo cpci = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+        .queueFamilyIndex = context->graphicsQueueFamilyIndex,
+    };
+    if (res == E_SUCCESS
+        && vkCreateCommandPool(
+             context->device, &cpci, context->vkAllocator, &pool)
+             != VK_SUCCESS) {
+        res = E_CREATE_COMMAND_POOL_FAILURE;
+    }
+    VkCommandBufferAllocateInfo cbai = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .commandBufferCount = 1,
+        .commandPool = pool,
+        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+    };
+    if (res == E_SUCCESS
+        && vkAllocateCommandBuffers(context->device, &cbai, &cmd)
+             != VK_SUCCESS) {
+        res = E_CREATE_COMMAND_BUFFER_FAILURE;
+    }
+    VkFenceCreateInfo fci = {
+        .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+    };
+    if (res == E_SUCCESS
+        && vkCreateFence(context->device, &fci, context->vkAllocator, &fence)
+             != VK_SUCCESS) {
+        res = E_CREATE_FENCE_FAILURE;
+    }
+
+    if (res == E_SUCCESS) {
+        VkCommandBufferBeginInfo cbbi = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+            .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+        };
+        err = vkBeginCommandBuffer(cmd, &cbbi);
+
+        // frames leave their image in TRANSFER_SRC_OPTIMAL
+        VkBufferImageCopy bic = {
+            .imageSubresource = {
+                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                .layerCount = 1,
+            },
+            .imageExtent = {
+                .width = (uint32_t)display->width,
+                .height = (uint32_t)display->height,
+                .depth = 1,
+            },
+        };
+        vkCmdCopyImageToBuffer(cmd,
+          display->images[display->imageIndex].image,
+          VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+          staging.buffer,
+          1,
+          &bic);
+        VkMemoryBarrier mb = {
+            .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_HOST_READ_BIT,
+        };
+        vkCmdPipelineBarrier(cmd,
+          VK_PIPELINE_STAGE_TRANSFER_BIT,
+          VK_PIPELINE_STAGE_HOST_BIT,
+          0,
+          1,
+          &mb,
+          0,
+          NULL,
+          0,
+          NULL);
+        if (err == VK_SUCCESS) {
+            err = vkEndCommandBuffer(cmd);
+        }
+        VkSubmitInfo si = {
+            .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+            .commandBufferCount = 1,
+            .pCommandBuffers = &cmd,
+        };
+        if (err == VK_SUCCESS) {
+            err = vkQueueSubmit(context->queue, 1, &si, fence);
+        }
+        if (err == VK_SUCCESS) {
+            err = vkWaitForFences(context->device, 1, &fence, 1, UINT64_MAX);
+        }
+        if (err == VK_SUCCESS) {
+            memcpy(pixelsOut, staging.mapped, (size_t)size);
+        }
+        else {
+            res = E_FRAME_RENDER_ERROR;
+        }
+    }
+
+    vkDestroyFence(context->device, fence, context->vkAllocator);
+    vkDestroyCommandPool(context->device, pool, context->vkAllocator);
+    eDestroyStreamBuffer(context, &staging);
+    return res;
+}
+
 E_EXTERN void eRenderFrame(EDisplay display, EContext context, EWindow window) {
     if (display->result != E_SUCCESS) {
         return;
     }
     VkResult err = { 0 };
 
-    struct EFrameSemaphores* curS =
-      &display->semaphores[display->semaphoreCurrentIndex];
+    // textures finishing their upload become drawable this frame
+    eUpdateUploads(context);
 
-    VkSemaphore imgAvailable = curS->imageAvailable;
-    VkSemaphore renderFinished = curS->renderFinished;
+    // the presented image is still on screen, nothing to do if it would
+    // come out byte identical
+    uint64_t hash = { context->uploadEpoch };
+    if (display->renderer) {
+        hash ^= eHashDrawData(display->renderer);
+    }
+    if (!display->offscreen && display->presentedValid
+        && hash == display->presentedHash && !window->shouldResize) {
+        display->frameSkipped = 1;
+        display->stats.skippedFrames++;
+        return;
+    }
+    display->frameSkipped = 0;
+    display->pendingHash = hash;
+
+    struct EFrame* curF = &display->frames[display->frameIndex];
+
+    // Waiting before acquiring bounds how far the CPU runs ahead to the
+    // number of frames in flight, whatever the driver's image count is.
+    if (WaitForFrame(context, curF) != E_SUCCESS) {
+        display->result = E_FRAME_RENDER_ERROR;
+        return;
+    }
+    CollectRetired(display, context, 0);
+    ReadTimestamps(display, context, curF);
 
-    err = vkAcquireNextImageKHR(context->device,
-      display->swapchain,
-      UINT32_MAX,
-      imgAvailable,
-      VK_NULL_HANDLE,
-      &display->frameCurrentIndex);
+    // the offscreen image of a frame is free once the frame was waited on
+    if (display->offscreen) {
+        display->imageIndex = display->frameIndex;
+    }
+    else {
+        err = vkAcquireNextImageKHR(context->device,
+          display->swapchain,
+          UINT64_MAX,
+          curF->imageAvailable,
+          VK_NULL_HANDLE,
+          &display->imageIndex);
+    }
 
     if (err == VK_ERROR_OUT_OF_DATE_KHR || err == VK_SUBOPTIMAL_KHR) {
         window->shouldResize = 1;
+        display->presentedValid = 0;
         if (err == VK_ERROR_OUT_OF_DATE_KHR) {
+            display->frameSkipped = 1;
             return;
         }
     }
@@ -135,17 +402,17 @@ E_EXTERN void eRenderFrame(EDisplay display, EContext context, EWindow window) {
         return;
     }
 
-    struct EFrame* curF = &display->frames[display->frameCurrentIndex];
+    struct ESwapchainImage* curI = &display->images[display->imageIndex];
 
-    err = vkWaitForFences(context->device, 1, &curF->fence, 1, UINT32_MAX);
-    if (err != VK_SUCCESS) {
-        display->result = E_FRAME_RENDER_ERROR;
-    }
-    err = vkResetFences(context->device, 1, &curF->fence);
-    if (err != VK_SUCCESS) {
-        display->result = E_FRAME_RENDER_ERROR;
+    // only reset once a submission that signals it is guaranteed
+    if (!context->timelineSemaphores) {
+        err = vkResetFences(context->device, 1, &curF->fence);
+        if (err != VK_SUCCESS) {
+            display->result = E_FRAME_RENDER_ERROR;
+        }
     }
 
+    eBeginCpuPhase(display, E_CPU_PHASE_RECORD);
     err = vkResetCommandPool(context->device, curF->commandPool, 0);
     if (err != VK_SUCCESS) {
         display->result = E_FRAME_RENDER_ERROR;
@@ -158,50 +425,167 @@ E_EXTERN void eRenderFrame(EDisplay display, EContext context, EWindow window) {
     if (err != VK_SUCCESS) {
         display->result = E_FRAME_RENDER_ERROR;
     }
+    if (curF->queryPool) {
+        vkCmdResetQueryPool(
+          curF->commandBuffer, curF->queryPool, 0, E_MAX_TIMED_DRAW_LISTS + 2);
+        vkCmdWriteTimestamp(curF->commandBuffer,
+          VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+          curF->queryPool,
+          0);
+    }
 
-    VkRenderPassBeginInfo rpbi = {
-        .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
-        .renderPass = display->renderPass,
-        .renderArea.extent = { 
-            .width = display->width,
-            .height = display->height, 
-        },
-        .clearValueCount = 1,
-        .pClearValues = &display->clearValue,
-        .framebuffer = curF->frameBuffer,
-    };
-    vkCmdBeginRenderPass(
-      curF->commandBuffer, &rpbi, VK_SUBPASS_CONTENTS_INLINE);
+    // big draw data gets recorded on worker threads before the pass begins,
+    // the pass then only executes their secondary command buffers
+    int secondaries = { 0 };
+    if (display->renderer) {
+        secondaries = ePrepareDrawData(display->renderer, context, display);
+    }
+    BeginRendering(display, context, curF, curI, secondaries);
 
-    vkCmdEndRenderPass(curF->commandBuffer);
-    VkPipelineStageFlags psf = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    if (display->renderer) {
+        eRecordDrawData(display->renderer, context, display);
+    }
+
+    EndRendering(display, context, curF, curI);
+    if (curF->queryPool) {
+        vkCmdWriteTimestamp(curF->commandBuffer,
+          VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+          curF->queryPool,
+          E_MAX_TIMED_DRAW_LISTS + 1);
+    }
+    struct ETimeline* timeline = &context->graphicsTimeline;
+    // Textures are only drawn once their upload was seen completed, waiting
+    // for that transfer value makes the copies and layout transitions
+    // visible to the fragment shader. It is already signaled, so it doesn't
+    // stall. Fence mode has no semaphore and relies on the host observing
+    // the upload fence.
+    VkSemaphore waits[2] = {
+        curF->imageAvailable,
+        context->transferTimeline.semaphore,
+    };
+    uint64_t waitValues[2] = { 0, context->transferTimeline.completed };
+    VkPipelineStageFlags psf[2] = {
+        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+    };
+    // binary semaphores ignore their value, offscreen frames neither wait
+    // for an acquire nor signal a present
+    VkSemaphore signals[2] = { curI->renderFinished, timeline->semaphore };
+    uint64_t values[2] = { 0, timeline->submitted + 1 };
+    uint32_t firstWait = { display->offscreen ? 1 : 0 };
+    uint32_t waitCount = (context->timelineSemaphores ? 2 : 1) - firstWait;
+    uint32_t firstSignal = { display->offscreen ? 1 : 0 };
+    uint32_t signalCount = (context->timelineSemaphores ? 2 : 1) - firstSignal;
+    VkTimelineSemaphoreSubmitInfo tssi = {
+        .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+        .waitSemaphoreValueCount = waitCount,
+        .pWaitSemaphoreValues = waitValues + firstWait,
+        .signalSemaphoreValueCount = signalCount,
+        .pSignalSemaphoreValues = values + firstSignal,
+    };
     VkSubmitInfo si = {
         .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .pNext = context->timelineSemaphores ? &tssi : NULL,
         .commandBufferCount = 1,
         .pCommandBuffers = &curF->commandBuffer,
-        .signalSemaphoreCount = 1,
-        .pSignalSemaphores = &renderFinished,
-        .waitSemaphoreCount = 1,
-        .pWaitSemaphores = &imgAvailable,
-        .pWaitDstStageMask = &psf,
+        .signalSemaphoreCount = signalCount,
+        .pSignalSemaphores = signals + firstSignal,
+        .waitSemaphoreCount = waitCount,
+        .pWaitSemaphores = waits + firstWait,
+        .pWaitDstStageMask = psf + firstWait,
     };
     err = vkEndCommandBuffer(curF->commandBuffer);
     if (err != VK_SUCCESS) {
         display->result = E_FRAME_RENDER_ERROR;
     }
+    eEndCpuPhase(display, E_CPU_PHASE_RECORD);
 
+    eBeginCpuPhase(display, E_CPU_PHASE_SUBMIT);
     err = vkQueueSubmit(context->queue, 1, &si, curF->fence);
+    eEndCpuPhase(display, E_CPU_PHASE_SUBMIT);
     if (err != VK_SUCCESS) {
         display->result = E_FRAME_RENDER_ERROR;
+        return;
+    }
+    curF->serial = ++timeline->submitted;
+    curF->queriesWritten = curF->queryPool != VK_NULL_HANDLE;
+    curF->timedLists = 0;
+    if (display->renderer && display->renderer->drawData) {
+        uint32_t lists = { display->renderer->drawData->listCount };
+        curF->timedLists =
+          lists < E_MAX_TIMED_DRAW_LISTS ? lists : E_MAX_TIMED_DRAW_LISTS;
+    }
+}
+
+static uint64_t
+  TicksToNanoseconds(EContext context, uint64_t begin, uint64_t end) {
+    // the bits above the valid ones are undefined
+    uint64_t mask = context->timestampValidBits < 64
+                      ? (1ull << context->timestampValidBits) - 1
+                      : UINT64_MAX;
+    double period = (double)context->properties.limits.timestampPeriod;
+    return (uint64_t)((double)((end - begin) & mask) * period);
+}
+
+// Called right after the frame was waited on, so the results are there and
+// reading them doesn't stall. Lists that recorded nothing have no timestamp,
+// each list ends where the next timestamp after its start was written.
+static void
+  ReadTimestamps(EDisplay display, EContext context, struct EFrame* frame) {
+    if (!frame->queriesWritten) {
+        return;
+    }
+    frame->queriesWritten = 0;
+
+    // value and availability pairs
+    uint64_t results[E_MAX_TIMED_DRAW_LISTS + 2][2] = { 0 };
+    VkResult err = vkGetQueryPoolResults(context->device,
+      frame->queryPool,
+      0,
+      E_MAX_TIMED_DRAW_LISTS + 2,
+      sizeof(results),
+      results,
+      sizeof(results[0]),
+      VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+    uint32_t last = { E_MAX_TIMED_DRAW_LISTS + 1 };
+    if ((err != VK_SUCCESS && err != VK_NOT_READY) || !results[0][1]
+        || !results[last][1]) {
+        return;
+    }
+
+    EFrameTimings* timings = &display->timings;
+    timings->gpuValid = 1;
+    timings->gpuNanoseconds =
+      TicksToNanoseconds(context, results[0][0], results[last][0]);
+    timings->gpuListCount = frame->timedLists;
+    for (uint32_t i = 0; i < E_MAX_TIMED_DRAW_LISTS; ++i) {
+        timings->gpuListNanoseconds[i] = 0;
+        if (i >= frame->timedLists || !results[1 + i][1]) {
+            continue;
+        }
+        uint32_t next = { 2 + i };
+        while (next < last && (next > frame->timedLists || !results[next][1])) {
+            ++next;
+        }
+        timings->gpuListNanoseconds[i] =
+          TicksToNanoseconds(context, results[1 + i][0], results[next][0]);
     }
 }
 
-static void CreateCommandBuffer(EDisplay display, EContext context) {
+static void
+  CreateFrames(EDisplay display, EContext context, uint32_t framesInFlight) {
     if (display->result != E_SUCCESS) {
         return;
     }
     VkResult err = { 0 };
 
+    display->frameCount =
+      framesInFlight ? framesInFlight : E_DEFAULT_FRAMES_IN_FLIGHT;
+    if (display->frameCount > E_MAX_FRAMES) {
+        display->frameCount = E_MAX_FRAMES;
+    }
+    display->frameIndex = 0;
+
     uint32_t count = { display->frameCount };
     struct EFrame* curF = { NULL };
     while (count--) {
@@ -211,8 +595,8 @@ static void CreateCommandBuffer(EDisplay display, EContext context) {
             .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
             .queueFamilyIndex = context->graphicsQueueFamilyIndex,
         };
-        err =
-          vkCreateCommandPool(context->device, &cpci, NULL, &curF->commandPool);
+        err = vkCreateCommandPool(
+          context->device, &cpci, context->vkAllocator, &curF->commandPool);
         if (err != VK_SUCCESS) {
             display->result = E_CREATE_COMMAND_POOL_FAILURE;
             return;
@@ -235,31 +619,59 @@ static void CreateCommandBuffer(EDisplay display, EContext context) {
             .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
             .flags = VK_FENCE_CREATE_SIGNALED_BIT,
         };
-        err = vkCreateFence(context->device, &fci, NULL, &curF->fence);
+        if (!context->timelineSemaphores) {
+            err = vkCreateFence(
+              context->device, &fci, context->vkAllocator, &curF->fence);
+        }
         if (err != VK_SUCCESS) {
             display->result = E_CREATE_FENCE_FAILURE;
             return;
         }
-    }
-
-    count = display->semaphoreCount;
-    struct EFrameSemaphores* curS = { NULL };
-    while (count--) {
-        curS = &display->semaphores[count];
 
         VkSemaphoreCreateInfo sci = {
             .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
         };
-
-        err =
-          vkCreateSemaphore(context->device, &sci, NULL, &curS->imageAvailable);
+        err = vkCreateSemaphore(
+          context->device, &sci, context->vkAllocator, &curF->imageAvailable);
         if (err != VK_SUCCESS) {
             display->result = E_CREATE_SEMAPHORE_FAILURE;
             return;
         }
 
-        err =
-          vkCreateSemaphore(context->device, &sci, NULL, &curS->renderFinished);
+#if E_ENABLE_GPU_TIMESTAMPS
+        // timings are optional, frames go untimed when this fails
+        VkQueryPoolCreateInfo qpci = {
+            .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+            .queryType = VK_QUERY_TYPE_TIMESTAMP,
+            .queryCount = E_MAX_TIMED_DRAW_LISTS + 2,
+        };
+        if (context->timestampValidBits
+            && vkCreateQueryPool(
+                 context->device, &qpci, context->vkAllocator, &curF->queryPool)
+                 != VK_SUCCESS) {
+            curF->queryPool = VK_NULL_HANDLE;
+        }
+#endif
+    }
+}
+
+// Presentation waits on these, so they belong to the image rather than the
+// frame: the image can't be acquired again before its present finished.
+static void CreateImageSemaphores(EDisplay display, EContext context) {
+    if (display->result != E_SUCCESS) {
+        return;
+    }
+    VkResult err = { 0 };
+
+    VkSemaphoreCreateInfo sci = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+    };
+    uint32_t count = { display->imageCount };
+    struct ESwapchainImage* curI = { NULL };
+    while (count--) {
+        curI = &display->images[count];
+        err = vkCreateSemaphore(
+          context->device, &sci, context->vkAllocator, &curI->renderFinished);
         if (err != VK_SUCCESS) {
             display->result = E_CREATE_SEMAPHORE_FAILURE;
             return;
@@ -267,10 +679,59 @@ static void CreateCommandBuffer(EDisplay display, EContext context) {
     }
 }
 
+static void CreateOffscreenImages(EDisplay display, EContext context) {
+    if (display->result != E_SUCCESS) {
+        return;
+    }
+    VkResult err = { 0 };
+
+    VkImageCreateInfo ici = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+        .imageType = VK_IMAGE_TYPE_2D,
+        .format = display->surfaceFormat.format,
+        .extent = {
+            .width = (uint32_t)display->width,
+            .height = (uint32_t)display->height,
+            .depth = 1,
+        },
+        .mipLevels = 1,
+        .arrayLayers = 1,
+        .samples = VK_SAMPLE_COUNT_1_BIT,
+        .tiling = VK_IMAGE_TILING_OPTIMAL,
+        .usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT
+                 | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+    };
+    while (display->imageCount < display->frameCount) {
+        struct ESwapchainImage* curr = &display->images[display->imageCount];
+        err = vkCreateImage(
+          context->device, &ici, context->vkAllocator, &curr->image);
+        if (err != VK_SUCCESS) {
+            display->result = E_CREATE_IMAGE_FAILURE;
+            return;
+        }
+        // counted right away so that cleanup finds the image
+        display->imageCount++;
+
+        display->result = eAllocateImageMemory(context,
+          curr->image,
+          VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+          &curr->allocation);
+        if (display->result != E_SUCCESS) {
+            return;
+        }
+    }
+}
+
 static void CreateFrameBuffer(EDisplay display, EContext context) {
     if (display->result != E_SUCCESS) {
         return;
     }
+    // dynamic rendering draws straight into the image views
+    if (context->dynamicRendering) {
+        return;
+    }
     VkResult err = { 0 };
 
     VkFramebufferCreateInfo fci = {
@@ -281,13 +742,13 @@ static void CreateFrameBuffer(EDisplay display, EContext context) {
         .layers = 1,
         .renderPass = display->renderPass,
     };
-    uint32_t count = { display->frameCount };
-    struct EFrame* curr = { NULL };
+    uint32_t count = { display->imageCount };
+    struct ESwapchainImage* curr = { NULL };
     while (count--) {
-        curr = &display->frames[count];
+        curr = &display->images[count];
         fci.pAttachments = &curr->imageView;
-        err =
-          vkCreateFramebuffer(context->device, &fci, NULL, &curr->frameBuffer);
+        err = vkCreateFramebuffer(
+          context->device, &fci, context->vkAllocator, &curr->frameBuffer);
         if (err != VK_SUCCESS) {
             display->result = E_CREATE_FRAMEBUFFER_FAILURE;
             return;
@@ -320,13 +781,14 @@ static void CreateImageViews(EDisplay display, EContext context) {
         },
     };
 
-    uint32_t count = { display->frameCount };
-    struct EFrame* curr = { NULL };
+    uint32_t count = { display->imageCount };
+    struct ESwapchainImage* curr = { NULL };
     while (count--) {
-        curr = &display->frames[count];
+        curr = &display->images[count];
         ivci.image = curr->image;
 
-        err = vkCreateImageView(context->device, &ivci, NULL, &curr->imageView);
+        err = vkCreateImageView(
+          context->device, &ivci, context->vkAllocator, &curr->imageView);
         if (err != VK_SUCCESS) {
             display->result = E_CREATE_IMAGE_VIEW_FAILURE;
             return;
@@ -339,10 +801,32 @@ static void CreateRenderPass(EDisplay display, EContext context) {
     if (display->result != E_SUCCESS) {
         return;
     }
+    if (context->dynamicRendering) {
+        return;
+    }
+    // attachments only depend on the format, resizes can keep the pass
+    if (display->renderPass
+        && display->renderPassFormat == display->surfaceFormat.format) {
+        return;
+    }
     VkResult err = { 0 };
 
+    if (display->renderPass) {
+        // pipelines built against it stay compatible only with the same
+        // format, so a format change has to wait for the GPU either way
+        err = vkDeviceWaitIdle(context->device);
+        if (err != VK_SUCCESS) {
+            display->result = E_SYNC_FAILURE;
+            return;
+        }
+        vkDestroyRenderPass(
+          context->device, display->renderPass, context->vkAllocator);
+        display->renderPass = VK_NULL_HANDLE;
+    }
+    display->renderPassFormat = display->surfaceFormat.format;
+
     VkAttachmentDescription attDesc = {
-        .finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+        .finalLayout = display->finalLayout,
         .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
         .format = display->surfaceFormat.format,
         .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
@@ -377,60 +861,252 @@ static void CreateRenderPass(EDisplay display, EContext context) {
         .pDependencies = &dep,
         .dependencyCount = 1,
     };
-    err =
-      vkCreateRenderPass(context->device, &rpci, NULL, &display->renderPass);
+    err = vkCreateRenderPass(
+      context->device, &rpci, context->vkAllocator, &display->renderPass);
     if (err != VK_SUCCESS) {
         display->result = E_CREATE_RENDER_PASS_FAILURE;
     }
 }
 
-static void DestroyFrames(EDisplay display, EContext context) {
-    uint32_t count = display->frameCount;
-    struct EFrame* curr = { 0 };
-    while (count--) {
-        curr = &display->frames[count];
-
-        vkDestroyFence(context->device, curr->fence, NULL);
-        curr->fence = VK_NULL_HANDLE;
+static void BeginRenderPass(EDisplay display,
+  struct EFrame* frame,
+  struct ESwapchainImage* image,
+  int secondaries) {
+    VkRenderPassBeginInfo rpbi = {
+        .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+        .renderPass = display->renderPass,
+        .renderArea.extent = {
+            .width = display->width,
+            .height = display->height,
+        },
+        .clearValueCount = 1,
+        .pClearValues = &display->clearValue,
+        .framebuffer = image->frameBuffer,
+    };
+    vkCmdBeginRenderPass(frame->commandBuffer,
+      &rpbi,
+      secondaries ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS
+                  : VK_SUBPASS_CONTENTS_INLINE);
+}
 
-        vkFreeCommandBuffers(
-          context->device, curr->commandPool, 1, &curr->commandBuffer);
-        curr->commandBuffer = VK_NULL_HANDLE;
+// The layout transitions the render pass did implicitly. The previous
+// contents are cleared anyway, so the image starts out UNDEFINED.
+static void BeginDynamicRendering(EDisplay display,
+  EContext context,
+  struct EFrame* frame,
+  struct ESwapchainImage* image,
+  int secondaries) {
+    VkImageMemoryBarrier imb = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .srcAccessMask = 0,
+        .dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+        .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        .newLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = image->image,
+        .subresourceRange = {
+            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+            .levelCount = 1,
+            .layerCount = 1,
+        },
+    };
+    // same stage the acquire semaphore is waited on
+    vkCmdPipelineBarrier(frame->commandBuffer,
+      VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+      VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+      0,
+      0,
+      NULL,
+      0,
+      NULL,
+      1,
+      &imb);
+
+    VkRenderingAttachmentInfo rai = {
+        .sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
+        .imageView = image->imageView,
+        .imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+        .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+        .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+        .clearValue = display->clearValue,
+    };
+    VkRenderingInfo ri = {
+        .sType = VK_STRUCTURE_TYPE_RENDERING_INFO,
+        .flags = secondaries
+                   ? VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT
+                   : 0,
+        .renderArea.extent = {
+            .width = display->width,
+            .height = display->height,
+        },
+        .layerCount = 1,
+        .colorAttachmentCount = 1,
+        .pColorAttachments = &rai,
+    };
+    context->cmdBeginRendering(frame->commandBuffer, &ri);
+}
 
-        vkDestroyCommandPool(context->device, curr->commandPool, NULL);
-        curr->commandPool = VK_NULL_HANDLE;
+static void EndDynamicRendering(EDisplay display,
+  EContext context,
+  struct EFrame* frame,
+  struct ESwapchainImage* image) {
+    context->cmdEndRendering(frame->commandBuffer);
+
+    VkImageMemoryBarrier imb = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+        .dstAccessMask = 0,
+        .oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+        .newLayout = display->finalLayout,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = image->image,
+        .subresourceRange = {
+            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+            .levelCount = 1,
+            .layerCount = 1,
+        },
+    };
+    // the present waits on the renderFinished semaphore, a readback waits
+    // for the whole queue, nothing to block
+    vkCmdPipelineBarrier(frame->commandBuffer,
+      VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+      VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+      0,
+      0,
+      NULL,
+      0,
+      NULL,
+      1,
+      &imb);
+}
 
-        vkDestroyImageView(context->device, curr->imageView, NULL);
-        curr->imageView = VK_NULL_HANDLE;
+static void BeginRendering(EDisplay display,
+  EContext context,
+  struct EFrame* frame,
+  struct ESwapchainImage* image,
+  int secondaries) {
+    if (context->dynamicRendering) {
+        BeginDynamicRendering(display, context, frame, image, secondaries);
+    }
+    else {
+        BeginRenderPass(display, frame, image, secondaries);
+    }
+}
 
-        vkDestroyFramebuffer(context->device, curr->frameBuffer, NULL);
-        curr->frameBuffer = VK_NULL_HANDLE;
+static void EndRendering(EDisplay display,
+  EContext context,
+  struct EFrame* frame,
+  struct ESwapchainImage* image) {
+    if (context->dynamicRendering) {
+        EndDynamicRendering(display, context, frame, image);
+    }
+    else {
+        vkCmdEndRenderPass(frame->commandBuffer);
     }
 }
 
-static void DestroySemaphores(EDisplay display, EContext context) {
-    uint32_t count = { display->semaphoreCount };
-    struct EFrameSemaphores* curr = { NULL };
+static void CleanImages(EDisplay display, EContext context) {
+    uint32_t count = { display->imageCount };
+    struct ESwapchainImage* curr = { NULL };
     while (count--) {
-        curr = &display->semaphores[count];
-        vkDestroySemaphore(context->device, curr->imageAvailable, NULL);
-        curr->imageAvailable = NULL;
-        vkDestroySemaphore(context->device, curr->renderFinished, NULL);
-        curr->renderFinished = NULL;
+        curr = &display->images[count];
+
+        vkDestroyFramebuffer(
+          context->device, curr->frameBuffer, context->vkAllocator);
+        vkDestroyImageView(
+          context->device, curr->imageView, context->vkAllocator);
+        vkDestroySemaphore(
+          context->device, curr->renderFinished, context->vkAllocator);
+        if (display->offscreen) {
+            vkDestroyImage(context->device, curr->image, context->vkAllocator);
+            eFreeMemory(context, &curr->allocation);
+        }
+        *curr = (struct ESwapchainImage){ 0 };
     }
+    display->imageCount = 0;
 }
 
-static void CleanFrames(EDisplay display, EContext context) {
-    DestroyFrames(display, context);
-    DestroySemaphores(display, context);
+// Waits for the frame's last submit. The queue executes in order, so the
+// graphics timeline has reached that frame's value either way.
+static EResult WaitForFrame(EContext context, struct EFrame* frame) {
+    struct ETimeline* timeline = &context->graphicsTimeline;
+    if (context->timelineSemaphores) {
+        return eWaitTimeline(context, timeline, frame->serial);
+    }
+    if (vkWaitForFences(context->device, 1, &frame->fence, 1, UINT64_MAX)
+        != VK_SUCCESS) {
+        return E_SYNC_FAILURE;
+    }
+    if (frame->serial > timeline->completed) {
+        timeline->completed = frame->serial;
+    }
+    return E_SUCCESS;
+}
 
-    free(display->frames);
-    free(display->semaphores);
-    display->frameCount = 0;
+// Moves the current swapchain and its per image objects to the retired list.
+// Presents aren't fenced, so they are kept until a frame submitted after the
+// retirement has finished, by then the presents queued before it are done.
+static void RetireSwapchain(EDisplay display, EContext context) {
+    if (!display->swapchain) {
+        return;
+    }
+    if (display->retiredCount == E_MAX_RETIRED_SWAPCHAINS) {
+        CollectRetired(display, context, 1);
+    }
+    struct ERetiredSwapchain* ret = &display->retired[display->retiredCount++];
+    ret->swapchain = display->swapchain;
+    ret->imageCount = display->imageCount;
+    ret->serial = context->graphicsTimeline.submitted + 1;
+    memcpy(ret->images, display->images, sizeof(ret->images));
+
+    memset(display->images, 0, sizeof(display->images));
+    display->imageCount = 0;
+    display->swapchain = VK_NULL_HANDLE;
+}
 
-    if (display->renderPass) {
-        vkDestroyRenderPass(context->device, display->renderPass, NULL);
+static void DestroyRetired(struct ERetiredSwapchain* ret, EContext context) {
+    struct ESwapchainImage* curr = { NULL };
+    while (ret->imageCount--) {
+        curr = &ret->images[ret->imageCount];
+        vkDestroyFramebuffer(
+          context->device, curr->frameBuffer, context->vkAllocator);
+        vkDestroyImageView(
+          context->device, curr->imageView, context->vkAllocator);
+        vkDestroySemaphore(
+          context->device, curr->renderFinished, context->vkAllocator);
     }
+    vkDestroySwapchainKHR(
+      context->device, ret->swapchain, context->vkAllocator);
+    *ret = (struct ERetiredSwapchain){ 0 };
+}
+
+// Destroys retired swapchains the GPU is done with. waitAll first waits for
+// every frame in flight, which only happens on teardown or when the retired
+// list overflows during a very fast resize drag.
+static void CollectRetired(EDisplay display, EContext context, int waitAll) {
+    uint64_t completed = { context->graphicsTimeline.completed };
+    if (waitAll && display->retiredCount) {
+        EResult res = { E_SUCCESS };
+        for (uint32_t i = 0; i < display->frameCount && res == E_SUCCESS; ++i) {
+            res = WaitForFrame(context, &display->frames[i]);
+        }
+        if (res == E_SUCCESS) {
+            // nothing is left in flight, not even a frame yet to be submitted
+            completed = UINT64_MAX;
+        }
+    }
+    uint32_t kept = { 0 };
+    for (uint32_t i = 0; i < display->retiredCount; ++i) {
+        if (display->retired[i].serial <= completed) {
+            DestroyRetired(&display->retired[i], context);
+        }
+        else {
+            display->retired[kept++] = display->retired[i];
+        }
+    }
+    display->retiredCount = kept;
 }
 
 static void
@@ -440,16 +1116,10 @@ static void
     }
     VkResult err = { 0 };
 
+    // old images may still be rendered to or presented, they are retired
+    // behind the frames in flight instead of idling the device
     VkSwapchainKHR oldSwapchain = { display->swapchain };
-    display->swapchain = VK_NULL_HANDLE;
-
-    err = vkDeviceWaitIdle(context->device);
-    if (err != VK_SUCCESS) {
-        context->result = E_SYNC_FAILURE;
-        return;
-    }
-
-    CleanFrames(display, context);
+    RetireSwapchain(display, context);
 
     VkSurfaceCapabilitiesKHR cap = { 0 };
     err = vkGetPhysicalDeviceSurfaceCapabilitiesKHR(
@@ -459,9 +1129,16 @@ static void
         return;
     }
 
-    // clamp 2 between minImageCount and maxImageCount
-    uint32_t minImageCount = min(
-      cap.maxImageCount ? cap.maxImageCount : 999, max(2, cap.minImageCount));
+    // clamp 2 between minImageCount and maxImageCount, mailbox needs a third
+    // image to always have one to render into while another is queued
+    uint32_t wantImageCount =
+      display->presentMode == VK_PRESENT_MODE_MAILBOX_KHR ? 3 : 2;
+    uint32_t minImageCount = wantImageCount > cap.minImageCount
+                               ? wantImageCount
+                               : cap.minImageCount;
+    if (cap.maxImageCount && minImageCount > cap.maxImageCount) {
+        minImageCount = cap.maxImageCount;
+    }
     VkSurfaceTransformFlagBitsKHR preTransform =
       (cap.supportedTransforms & VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR)
         ? VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR
@@ -494,57 +1171,96 @@ static void
             .height = display->height,
         };
     }
-    err =
-      vkCreateSwapchainKHR(context->device, &sci, NULL, &display->swapchain);
+    err = vkCreateSwapchainKHR(
+      context->device, &sci, context->vkAllocator, &display->swapchain);
     if (err != VK_SUCCESS) {
         display->result = E_CREATE_SWAPCHAIN_FAILURE;
         return;
     }
     err = vkGetSwapchainImagesKHR(
-      context->device, display->swapchain, &display->frameCount, NULL);
+      context->device, display->swapchain, &display->imageCount, NULL);
     if (err != VK_SUCCESS) {
         display->result = E_CREATE_SWAPCHAIN_FAILURE;
         return;
     }
 
-    VkImage images[8] = { 0 };
+    VkImage images[E_MAX_SWAPCHAIN_IMAGES] = { 0 };
 
-    if (display->frameCount > 8) {
+    if (display->imageCount > E_MAX_SWAPCHAIN_IMAGES) {
         display->result = E_CREATE_SWAPCHAIN_FAILURE;
         return;
     }
     err = vkGetSwapchainImagesKHR(
-      context->device, display->swapchain, &display->frameCount, images);
+      context->device, display->swapchain, &display->imageCount, images);
     if (err != VK_SUCCESS) {
         display->result = E_CREATE_SWAPCHAIN_FAILURE;
         return;
     }
 
-    display->semaphoreCount = display->frameCount + 1;
-    display->frames = calloc(display->frameCount, sizeof(*display->frames));
-    display->semaphores =
-      calloc(display->semaphoreCount, sizeof(*display->semaphores));
-    if (!display->frames || !display->semaphores) {
-        display->result = E_CREATE_SWAPCHAIN_FAILURE;
-        free(display->frames);
-        free(display->semaphores);
-        return;
-    }
-    for (uint32_t i = 0; i < display->frameCount; ++i) {
-        display->frames[i].image = images[i];
-    }
-    if (oldSwapchain) {
-        vkDestroySwapchainKHR(context->device, oldSwapchain, NULL);
+    for (uint32_t i = 0; i < display->imageCount; ++i) {
+        display->images[i].image = images[i];
     }
 }
 
-static void SelectPresentMode(EDisplay display) {
+static void
+  SelectPresentMode(EDisplay display, EContext context, EWindow window) {
     if (display->result != E_SUCCESS) {
         return;
     }
-    // FIFO is the only REQUIRED to exist present mode by Vulkan
-    // and I think its irrelevant to use any other?
+    VkResult err = { 0 };
+
+    // FIFO is the only present mode REQUIRED to exist by Vulkan, every
+    // preference falls back towards it
+    const VkPresentModeKHR fifo[] = { VK_PRESENT_MODE_FIFO_KHR };
+    const VkPresentModeKHR fifoRelaxed[] = {
+        VK_PRESENT_MODE_FIFO_RELAXED_KHR,
+        VK_PRESENT_MODE_FIFO_KHR,
+    };
+    const VkPresentModeKHR mailbox[] = {
+        VK_PRESENT_MODE_MAILBOX_KHR,
+        VK_PRESENT_MODE_IMMEDIATE_KHR,
+        VK_PRESENT_MODE_FIFO_KHR,
+    };
+    const VkPresentModeKHR immediate[] = {
+        VK_PRESENT_MODE_IMMEDIATE_KHR,
+        VK_PRESENT_MODE_MAILBOX_KHR,
+        VK_PRESENT_MODE_FIFO_KHR,
+    };
+    const VkPresentModeKHR* reqModes = { fifo };
+    uint32_t reqModeCount = { 1 };
+    switch (window->presentMode) {
+        case E_PRESENT_MODE_FIFO_RELAXED:
+            reqModes = fifoRelaxed;
+            reqModeCount = sizeof(fifoRelaxed) / sizeof(*fifoRelaxed);
+            break;
+        case E_PRESENT_MODE_MAILBOX:
+            reqModes = mailbox;
+            reqModeCount = sizeof(mailbox) / sizeof(*mailbox);
+            break;
+        case E_PRESENT_MODE_IMMEDIATE:
+            reqModes = immediate;
+            reqModeCount = sizeof(immediate) / sizeof(*immediate);
+            break;
+        default: break;
+    }
     display->presentMode = VK_PRESENT_MODE_FIFO_KHR;
+
+    VkPresentModeKHR modes[8] = { 0 };
+    uint32_t modeCount = { sizeof(modes) / sizeof(*modes) };
+    err = vkGetPhysicalDeviceSurfacePresentModesKHR(
+      context->physicalDevice, display->surface, &modeCount, modes);
+    // VK_INCOMPLETE still fills the array, more than 8 modes don't exist yet
+    if (err != VK_SUCCESS && err != VK_INCOMPLETE) {
+        return;
+    }
+    for (uint32_t i = 0; i < reqModeCount; ++i) {
+        for (uint32_t j = 0; j < modeCount; ++j) {
+            if (modes[j] == reqModes[i]) {
+                display->presentMode = reqModes[i];
+                return;
+            }
+        }
+    }
 }
 
 static void SelectSurfaceFormat(EDisplay display, EContext context) {
@@ -579,7 +1295,8 @@ static void SelectSurfaceFormat(EDisplay display, EContext context) {
         context->result = E_ENUMERATE_FAILURE;
         return;
     }
-    VkSurfaceFormatKHR* srfFmts = calloc(srfFmtCount, sizeof(*srfFmts));
+    VkSurfaceFormatKHR* srfFmts =
+      eCalloc(srfFmtCount, sizeof(*srfFmts), E_MEMORY_SCOPE_DISPLAY);
     if (!srfFmts) {
         context->result = E_MALLOC_FAILURE;
         return;
@@ -618,15 +1335,17 @@ static void SelectSurfaceFormat(EDisplay display, EContext context) {
     // if none found use whatever first available
     display->surfaceFormat = *srfFmts;
 return_early:
-    free(srfFmts);
+    eFree(srfFmts);
 }
 
 static void CreateSurface(EDisplay display, EContext context, EWindow window) {
     if (display->result != E_SUCCESS) {
         return;
     }
-    VkResult err = glfwCreateWindowSurface(
-      context->instance, window->window, NULL, &display->surface);
+    VkResult err = glfwCreateWindowSurface(context->instance,
+      window->window,
+      context->vkAllocator,
+      &display->surface);
     if (err != VK_SUCCESS) {
         context->result = E_GLFW_FAILURE;
     }
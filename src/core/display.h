@@ -4,7 +4,16 @@
 
 E_EXTERN void
   eCreateDisplay(EDisplay* displayOut, EContext context, EWindow window);
+E_EXTERN void eCreateOffscreenDisplay(EDisplay* displayOut,
+  EContext context,
+  EOffscreenDisplayCreateInfo* infoIn);
 E_EXTERN void eDestroyDisplay(EDisplay display, EContext context);
 E_EXTERN void eRenderFrame(EDisplay display, EContext context, EWindow window);
-E_EXTERN void eDisplayFrame(EDisplay display, EContext context);
+E_EXTERN void eDisplayFrame(EDisplay display, EContext context, EWindow window);
 E_EXTERN void eResizeWindow(EDisplay display, EContext context, EWindow window);
+E_EXTERN void eGetDisplayStats(EDisplay display, EDisplayStats* statsOut);
+E_EXTERN void eBeginCpuPhase(EDisplay display, ECpuPhase phase);
+E_EXTERN void eEndCpuPhase(EDisplay display, ECpuPhase phase);
+E_EXTERN void eGetFrameTimings(EDisplay display, EFrameTimings* timingsOut);
+E_EXTERN EResult
+  eReadDisplayPixels(EDisplay display, EContext context, void* pixelsOut);
@@ -0,0 +1,477 @@
+#include "glyphs.h"
+
+#include "core.h"
+#include "renderer.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define STBTT_STATIC
+#define STBTT_malloc(size, user) \
+    ((void)(user), eAlloc(size, E_MEMORY_SCOPE_TEXTURE))
+#define STBTT_free(memory, user) ((void)(user), eFree(memory))
+#define STB_TRUETYPE_IMPLEMENTATION
+#include "imstb_truetype.h"
+
+
+static EResult PlaceGlyph(EGlyphCache cache,
+  uint32_t width,
+  uint32_t height,
+  uint32_t* pageOut,
+  uint32_t* xOut,
+  uint32_t* yOut);
+static void AddPage(EGlyphCache cache);
+static void EvictPage(EGlyphCache cache, uint32_t index);
+static EResult StageGlyph(struct EGlyphPage* page,
+  const unsigned char* coverage,
+  uint32_t x,
+  uint32_t y,
+  uint32_t width,
+  uint32_t height);
+static struct EGlyph* FindGlyph(EGlyphCache cache, uint32_t key);
+static struct EGlyph* InsertGlyph(EGlyphCache cache,
+  const struct EGlyph* glyph);
+static EResult
+  RebuildGlyphs(EGlyphCache cache, uint32_t capacity, int32_t dropPage);
+static void UpdatePage(EGlyphCache cache, EContext context, uint32_t index);
+
+E_EXTERN void eCreateGlyphCache(EGlyphCache* cacheOut,
+  EGlyphCacheCreateInfo* infoIn) {
+    if (!cacheOut) {
+        return;
+    }
+    EGlyphCache cache = eAlloc(sizeof(*cache), E_MEMORY_SCOPE_TEXTURE);
+    if (!cache) {
+        *cacheOut = NULL;
+        return;
+    }
+    *cacheOut = cache;
+    *cache = (struct EGlyphCache_t){ 0 };
+    if (!infoIn) {
+        cache->result = E_CREATE_INFO_MISSING;
+        return;
+    }
+    if (!infoIn->renderer || !infoIn->fontData || infoIn->pixelHeight <= 0.f) {
+        cache->result = E_CREATE_INFO_MISSING_VALUE;
+        return;
+    }
+    cache->renderer = infoIn->renderer;
+    cache->pageSize =
+      infoIn->pageSize ? infoIn->pageSize : E_DEFAULT_GLYPH_PAGE_SIZE;
+    uint64_t budget =
+      infoIn->memoryBudget ? infoIn->memoryBudget : E_DEFAULT_GLYPH_BUDGET;
+    // pages are alpha only, one byte per texel
+    uint64_t pageBytes = (uint64_t)cache->pageSize * cache->pageSize;
+    // a single page is kept whatever the budget, nothing could draw without
+    uint64_t pages = budget / pageBytes;
+    cache->maxPages = pages < 1                   ? 1
+                      : pages > E_MAX_GLYPH_PAGES ? E_MAX_GLYPH_PAGES
+                                                  : (uint32_t)pages;
+    // frame 0 is older than any page
+    cache->frame = 1;
+
+    stbtt_fontinfo* font = eAlloc(sizeof(*font), E_MEMORY_SCOPE_TEXTURE);
+    if (!font) {
+        cache->result = E_MALLOC_FAILURE;
+        return;
+    }
+    cache->font = font;
+    const unsigned char* data = infoIn->fontData;
+    if (!stbtt_InitFont(font, data, stbtt_GetFontOffsetForIndex(data, 0))) {
+        cache->result = E_LOAD_FONT_FAILURE;
+        return;
+    }
+    int ascent = { 0 };
+    int descent = { 0 };
+    int lineGap = { 0 };
+    stbtt_GetFontVMetrics(font, &ascent, &descent, &lineGap);
+    cache->scale = stbtt_ScaleForPixelHeight(font, infoIn->pixelHeight);
+    cache->ascent = (float)ascent * cache->scale;
+}
+
+// Page textures may still be drawn, they are retired behind the frames in
+// flight like any other replaced texture.
+E_EXTERN void eDestroyGlyphCache(EGlyphCache cache, EContext context) {
+    if (!cache) {
+        return;
+    }
+    for (uint32_t i = 0; i < cache->pageCount; ++i) {
+        struct EGlyphPage* page = &cache->pages[i];
+        eRetireTexture(page->texture, cache->renderer, context);
+        eRetireTexture(page->evicted, cache->renderer, context);
+        eFree(page->packer);
+        eFree(page->regions);
+        eFree(page->staged);
+    }
+    eFree(cache->glyphs);
+    eFree(cache->font);
+    eFree(cache);
+}
+
+// Rasterizes the glyph on first use and queues it for the next upload. The
+// advance is known right away, the quad's texture id only once
+// eUpdateGlyphCache finished uploading the glyph's pixels.
+E_EXTERN EResult
+  eGetGlyph(EGlyphCache cache, uint32_t codepoint, EGlyphQuad* quadOut) {
+    *quadOut = (EGlyphQuad){ 0 };
+    if (cache->result != E_SUCCESS) {
+        return cache->result;
+    }
+    if (codepoint > 0x10FFFF) {
+        codepoint = 0xFFFD;
+    }
+    struct EGlyph* glyph = FindGlyph(cache, codepoint + 1);
+    if (!glyph) {
+        stbtt_fontinfo* font = cache->font;
+        int index = stbtt_FindGlyphIndex(font, (int)codepoint);
+        int advance = { 0 };
+        int bearing = { 0 };
+        stbtt_GetGlyphHMetrics(font, index, &advance, &bearing);
+        int x0 = { 0 };
+        int y0 = { 0 };
+        int x1 = { 0 };
+        int y1 = { 0 };
+        stbtt_GetGlyphBitmapBox(
+          font, index, cache->scale, cache->scale, &x0, &y0, &x1, &y1);
+        struct EGlyph added = {
+            .key = codepoint + 1,
+            .page = -1,
+            .width = x1 > x0 ? (uint32_t)(x1 - x0) : 0,
+            .height = y1 > y0 ? (uint32_t)(y1 - y0) : 0,
+            .offset = { (float)x0, cache->ascent + (float)y0 },
+            .advance = (float)advance * cache->scale,
+        };
+
+        if (added.width && added.height) {
+            uint32_t pageIndex = { 0 };
+            EResult res = PlaceGlyph(cache,
+              added.width + 2 * E_ATLAS_PADDING,
+              added.height + 2 * E_ATLAS_PADDING,
+              &pageIndex,
+              &added.x,
+              &added.y);
+            if (res != E_SUCCESS) {
+                return res;
+            }
+            unsigned char* coverage = eAlloc(
+              (size_t)added.width * added.height, E_MEMORY_SCOPE_TEXTURE);
+            if (!coverage) {
+                return E_MALLOC_FAILURE;
+            }
+            stbtt_MakeGlyphBitmap(font,
+              coverage,
+              (int)added.width,
+              (int)added.height,
+              (int)added.width,
+              cache->scale,
+              cache->scale,
+              index);
+            struct EGlyphPage* page = &cache->pages[pageIndex];
+            added.page = (int32_t)pageIndex;
+            added.x += E_ATLAS_PADDING;
+            added.y += E_ATLAS_PADDING;
+            added.generation = page->generation;
+            res = StageGlyph(
+              page, coverage, added.x, added.y, added.width, added.height);
+            eFree(coverage);
+            if (res != E_SUCCESS) {
+                return res;
+            }
+        }
+        glyph = InsertGlyph(cache, &added);
+        if (!glyph) {
+            return E_MALLOC_FAILURE;
+        }
+    }
+
+    quadOut->advance = glyph->advance;
+    if (glyph->page < 0) {
+        return E_SUCCESS;
+    }
+    struct EGlyphPage* page = &cache->pages[glyph->page];
+    page->lastUsed = cache->frame;
+    quadOut->rect[0] = glyph->offset[0];
+    quadOut->rect[1] = glyph->offset[1];
+    quadOut->rect[2] = glyph->offset[0] + (float)glyph->width;
+    quadOut->rect[3] = glyph->offset[1] + (float)glyph->height;
+    if (!page->texture || glyph->generation > page->readyGeneration) {
+        return E_SUCCESS;
+    }
+    float size = (float)cache->pageSize;
+    quadOut->textureId = eGetTextureId(page->texture);
+    quadOut->uv0[0] = (float)glyph->x / size;
+    quadOut->uv0[1] = (float)glyph->y / size;
+    quadOut->uv1[0] = (float)(glyph->x + glyph->width) / size;
+    quadOut->uv1[1] = (float)(glyph->y + glyph->height) / size;
+    return E_SUCCESS;
+}
+
+// Uploads the glyphs added to each page since its last upload, as one
+// region per glyph, and makes glyphs whose upload finished drawable. Call
+// once per frame before any glyph is looked up.
+E_EXTERN void eUpdateGlyphCache(EGlyphCache cache, EContext context) {
+    for (uint32_t i = 0; i < cache->pageCount; ++i) {
+        UpdatePage(cache, context, i);
+    }
+    cache->frame++;
+}
+
+// Packs into the first page with room, then into a new page while the
+// budget allows. Past it the least recently used page that wasn't drawn
+// from this frame is emptied for the glyph.
+static EResult PlaceGlyph(EGlyphCache cache,
+  uint32_t width,
+  uint32_t height,
+  uint32_t* pageOut,
+  uint32_t* xOut,
+  uint32_t* yOut) {
+    if (width > cache->pageSize || height > cache->pageSize) {
+        return E_ATLAS_FULL;
+    }
+    uint32_t pageIndex = { 0 };
+    int packed = { 0 };
+    for (uint32_t i = 0; i < cache->pageCount && !packed; ++i) {
+        packed = ePackRect(cache->pages[i].packer, width, height, xOut, yOut);
+        pageIndex = i;
+    }
+    if (!packed && cache->pageCount < cache->maxPages) {
+        AddPage(cache);
+        if (cache->result != E_SUCCESS) {
+            return cache->result;
+        }
+        pageIndex = cache->pageCount - 1;
+        packed = ePackRect(
+          cache->pages[pageIndex].packer, width, height, xOut, yOut);
+    }
+    if (!packed) {
+        uint64_t oldest = { cache->frame };
+        for (uint32_t i = 0; i < cache->pageCount; ++i) {
+            if (cache->pages[i].lastUsed < oldest) {
+                oldest = cache->pages[i].lastUsed;
+                pageIndex = i;
+            }
+        }
+        if (oldest == cache->frame) {
+            return E_ATLAS_FULL;
+        }
+        EvictPage(cache, pageIndex);
+        if (cache->result != E_SUCCESS) {
+            return cache->result;
+        }
+        packed = ePackRect(
+          cache->pages[pageIndex].packer, width, height, xOut, yOut);
+    }
+    if (!packed) {
+        return E_ATLAS_FULL;
+    }
+    cache->pages[pageIndex].lastUsed = cache->frame;
+    *pageOut = pageIndex;
+    return E_SUCCESS;
+}
+
+static void AddPage(EGlyphCache cache) {
+    if (cache->result != E_SUCCESS) {
+        return;
+    }
+    struct EGlyphPage* page = &cache->pages[cache->pageCount];
+    *page = (struct EGlyphPage){ .generation = 1 };
+    page->packer = eCreateRectPacker(cache->pageSize);
+    if (!page->packer) {
+        cache->result = E_MALLOC_FAILURE;
+        return;
+    }
+    cache->pageCount++;
+}
+
+// Forgets the page's glyphs, they are rasterized again on their next use.
+// Frames in flight may still draw them, so the page gets a new texture
+// instead of being overwritten.
+static void EvictPage(EGlyphCache cache, uint32_t index) {
+    EResult res = RebuildGlyphs(cache, cache->glyphCapacity, (int32_t)index);
+    if (res != E_SUCCESS) {
+        cache->result = res;
+        return;
+    }
+    struct EGlyphPage* page = &cache->pages[index];
+    eResetRectPacker(page->packer, cache->pageSize);
+    if (page->texture) {
+        page->evicted = page->texture;
+        page->texture = NULL;
+    }
+    page->generation = 1;
+    page->submittedGeneration = 0;
+    page->readyGeneration = 0;
+    page->regionCount = 0;
+    page->stagedSize = 0;
+}
+
+// Appends the coverage to the page's next upload.
+static EResult StageGlyph(struct EGlyphPage* page,
+  const unsigned char* coverage,
+  uint32_t x,
+  uint32_t y,
+  uint32_t width,
+  uint32_t height) {
+    if (page->regionCount == page->regionCapacity) {
+        uint32_t capacity =
+          page->regionCapacity ? page->regionCapacity * 2 : 64;
+        ETextureRegion* regions = eRealloc(
+          page->regions, sizeof(*regions) * capacity, E_MEMORY_SCOPE_TEXTURE);
+        if (!regions) {
+            return E_MALLOC_FAILURE;
+        }
+        page->regions = regions;
+        page->regionCapacity = capacity;
+    }
+    size_t size = (size_t)width * height;
+    if (page->stagedSize + size > page->stagedCapacity) {
+        size_t capacity =
+          page->stagedCapacity ? page->stagedCapacity : (size_t)64 << 10;
+        while (capacity < page->stagedSize + size) {
+            capacity *= 2;
+        }
+        unsigned char* staged =
+          eRealloc(page->staged, capacity, E_MEMORY_SCOPE_TEXTURE);
+        if (!staged) {
+            return E_MALLOC_FAILURE;
+        }
+        page->staged = staged;
+        page->stagedCapacity = capacity;
+    }
+
+    memcpy(page->staged + page->stagedSize, coverage, size);
+    // pixels are pointed at on upload, staged may still move until then
+    page->regions[page->regionCount++] = (ETextureRegion){
+        .pitch = width,
+        .x = x,
+        .y = y,
+        .width = width,
+        .height = height,
+    };
+    page->stagedSize += size;
+    return E_SUCCESS;
+}
+
+static uint32_t HashKey(uint32_t key) {
+    return key * 2654435761u;
+}
+
+static struct EGlyph* FindGlyph(EGlyphCache cache, uint32_t key) {
+    if (!cache->glyphCapacity) {
+        return NULL;
+    }
+    uint32_t mask = { cache->glyphCapacity - 1 };
+    for (uint32_t i = HashKey(key) & mask;; i = (i + 1) & mask) {
+        if (cache->glyphs[i].key == key) {
+            return &cache->glyphs[i];
+        }
+        if (!cache->glyphs[i].key) {
+            return NULL;
+        }
+    }
+}
+
+// The table is kept at most half full, NULL when out of memory.
+static struct EGlyph* InsertGlyph(EGlyphCache cache,
+  const struct EGlyph* glyph) {
+    if ((cache->glyphCount + 1) * 2 > cache->glyphCapacity) {
+        uint32_t capacity =
+          cache->glyphCapacity ? cache->glyphCapacity * 2 : 256;
+        if (RebuildGlyphs(cache, capacity, -1) != E_SUCCESS) {
+            return NULL;
+        }
+    }
+    uint32_t mask = { cache->glyphCapacity - 1 };
+    uint32_t i = HashKey(glyph->key) & mask;
+    while (cache->glyphs[i].key) {
+        i = (i + 1) & mask;
+    }
+    cache->glyphs[i] = *glyph;
+    cache->glyphCount++;
+    return &cache->glyphs[i];
+}
+
+// Rehashes into a table of the given capacity, leaving out the glyphs on
+// dropPage. Open addressing has no cheaper way to remove them.
+static EResult
+  RebuildGlyphs(EGlyphCache cache, uint32_t capacity, int32_t dropPage) {
+    struct EGlyph* glyphs =
+      eCalloc(capacity, sizeof(*glyphs), E_MEMORY_SCOPE_TEXTURE);
+    if (!glyphs) {
+        return E_MALLOC_FAILURE;
+    }
+    uint32_t count = { 0 };
+    uint32_t mask = { capacity - 1 };
+    for (uint32_t i = 0; i < cache->glyphCapacity; ++i) {
+        const struct EGlyph* glyph = &cache->glyphs[i];
+        if (!glyph->key || (dropPage >= 0 && glyph->page == dropPage)) {
+            continue;
+        }
+        uint32_t j = HashKey(glyph->key) & mask;
+        while (glyphs[j].key) {
+            j = (j + 1) & mask;
+        }
+        glyphs[j] = *glyph;
+        count++;
+    }
+    eFree(cache->glyphs);
+    cache->glyphs = glyphs;
+    cache->glyphCapacity = capacity;
+    cache->glyphCount = count;
+    return E_SUCCESS;
+}
+
+// A page has at most one upload in flight, glyphs added meanwhile wait for
+// the next one.
+static void UpdatePage(EGlyphCache cache, EContext context, uint32_t index) {
+    if (cache->result != E_SUCCESS) {
+        return;
+    }
+    struct EGlyphPage* page = &cache->pages[index];
+
+    if (page->evicted) {
+        eRetireTexture(page->evicted, cache->renderer, context);
+        page->evicted = NULL;
+    }
+    if (!page->texture) {
+        ETextureCreateInfo tci = {
+            .width = cache->pageSize,
+            .height = cache->pageSize,
+            .alphaOnly = 1,
+            .dynamic = 1,
+        };
+        eCreateTexture(&page->texture, cache->renderer, context, &tci);
+        if (!page->texture) {
+            cache->result = E_MALLOC_FAILURE;
+            return;
+        }
+    }
+    EResult res = eGetResult(page->texture);
+    if (res != E_SUCCESS) {
+        cache->result = res;
+        return;
+    }
+    if (!eTextureCanUpdate(page->texture)) {
+        return;
+    }
+    page->readyGeneration = page->submittedGeneration;
+    if (!page->regionCount) {
+        return;
+    }
+
+    size_t offset = { 0 };
+    for (uint32_t i = 0; i < page->regionCount; ++i) {
+        ETextureRegion* region = &page->regions[i];
+        region->pixels = page->staged + offset;
+        offset += (size_t)region->pitch * region->height;
+    }
+    res = eUpdateTexture(
+      page->texture, context, page->regions, page->regionCount);
+    if (res != E_SUCCESS) {
+        cache->result = res;
+        return;
+    }
+    page->submittedGeneration = page->generation++;
+    page->regionCount = 0;
+    page->stagedSize = 0;
+}
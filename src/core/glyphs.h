@@ -0,0 +1,10 @@
+#pragma once
+
+#include "../graphics.h"
+
+E_EXTERN void eCreateGlyphCache(EGlyphCache* cacheOut,
+  EGlyphCacheCreateInfo* infoIn);
+E_EXTERN void eDestroyGlyphCache(EGlyphCache cache, EContext context);
+E_EXTERN EResult
+  eGetGlyph(EGlyphCache cache, uint32_t codepoint, EGlyphQuad* quadOut);
+E_EXTERN void eUpdateGlyphCache(EGlyphCache cache, EContext context);
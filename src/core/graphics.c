@@ -1,4 +1,15 @@
-#include "../graphics.h"
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "core.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <time.h>
+#endif
 
 EResult eGetResult(void* handleIn) {
     if (!handleIn) {
@@ -6,3 +17,56 @@ EResult eGetResult(void* handleIn) {
     }
     return *(EResult*)handleIn;
 }
+
+// Monotonic, clock adjustments can't make the difference of two readings
+// wrap around.
+E_EXTERN uint64_t eNowNanoseconds(void) {
+#ifdef _WIN32
+    LARGE_INTEGER frequency = { 0 };
+    LARGE_INTEGER counter = { 0 };
+    (void)QueryPerformanceFrequency(&frequency);
+    (void)QueryPerformanceCounter(&counter);
+    uint64_t ticks = (uint64_t)counter.QuadPart;
+    uint64_t perSecond = (uint64_t)frequency.QuadPart;
+    // split so the product doesn't overflow after a few hours of uptime
+    return ticks / perSecond * 1000000000ull
+           + ticks % perSecond * 1000000000ull / perSecond;
+#else
+    struct timespec now = { 0 };
+    (void)clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+#endif
+}
+
+// CPU time spent by every thread of the process so far.
+E_EXTERN uint64_t eProcessCpuNanoseconds(void) {
+#ifdef _WIN32
+    FILETIME creation = { 0 };
+    FILETIME exit = { 0 };
+    FILETIME kernel = { 0 };
+    FILETIME user = { 0 };
+    if (!GetProcessTimes(
+          GetCurrentProcess(), &creation, &exit, &kernel, &user)) {
+        return 0;
+    }
+    // in 100 ns units
+    uint64_t ticks =
+      ((uint64_t)kernel.dwHighDateTime << 32 | kernel.dwLowDateTime)
+      + ((uint64_t)user.dwHighDateTime << 32 | user.dwLowDateTime);
+    return ticks * 100;
+#else
+    struct timespec used = { 0 };
+    (void)clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &used);
+    return (uint64_t)used.tv_sec * 1000000000ull + (uint64_t)used.tv_nsec;
+#endif
+}
+
+// fopen, without the MSVC deprecation warning. NULL when it can't be opened.
+E_EXTERN FILE* eOpenFile(const char* path, const char* mode) {
+#ifdef _MSC_VER
+    FILE* file = { NULL };
+    return fopen_s(&file, path, mode) == 0 ? file : NULL;
+#else
+    return fopen(path, mode);
+#endif
+}
@@ -0,0 +1,753 @@
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "heap.h"
+
+#include "core.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <malloc.h>
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+#ifdef _WIN32
+typedef CRITICAL_SECTION EMutex;
+#else
+typedef pthread_mutex_t EMutex;
+#endif
+
+// In front of memory the tracker, pool and arena hand out. Offset leads
+// back to what the parent returned, 0 when the memory isn't the parent's.
+struct EHostHeader {
+    uint64_t size;
+    uint32_t offset;
+    uint32_t scope;
+};
+
+struct EHostTracker_t {
+    EResult result;
+    EHostAllocator parent;
+    EHostAllocator allocator;
+    EMutex mutex;
+    EHostMemoryStats stats;
+    uint32_t expectMask;
+};
+
+struct EHostPool_t {
+    EResult result;
+    EHostAllocator parent;
+    EHostAllocator allocator;
+    EMutex mutex;
+    size_t objectSize;
+    size_t slotSize;  // header included
+    uint32_t objectsPerChunk;
+    void* chunks;  // linked through their first pointer
+    void* freeSlots;  // linked through the first pointer after the header
+};
+
+struct EHostArena_t {
+    EResult result;
+    EHostAllocator parent;
+    EHostAllocator allocator;
+    EMutex mutex;
+    char* memory;
+    size_t size;
+    size_t head;
+    size_t last;  // of the newest allocation, 0 when freed or reset
+    size_t lastHead;  // head from before the newest allocation
+};
+
+static void InitMutex(EMutex* mutex);
+static void DestroyMutex(EMutex* mutex);
+static void Lock(EMutex* mutex);
+static void Unlock(EMutex* mutex);
+static void* DefaultAlloc(void* userData,
+  size_t size,
+  size_t alignment,
+  EMemoryScope scope);
+static void* DefaultRealloc(void* userData,
+  void* memory,
+  size_t size,
+  size_t alignment);
+static void DefaultFree(void* userData, void* memory);
+static size_t HeaderOffset(size_t alignment);
+static void* ParentAlloc(const EHostAllocator* parent,
+  size_t size,
+  size_t alignment,
+  EMemoryScope scope);
+static void* ParentRealloc(const EHostAllocator* parent,
+  void* memory,
+  size_t size,
+  size_t alignment);
+static void ParentFree(const EHostAllocator* parent, void* memory);
+static void* TrackerAlloc(void* userData,
+  size_t size,
+  size_t alignment,
+  EMemoryScope scope);
+static void* TrackerRealloc(void* userData,
+  void* memory,
+  size_t size,
+  size_t alignment);
+static void TrackerFree(void* userData, void* memory);
+static void CountAllocation(EHostTracker tracker,
+  uint32_t scope,
+  uint64_t oldSize,
+  uint64_t size);
+static void* PoolAlloc(void* userData,
+  size_t size,
+  size_t alignment,
+  EMemoryScope scope);
+static void* PoolRealloc(void* userData,
+  void* memory,
+  size_t size,
+  size_t alignment);
+static void PoolFree(void* userData, void* memory);
+static void* ArenaAlloc(void* userData,
+  size_t size,
+  size_t alignment,
+  EMemoryScope scope);
+static void* ArenaRealloc(void* userData,
+  void* memory,
+  size_t size,
+  size_t alignment);
+static void ArenaFree(void* userData, void* memory);
+static void* VkAlloc(void* userData,
+  size_t size,
+  size_t alignment,
+  VkSystemAllocationScope scope);
+static void* VkRealloc(void* userData,
+  void* memory,
+  size_t size,
+  size_t alignment,
+  VkSystemAllocationScope scope);
+static void VkFree(void* userData, void* memory);
+
+static const EHostAllocator defaultAllocator = {
+    .alloc = DefaultAlloc,
+    .realloc = DefaultRealloc,
+    .free = DefaultFree,
+};
+static EHostAllocator hostAllocator = {
+    .alloc = DefaultAlloc,
+    .realloc = DefaultRealloc,
+    .free = DefaultFree,
+};
+static const VkAllocationCallbacks vkAllocator = {
+    .pfnAllocation = VkAlloc,
+    .pfnReallocation = VkRealloc,
+    .pfnFree = VkFree,
+};
+
+
+E_EXTERN const EHostAllocator* eGetDefaultHostAllocator(void) {
+    return &defaultAllocator;
+}
+
+E_EXTERN void eSetHostAllocator(const EHostAllocator* allocator) {
+    hostAllocator = allocator ? *allocator : defaultAllocator;
+}
+
+E_EXTERN void* eAlloc(size_t size, EMemoryScope scope) {
+    return hostAllocator.alloc(
+      hostAllocator.userData, size, E_HOST_ALIGNMENT, scope);
+}
+
+E_EXTERN void* eCalloc(size_t count, size_t size, EMemoryScope scope) {
+    if (size && count > SIZE_MAX / size) {
+        return NULL;
+    }
+    void* memory = eAlloc(count * size, scope);
+    if (memory) {
+        memset(memory, 0, count * size);
+    }
+    return memory;
+}
+
+E_EXTERN void* eRealloc(void* memory, size_t size, EMemoryScope scope) {
+    if (!memory) {
+        return eAlloc(size, scope);
+    }
+    return hostAllocator.realloc(
+      hostAllocator.userData, memory, size ? size : 1, E_HOST_ALIGNMENT);
+}
+
+E_EXTERN void eFree(void* memory) {
+    if (memory) {
+        hostAllocator.free(hostAllocator.userData, memory);
+    }
+}
+
+// the driver's allocations go through the installed allocator too
+E_EXTERN const VkAllocationCallbacks* eGetVkAllocator(void) {
+    return &vkAllocator;
+}
+
+E_EXTERN void eCreateHostTracker(EHostTracker* trackerOut,
+  EHostTrackerCreateInfo* infoIn) {
+    if (!trackerOut) {
+        return;
+    }
+    const EHostAllocator* parent =
+      infoIn && infoIn->parent ? infoIn->parent : &defaultAllocator;
+    EHostTracker tracker = ParentAlloc(
+      parent, sizeof(*tracker), E_HOST_ALIGNMENT, E_MEMORY_SCOPE_CONTEXT);
+    if (!tracker) {
+        *trackerOut = NULL;
+        return;
+    }
+    *trackerOut = tracker;
+    *tracker = (struct EHostTracker_t){
+        .parent = *parent,
+        .allocator = {
+            .alloc = TrackerAlloc,
+            .realloc = TrackerRealloc,
+            .free = TrackerFree,
+            .userData = tracker,
+        },
+    };
+    InitMutex(&tracker->mutex);
+}
+
+// everything it handed out must be freed first
+E_EXTERN void eDestroyHostTracker(EHostTracker tracker) {
+    if (!tracker) {
+        return;
+    }
+    EHostAllocator parent = tracker->parent;
+    DestroyMutex(&tracker->mutex);
+    ParentFree(&parent, tracker);
+}
+
+E_EXTERN const EHostAllocator* eGetHostTrackerAllocator(EHostTracker tracker) {
+    return &tracker->allocator;
+}
+
+E_EXTERN void eGetHostMemoryStats(EHostTracker tracker,
+  EHostMemoryStats* statsOut) {
+    Lock(&tracker->mutex);
+    *statsOut = tracker->stats;
+    Unlock(&tracker->mutex);
+}
+
+// Test hook, alloc and realloc calls in the scopes of the mask count as
+// unexpectedAllocations until the mask is set back to 0.
+E_EXTERN void eExpectNoHostAllocations(EHostTracker tracker,
+  uint32_t scopeMask) {
+    Lock(&tracker->mutex);
+    tracker->expectMask = scopeMask;
+    Unlock(&tracker->mutex);
+}
+
+E_EXTERN void eCreateHostPool(EHostPool* poolOut, EHostPoolCreateInfo* infoIn) {
+    if (!poolOut) {
+        return;
+    }
+    const EHostAllocator* parent =
+      infoIn && infoIn->parent ? infoIn->parent : &defaultAllocator;
+    EHostPool pool = ParentAlloc(
+      parent, sizeof(*pool), E_HOST_ALIGNMENT, E_MEMORY_SCOPE_CONTEXT);
+    if (!pool) {
+        *poolOut = NULL;
+        return;
+    }
+    *poolOut = pool;
+    *pool = (struct EHostPool_t){
+        .parent = *parent,
+        .allocator = {
+            .alloc = PoolAlloc,
+            .realloc = PoolRealloc,
+            .free = PoolFree,
+            .userData = pool,
+        },
+    };
+    InitMutex(&pool->mutex);
+    if (!infoIn) {
+        pool->result = E_CREATE_INFO_MISSING;
+        return;
+    }
+    if (!infoIn->objectSize) {
+        pool->result = E_CREATE_INFO_MISSING_VALUE;
+        return;
+    }
+    // a free slot holds the next one's address
+    size_t objectSize = infoIn->objectSize < sizeof(void*)
+                          ? sizeof(void*)
+                          : infoIn->objectSize;
+    pool->objectSize = objectSize;
+    pool->slotSize = sizeof(struct EHostHeader)
+                     + (objectSize + E_HOST_ALIGNMENT - 1)
+                         / E_HOST_ALIGNMENT * E_HOST_ALIGNMENT;
+    pool->objectsPerChunk =
+      infoIn->objectsPerChunk ? infoIn->objectsPerChunk : 64;
+}
+
+// pooled memory still handed out goes away with the chunks
+E_EXTERN void eDestroyHostPool(EHostPool pool) {
+    if (!pool) {
+        return;
+    }
+    EHostAllocator parent = pool->parent;
+    while (pool->chunks) {
+        void* chunk = pool->chunks;
+        memcpy(&pool->chunks, chunk, sizeof(void*));
+        ParentFree(&parent, chunk);
+    }
+    DestroyMutex(&pool->mutex);
+    ParentFree(&parent, pool);
+}
+
+E_EXTERN const EHostAllocator* eGetHostPoolAllocator(EHostPool pool) {
+    return &pool->allocator;
+}
+
+E_EXTERN void eCreateHostArena(EHostArena* arenaOut,
+  EHostArenaCreateInfo* infoIn) {
+    if (!arenaOut) {
+        return;
+    }
+    const EHostAllocator* parent =
+      infoIn && infoIn->parent ? infoIn->parent : &defaultAllocator;
+    EHostArena arena = ParentAlloc(
+      parent, sizeof(*arena), E_HOST_ALIGNMENT, E_MEMORY_SCOPE_CONTEXT);
+    if (!arena) {
+        *arenaOut = NULL;
+        return;
+    }
+    *arenaOut = arena;
+    *arena = (struct EHostArena_t){
+        .parent = *parent,
+        .allocator = {
+            .alloc = ArenaAlloc,
+            .realloc = ArenaRealloc,
+            .free = ArenaFree,
+            .userData = arena,
+        },
+    };
+    InitMutex(&arena->mutex);
+    if (!infoIn) {
+        arena->result = E_CREATE_INFO_MISSING;
+        return;
+    }
+    if (!infoIn->size) {
+        arena->result = E_CREATE_INFO_MISSING_VALUE;
+        return;
+    }
+    arena->memory = ParentAlloc(
+      parent, infoIn->size, E_HOST_ALIGNMENT, E_MEMORY_SCOPE_CONTEXT);
+    if (!arena->memory) {
+        arena->result = E_MALLOC_FAILURE;
+        return;
+    }
+    arena->size = infoIn->size;
+}
+
+E_EXTERN void eDestroyHostArena(EHostArena arena) {
+    if (!arena) {
+        return;
+    }
+    EHostAllocator parent = arena->parent;
+    if (arena->memory) {
+        ParentFree(&parent, arena->memory);
+    }
+    DestroyMutex(&arena->mutex);
+    ParentFree(&parent, arena);
+}
+
+E_EXTERN const EHostAllocator* eGetHostArenaAllocator(EHostArena arena) {
+    return &arena->allocator;
+}
+
+// Memory from the arena's buffer is reused from here on, memory that came
+// from the parent stays until freed.
+E_EXTERN void eResetHostArena(EHostArena arena) {
+    Lock(&arena->mutex);
+    arena->head = 0;
+    arena->last = 0;
+    Unlock(&arena->mutex);
+}
+
+static void InitMutex(EMutex* mutex) {
+#ifdef _WIN32
+    InitializeCriticalSection(mutex);
+#else
+    (void)pthread_mutex_init(mutex, NULL);
+#endif
+}
+
+static void DestroyMutex(EMutex* mutex) {
+#ifdef _WIN32
+    DeleteCriticalSection(mutex);
+#else
+    (void)pthread_mutex_destroy(mutex);
+#endif
+}
+
+static void Lock(EMutex* mutex) {
+#ifdef _WIN32
+    EnterCriticalSection(mutex);
+#else
+    (void)pthread_mutex_lock(mutex);
+#endif
+}
+
+static void Unlock(EMutex* mutex) {
+#ifdef _WIN32
+    LeaveCriticalSection(mutex);
+#else
+    (void)pthread_mutex_unlock(mutex);
+#endif
+}
+
+static void* DefaultAlloc(void* userData,
+  size_t size,
+  size_t alignment,
+  EMemoryScope scope) {
+    (void)userData;
+    (void)scope;
+    size = size ? size : 1;
+#ifdef _WIN32
+    return _aligned_malloc(size, alignment);
+#else
+    if (alignment <= _Alignof(max_align_t)) {
+        return malloc(size);
+    }
+    void* memory = NULL;
+    return posix_memalign(&memory, alignment, size) == 0 ? memory : NULL;
+#endif
+}
+
+// Past malloc's alignment realloc may misalign the memory. The aligned copy
+// is allocated first, so that failing leaves the original intact.
+static void* DefaultRealloc(void* userData,
+  void* memory,
+  size_t size,
+  size_t alignment) {
+#ifdef _WIN32
+    (void)userData;
+    return _aligned_realloc(memory, size, alignment);
+#else
+    if (alignment <= _Alignof(max_align_t)) {
+        return realloc(memory, size);
+    }
+    void* aligned = DefaultAlloc(userData, size, alignment, 0);
+    if (!aligned) {
+        return NULL;
+    }
+    void* moved = realloc(memory, size);
+    if (!moved) {
+        free(aligned);
+        return NULL;
+    }
+    if (((uintptr_t)moved & (alignment - 1)) == 0) {
+        free(aligned);
+        return moved;
+    }
+    memcpy(aligned, moved, size);
+    free(moved);
+    return aligned;
+#endif
+}
+
+static void DefaultFree(void* userData, void* memory) {
+    (void)userData;
+#ifdef _WIN32
+    _aligned_free(memory);
+#else
+    free(memory);
+#endif
+}
+
+// room for the header that keeps the memory after it aligned
+static size_t HeaderOffset(size_t alignment) {
+    return alignment > sizeof(struct EHostHeader) ? alignment
+                                                  : sizeof(struct EHostHeader);
+}
+
+// with a header in front, for the tracker and for what pools and arenas
+// pass on to their parent
+static void* ParentAlloc(const EHostAllocator* parent,
+  size_t size,
+  size_t alignment,
+  EMemoryScope scope) {
+    size_t offset = HeaderOffset(alignment);
+    char* base = parent->alloc(parent->userData, size + offset, offset, scope);
+    if (!base) {
+        return NULL;
+    }
+    struct EHostHeader* header = (struct EHostHeader*)(base + offset) - 1;
+    header->size = size;
+    header->offset = (uint32_t)offset;
+    header->scope = (uint32_t)scope;
+    return base + offset;
+}
+
+static void* ParentRealloc(const EHostAllocator* parent,
+  void* memory,
+  size_t size,
+  size_t alignment) {
+    struct EHostHeader* header = (struct EHostHeader*)memory - 1;
+    size_t offset = header->offset;
+    if (HeaderOffset(alignment) != offset) {
+        void* moved =
+          ParentAlloc(parent, size, alignment, (EMemoryScope)header->scope);
+        if (!moved) {
+            return NULL;
+        }
+        memcpy(moved, memory, size < header->size ? size : header->size);
+        ParentFree(parent, memory);
+        return moved;
+    }
+    char* base = parent->realloc(
+      parent->userData, (char*)memory - offset, size + offset, offset);
+    if (!base) {
+        return NULL;
+    }
+    header = (struct EHostHeader*)(base + offset) - 1;
+    header->size = size;
+    return base + offset;
+}
+
+static void ParentFree(const EHostAllocator* parent, void* memory) {
+    struct EHostHeader* header = (struct EHostHeader*)memory - 1;
+    parent->free(parent->userData, (char*)memory - header->offset);
+}
+
+static void* TrackerAlloc(void* userData,
+  size_t size,
+  size_t alignment,
+  EMemoryScope scope) {
+    EHostTracker tracker = userData;
+    void* memory = ParentAlloc(&tracker->parent, size, alignment, scope);
+    if (memory) {
+        CountAllocation(tracker, scope, 0, size);
+    }
+    return memory;
+}
+
+static void* TrackerRealloc(void* userData,
+  void* memory,
+  size_t size,
+  size_t alignment) {
+    EHostTracker tracker = userData;
+    struct EHostHeader header = *((struct EHostHeader*)memory - 1);
+    void* moved = ParentRealloc(&tracker->parent, memory, size, alignment);
+    if (moved) {
+        CountAllocation(tracker, header.scope, header.size, size);
+    }
+    return moved;
+}
+
+static void TrackerFree(void* userData, void* memory) {
+    EHostTracker tracker = userData;
+    struct EHostHeader header = *((struct EHostHeader*)memory - 1);
+    ParentFree(&tracker->parent, memory);
+    Lock(&tracker->mutex);
+    tracker->stats.bytes[header.scope] -= header.size;
+    tracker->stats.count[header.scope] -= 1;
+    Unlock(&tracker->mutex);
+}
+
+// oldSize is 0 for new allocations
+static void CountAllocation(EHostTracker tracker,
+  uint32_t scope,
+  uint64_t oldSize,
+  uint64_t size) {
+    Lock(&tracker->mutex);
+    tracker->stats.bytes[scope] += size - oldSize;
+    tracker->stats.count[scope] += oldSize ? 0 : 1;
+    tracker->stats.allocations[scope] += 1;
+    if (tracker->expectMask & (1u << scope)) {
+        tracker->stats.unexpectedAllocations += 1;
+    }
+    Unlock(&tracker->mutex);
+}
+
+static void* PoolAlloc(void* userData,
+  size_t size,
+  size_t alignment,
+  EMemoryScope scope) {
+    EHostPool pool = userData;
+    if (pool->result != E_SUCCESS || size > pool->objectSize
+        || alignment > E_HOST_ALIGNMENT) {
+        return ParentAlloc(&pool->parent, size, alignment, scope);
+    }
+    Lock(&pool->mutex);
+    if (!pool->freeSlots) {
+        // the chunk's link takes the place of a header
+        char* chunk = ParentAlloc(&pool->parent,
+          sizeof(struct EHostHeader) + pool->slotSize * pool->objectsPerChunk,
+          E_HOST_ALIGNMENT,
+          scope);
+        if (!chunk) {
+            Unlock(&pool->mutex);
+            return ParentAlloc(&pool->parent, size, alignment, scope);
+        }
+        memcpy(chunk, &pool->chunks, sizeof(void*));
+        pool->chunks = chunk;
+        char* slots = chunk + sizeof(struct EHostHeader);
+        for (uint32_t i = pool->objectsPerChunk; i--;) {
+            char* object =
+              slots + pool->slotSize * i + sizeof(struct EHostHeader);
+            memcpy(object, &pool->freeSlots, sizeof(void*));
+            pool->freeSlots = object;
+        }
+    }
+    char* object = pool->freeSlots;
+    memcpy(&pool->freeSlots, object, sizeof(void*));
+    Unlock(&pool->mutex);
+
+    struct EHostHeader* header = (struct EHostHeader*)object - 1;
+    header->size = size;
+    header->offset = 0;
+    header->scope = (uint32_t)scope;
+    return object;
+}
+
+static void* PoolRealloc(void* userData,
+  void* memory,
+  size_t size,
+  size_t alignment) {
+    EHostPool pool = userData;
+    struct EHostHeader* header = (struct EHostHeader*)memory - 1;
+    if (header->offset) {
+        return ParentRealloc(&pool->parent, memory, size, alignment);
+    }
+    if (size <= pool->objectSize && alignment <= E_HOST_ALIGNMENT) {
+        header->size = size;
+        return memory;
+    }
+    void* moved = ParentAlloc(
+      &pool->parent, size, alignment, (EMemoryScope)header->scope);
+    if (!moved) {
+        return NULL;
+    }
+    memcpy(moved, memory, header->size);
+    PoolFree(userData, memory);
+    return moved;
+}
+
+static void PoolFree(void* userData, void* memory) {
+    EHostPool pool = userData;
+    struct EHostHeader* header = (struct EHostHeader*)memory - 1;
+    if (header->offset) {
+        ParentFree(&pool->parent, memory);
+        return;
+    }
+    Lock(&pool->mutex);
+    memcpy(memory, &pool->freeSlots, sizeof(void*));
+    pool->freeSlots = memory;
+    Unlock(&pool->mutex);
+}
+
+static void* ArenaAlloc(void* userData,
+  size_t size,
+  size_t alignment,
+  EMemoryScope scope) {
+    EHostArena arena = userData;
+    size_t offset = HeaderOffset(alignment);
+    uintptr_t base = (uintptr_t)arena->memory;
+    Lock(&arena->mutex);
+    size_t start =
+      ((base + arena->head + offset + alignment - 1) & ~(alignment - 1))
+      - base;
+    if (start < arena->head || start + size < start
+        || start + size > arena->size) {
+        Unlock(&arena->mutex);
+        return ParentAlloc(&arena->parent, size, alignment, scope);
+    }
+    struct EHostHeader* header =
+      (struct EHostHeader*)(arena->memory + start) - 1;
+    header->size = size;
+    header->offset = 0;
+    header->scope = (uint32_t)scope;
+    arena->last = start;
+    arena->lastHead = arena->head;
+    arena->head = start + size;
+    Unlock(&arena->mutex);
+    return arena->memory + start;
+}
+
+// the newest allocation grows and shrinks in place
+static void* ArenaRealloc(void* userData,
+  void* memory,
+  size_t size,
+  size_t alignment) {
+    EHostArena arena = userData;
+    struct EHostHeader* header = (struct EHostHeader*)memory - 1;
+    if (header->offset) {
+        return ParentRealloc(&arena->parent, memory, size, alignment);
+    }
+    size_t start = (size_t)((char*)memory - arena->memory);
+    Lock(&arena->mutex);
+    if (start == arena->last && start + size >= start
+        && start + size <= arena->size) {
+        header->size = size;
+        arena->head = start + size;
+        Unlock(&arena->mutex);
+        return memory;
+    }
+    Unlock(&arena->mutex);
+    void* moved =
+      ArenaAlloc(userData, size, alignment, (EMemoryScope)header->scope);
+    if (!moved) {
+        return NULL;
+    }
+    memcpy(moved, memory, size < header->size ? size : header->size);
+    return moved;
+}
+
+static void ArenaFree(void* userData, void* memory) {
+    EHostArena arena = userData;
+    struct EHostHeader* header = (struct EHostHeader*)memory - 1;
+    if (header->offset) {
+        ParentFree(&arena->parent, memory);
+        return;
+    }
+    Lock(&arena->mutex);
+    size_t start = (size_t)((char*)memory - arena->memory);
+    if (start == arena->last) {
+        // header and alignment padding included
+        arena->head = arena->lastHead;
+        arena->last = 0;
+    }
+    Unlock(&arena->mutex);
+}
+
+static void* VkAlloc(void* userData,
+  size_t size,
+  size_t alignment,
+  VkSystemAllocationScope scope) {
+    (void)userData;
+    (void)scope;
+    return hostAllocator.alloc(
+      hostAllocator.userData, size, alignment, E_MEMORY_SCOPE_VULKAN);
+}
+
+// realloc with a size of 0 frees, the Vulkan spec wants it so
+static void* VkRealloc(void* userData,
+  void* memory,
+  size_t size,
+  size_t alignment,
+  VkSystemAllocationScope scope) {
+    if (!memory) {
+        return VkAlloc(userData, size, alignment, scope);
+    }
+    if (!size) {
+        VkFree(userData, memory);
+        return NULL;
+    }
+    return hostAllocator.realloc(
+      hostAllocator.userData, memory, size, alignment);
+}
+
+static void VkFree(void* userData, void* memory) {
+    (void)userData;
+    eFree(memory);
+}
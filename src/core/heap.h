@@ -0,0 +1,27 @@
+#pragma once
+
+#include "../graphics.h"
+
+E_EXTERN const EHostAllocator* eGetDefaultHostAllocator(void);
+// Process wide. Install it before the first window or context is created
+// and keep it until the last one is destroyed, NULL restores the default.
+E_EXTERN void eSetHostAllocator(const EHostAllocator* allocator);
+
+E_EXTERN void eCreateHostTracker(EHostTracker* trackerOut,
+  EHostTrackerCreateInfo* infoIn);
+E_EXTERN void eDestroyHostTracker(EHostTracker tracker);
+E_EXTERN const EHostAllocator* eGetHostTrackerAllocator(EHostTracker tracker);
+E_EXTERN void eGetHostMemoryStats(EHostTracker tracker,
+  EHostMemoryStats* statsOut);
+E_EXTERN void eExpectNoHostAllocations(EHostTracker tracker,
+  uint32_t scopeMask);
+
+E_EXTERN void eCreateHostPool(EHostPool* poolOut, EHostPoolCreateInfo* infoIn);
+E_EXTERN void eDestroyHostPool(EHostPool pool);
+E_EXTERN const EHostAllocator* eGetHostPoolAllocator(EHostPool pool);
+
+E_EXTERN void eCreateHostArena(EHostArena* arenaOut,
+  EHostArenaCreateInfo* infoIn);
+E_EXTERN void eDestroyHostArena(EHostArena arena);
+E_EXTERN const EHostAllocator* eGetHostArenaAllocator(EHostArena arena);
+E_EXTERN void eResetHostArena(EHostArena arena);
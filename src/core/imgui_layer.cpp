@@ -1,21 +1,194 @@
 #include "imgui_layer.hpp"
 
 #include "core.h"
+#include "glyphs.h"
 #include "renderer.h"
+#include "sdf.h"
 
 
-#include <array>
+#include <algorithm>
+#include <cstring>
 #include <imgui_impl_glfw.h>
-#include <memory>
+#include <imgui_internal.h>
+#include <stdexcept>
 #include <string>
 
 
 namespace {
 ERenderer renderer = nullptr;
+ETexture fontTexture = nullptr;
+// offscreen displays run without a window and so without the glfw backend
+bool platformBackend = false;
+// eAddGlyphText left out glyphs that are still uploading this frame
+bool glyphsPending = false;
+
+// Storage is reused between frames so steady state frames don't allocate.
+// ImVector grows through the imgui allocator, so in E_MEMORY_SCOPE_IMGUI.
+ImVector<EDrawList> drawLists;
+ImVector<EDrawCmd> drawCmds;
+EDrawData drawData{};
+
+// Never called, marks the commands eAddCellRects added. The renderer draws
+// their cells itself.
+void CellRectCallback(const ImDrawList* /*list*/, const ImDrawCmd* /*cmd*/) {}
+
+auto ImguiAlloc(size_t size, void* /*user*/) -> void* {
+    return eAlloc(size, E_MEMORY_SCOPE_IMGUI);
+}
+
+void ImguiFree(void* memory, void* /*user*/) { eFree(memory); }
+
+auto IsDrawn(const ImDrawCmd& cmd) -> bool {
+    return cmd.UserCallback == nullptr || cmd.UserCallback == CellRectCallback;
+}
+
+void ConvertDrawData(const ImDrawData* src) {
+    // resize keeps the capacity, clear would free it
+    drawLists.resize(0);
+    drawCmds.resize(0);
+    drawData = EDrawData{};
+    if (!src || !src->Valid) {
+        return;
+    }
+
+    for (const ImDrawList* list : src->CmdLists) {
+        for (const ImDrawCmd& cmd : list->CmdBuffer) {
+            if (!IsDrawn(cmd)) {
+                continue;
+            }
+            EDrawCmd dc{};
+            dc.clipRect[0] = cmd.ClipRect.x;
+            dc.clipRect[1] = cmd.ClipRect.y;
+            dc.clipRect[2] = cmd.ClipRect.z;
+            dc.clipRect[3] = cmd.ClipRect.w;
+            dc.vtxOffset = cmd.VtxOffset;
+            dc.idxOffset = cmd.IdxOffset;
+            if (cmd.UserCallback != nullptr) {
+                // ImGui copied the cells into the draw list's own storage
+                dc.cells = static_cast<const ECellRect*>(cmd.UserCallbackData);
+                dc.cellCount = static_cast<uint32_t>(
+                  cmd.UserCallbackDataSize / sizeof(ECellRect));
+                drawData.totalCellCount += dc.cellCount;
+            }
+            else {
+                dc.textureId = cmd.GetTexID();
+                dc.elemCount = cmd.ElemCount;
+            }
+            drawCmds.push_back(dc);
+        }
+    }
+
+    // pointers into drawCmds are only stable once it stopped growing
+    size_t cmdNext = 0;
+    for (const ImDrawList* list : src->CmdLists) {
+        EDrawList dl{};
+        dl.vtxData = list->VtxBuffer.Data;
+        dl.vtxCount = static_cast<uint32_t>(list->VtxBuffer.Size);
+        dl.idxData = list->IdxBuffer.Data;
+        dl.idxCount = static_cast<uint32_t>(list->IdxBuffer.Size);
+        dl.cmds = drawCmds.Data + cmdNext;
+        for (const ImDrawCmd& cmd : list->CmdBuffer) {
+            if (IsDrawn(cmd)) {
+                dl.cmdCount++;
+            }
+        }
+        cmdNext += dl.cmdCount;
+        drawLists.push_back(dl);
+    }
+
+    drawData.lists = drawLists.Data;
+    drawData.listCount = static_cast<uint32_t>(drawLists.Size);
+    drawData.totalVtxCount = static_cast<uint32_t>(src->TotalVtxCount);
+    drawData.totalIdxCount = static_cast<uint32_t>(src->TotalIdxCount);
+    drawData.displayPos[0] = src->DisplayPos.x;
+    drawData.displayPos[1] = src->DisplayPos.y;
+    drawData.displaySize[0] = src->DisplaySize.x;
+    drawData.displaySize[1] = src->DisplaySize.y;
+    drawData.framebufferScale[0] = src->FramebufferScale.x;
+    drawData.framebufferScale[1] = src->FramebufferScale.y;
+}
+
+#if E_ENABLE_SDF_FONTS
+// Grows every glyph's quad and uvs by the spread, the field fades out in the
+// padding around the glyph's bitmap and would be cut off at its border.
+void ExpandGlyphs(ImFont* font, int width, int height) {
+    const auto w = static_cast<float>(width);
+    const auto h = static_cast<float>(height);
+    const auto spread = static_cast<float>(E_SDF_SPREAD);
+    for (ImFontGlyph& glyph : font->Glyphs) {
+        if (glyph.Visible == 0) {
+            continue;
+        }
+        // the packer pads right and bottom only, the atlas border has none
+        float left = std::min(spread, glyph.U0 * w);
+        float top = std::min(spread, glyph.V0 * h);
+        float right = std::min(spread, (1.f - glyph.U1) * w);
+        float bottom = std::min(spread, (1.f - glyph.V1) * h);
+        glyph.X0 -= left;
+        glyph.Y0 -= top;
+        glyph.X1 += right;
+        glyph.Y1 += bottom;
+        glyph.U0 -= left / w;
+        glyph.V0 -= top / h;
+        glyph.U1 += right / w;
+        glyph.V1 += bottom / h;
+    }
+}
+
+// Bakes the default font once at E_SDF_FONT_SIZE as a distance field, text
+// of any size and zoom is drawn from it by scaling the font instead of
+// rebuilding the atlas. Fills one byte per texel with the field.
+auto BuildSdfFontAtlas(ImFontAtlas* atlas,
+  ImVector<unsigned char>* pixelsOut,
+  int* widthOut,
+  int* heightOut) -> EResult {
+    ImFontConfig config;
+    config.SizePixels = E_SDF_FONT_SIZE;
+    // the field is measured in texels, oversampling would stretch it
+    config.OversampleH = 1;
+    config.OversampleV = 1;
+    ImFont* font = atlas->AddFontDefault(&config);
+    // both are drawn from coverage, imgui falls back to geometry for lines
+    atlas->Flags |= ImFontAtlasFlags_NoBakedLines
+                    | ImFontAtlasFlags_NoMouseCursors;
+    // room for both neighbours' falloff
+    atlas->TexGlyphPadding = 2 * E_SDF_SPREAD;
+
+    unsigned char* coverage = nullptr;
+    int width = 0;
+    int height = 0;
+    atlas->GetTexDataAsAlpha8(&coverage, &width, &height);
+    ImVector<unsigned char>& field = *pixelsOut;
+    field.resize(width * height);
+    EResult res = eBuildDistanceField(coverage,
+      static_cast<uint32_t>(width),
+      static_cast<uint32_t>(height),
+      E_SDF_SPREAD,
+      field.Data);
+    if (res != E_SUCCESS) {
+        return res;
+    }
+    // untextured shapes sample the white pixels, they must stay fully inside
+    const ImFontAtlasCustomRect* white =
+      atlas->GetCustomRectByIndex(atlas->PackIdMouseCursors);
+    for (int y = white->Y; y < white->Y + white->Height; ++y) {
+        for (int x = white->X; x < white->X + white->Width; ++x) {
+            field[static_cast<size_t>(y) * width + x] = 255;
+        }
+    }
+    ExpandGlyphs(font, width, height);
+    font->Scale = E_DEFAULT_FONT_SIZE / E_SDF_FONT_SIZE;
+
+    *widthOut = width;
+    *heightOut = height;
+    return E_SUCCESS;
 }
+#endif
+} // namespace
 
 void eBeginImgui(EDisplay display, EContext context, EWindow window) {
     IMGUI_CHECKVERSION();
+    ImGui::SetAllocatorFunctions(ImguiAlloc, ImguiFree, nullptr);
     ImGui::CreateContext();
     ImGuiIO& io = ImGui::GetIO();
     io.ConfigFlags |= ImGuiConfigFlags_NavEnableKeyboard;
@@ -24,47 +197,187 @@ void eBeginImgui(EDisplay display, EContext context, EWindow window) {
     ImGui::StyleColorsDark();
 
     // initialize imgui
-    ImGui_ImplGlfw_InitForVulkan(window->window, E_ENABLE_ERROR_CALLBACK);
+    // chains to the window's own callbacks, which keep track of dirty frames
+    platformBackend = window != nullptr;
+    if (platformBackend) {
+        ImGui_ImplGlfw_InitForVulkan(window->window, true);
+    }
 
     // initialize vulkan
     // io.BackendRendererUserData
     io.BackendFlags |= ImGuiBackendFlags_RendererHasVtxOffset;
 
-    auto offsets = std::make_unique<std::array<uint32_t, 3>>();
-    (*offsets)[0] = offsetof(ImDrawVert, pos);
-    (*offsets)[1] = offsetof(ImDrawVert, uv);
-    (*offsets)[2] = offsetof(ImDrawVert, col);
+    // the renderer copies the vertex layout, it doesn't keep the pointers
+    static const uint32_t offsets[3] = {
+        offsetof(ImDrawVert, pos),
+        offsetof(ImDrawVert, uv),
+        offsetof(ImDrawVert, col),
+    };
+#if E_COMPACT_VERTICES
+    static const EVertexFormat formats[3] = {
+        E_VERTEX_FORMAT_HALF2,
+        E_VERTEX_FORMAT_UNORM16X2,
+        E_VERTEX_FORMAT_UNORM8X4,
+    };
+#else
+    static const EVertexFormat formats[3] = {
+        E_VERTEX_FORMAT_FLOAT2,
+        E_VERTEX_FORMAT_FLOAT2,
+        E_VERTEX_FORMAT_UNORM8X4,
+    };
+#endif
 
     ERendererCreateInfo rci = {};
     rci.context = context;
     rci.display = display;
     rci.imguiVertData.inputAttrCount = 3;
     rci.imguiVertData.inputAttrSize = sizeof(ImDrawVert);
-    rci.imguiVertData.inputAttrOffsets = offsets->data();
+    rci.imguiVertData.inputAttrOffsets = offsets;
+    rci.imguiVertData.inputAttrFormats = formats;
+    rci.imguiVertData.indexSize = sizeof(ImDrawIdx);
 
     eCreateRenderer(&renderer, &rci);
     if (renderer->result != E_SUCCESS) {
-        throw std::exception(std::to_string(renderer->result).c_str());
+        throw std::runtime_error(std::to_string(renderer->result));
     }
+
+    // font atlas streams in over the transfer queue, text shows up once done
+    unsigned char* pixels = nullptr;
+    int width = 0;
+    int height = 0;
+    ETextureCreateInfo tci = {};
+#if E_ENABLE_SDF_FONTS
+    ImVector<unsigned char> field;
+    EResult sdfResult = BuildSdfFontAtlas(io.Fonts, &field, &width, &height);
+    if (sdfResult != E_SUCCESS) {
+        throw std::runtime_error(std::to_string(sdfResult));
+    }
+    pixels = field.Data;
+    tci.distanceField = 1;
+#else
+    io.Fonts->GetTexDataAsAlpha8(&pixels, &width, &height);
+#endif
+    tci.alphaOnly = 1;
+
+    tci.pixels = pixels;
+    tci.width = static_cast<uint32_t>(width);
+    tci.height = static_cast<uint32_t>(height);
+    eCreateTexture(&fontTexture, renderer, context, &tci);
+    if (eGetResult(fontTexture) != E_SUCCESS) {
+        throw std::runtime_error(std::to_string(eGetResult(fontTexture)));
+    }
+    io.Fonts->SetTexID(static_cast<ImTextureID>(eGetTextureId(fontTexture)));
 }
 
 void eEndImgui(EContext context) noexcept {
+    eDestroyTexture(fontTexture, renderer, context);
+    fontTexture = nullptr;
     eDestroyRenderer(renderer, context);
-    ImGui_ImplGlfw_Shutdown();
+    renderer = nullptr;
+    // freed while the host allocator the app installed is still around
+    drawLists.clear();
+    drawCmds.clear();
+    if (platformBackend) {
+        ImGui_ImplGlfw_Shutdown();
+    }
     ImGui::DestroyContext();
 }
 
 
 void eDrawImgui(EDisplay display, EContext context, EWindow window) {
     // eBeginFrame();
-    // ImGui_ImplGlfw_NewFrame();
+    if (platformBackend) {
+        ImGui_ImplGlfw_NewFrame();
+    }
+    else {
+        // no input, a fixed time step keeps offscreen frames reproducible
+        ImGuiIO& io = ImGui::GetIO();
+        io.DisplaySize = ImVec2(static_cast<float>(display->width),
+          static_cast<float>(display->height));
+        io.DeltaTime = 1.f / 60.f;
+    }
     VkResult err{};
 
-
+    glyphsPending = false;
     ImGui::NewFrame();
 
     // app
 
     ImGui::Render();
+    ConvertDrawData(ImGui::GetDrawData());
+    eSetDrawData(renderer, &drawData);
     // eEndFrame();
-}
\ No newline at end of file
+}
+
+auto eGetImguiRenderer() -> ERenderer {
+    return renderer;
+}
+
+// How long the main loop may sleep before imgui has something to animate,
+// negative means until the next event.
+auto eGetImguiWaitTimeout() -> double {
+    const ImGuiIO& io = ImGui::GetIO();
+    if (io.WantTextInput && io.ConfigInputTextCursorBlink) {
+        // cursor blink toggles at 0.8s and 1.2s of its 1.2s period
+        return 0.4;
+    }
+    if (glyphsPending) {
+        // uploads rarely take longer than a frame
+        return 1.0 / 60.0;
+    }
+    if (ImGui::IsAnyItemHovered() || ImGui::IsAnyItemActive()) {
+        // tooltips and hover delays progress without input
+        return 0.1;
+    }
+    return -1.0;
+}
+
+// Queues the rects to be drawn as one instanced draw, clipped to the list's
+// current clip rect and ordered with the list's other draws. The rects are
+// copied, they only have to outlive the call.
+void eAddCellRects(ImDrawList* list, const ECellRect* rects, uint32_t count) {
+    if (count == 0) {
+        return;
+    }
+    list->AddCallback(CellRectCallback,
+      const_cast<ECellRect*>(rects),
+      sizeof(*rects) * count);
+}
+
+// Draws a line of UTF-8 text from the glyph cache with its top left at pos,
+// rasterizing glyphs on first use. Glyphs still uploading take up their
+// space but are left out until a later frame. Returns the x the pen ended
+// at.
+auto eAddGlyphText(ImDrawList* list,
+  EGlyphCache cache,
+  const ImVec2& pos,
+  uint32_t color,
+  const char* text,
+  const char* textEnd) -> float {
+    if (textEnd == nullptr) {
+        textEnd = text + std::strlen(text);
+    }
+    float x = pos.x;
+    while (text < textEnd) {
+        unsigned int codepoint = 0;
+        text += ImTextCharFromUtf8(&codepoint, text, textEnd);
+        EGlyphQuad quad{};
+        if (eGetGlyph(cache, codepoint, &quad) != E_SUCCESS) {
+            continue;
+        }
+        if (quad.textureId != 0) {
+            // consecutive glyphs on the same page end up in one command
+            list->AddImage(static_cast<ImTextureID>(quad.textureId),
+              ImVec2(x + quad.rect[0], pos.y + quad.rect[1]),
+              ImVec2(x + quad.rect[2], pos.y + quad.rect[3]),
+              ImVec2(quad.uv0[0], quad.uv0[1]),
+              ImVec2(quad.uv1[0], quad.uv1[1]),
+              color);
+        }
+        else if (quad.rect[2] > quad.rect[0]) {
+            glyphsPending = true;
+        }
+        x += quad.advance;
+    }
+    return x;
+}
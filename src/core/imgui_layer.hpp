@@ -4,6 +4,18 @@ extern "C" {
 #include "../graphics.h"
 }
 
+struct ImDrawList;
+struct ImVec2;
+
 void eBeginImgui(EDisplay display, EContext context, EWindow window);
 void eDrawImgui(EDisplay display, EContext context, EWindow window);
 void eEndImgui(EContext context) noexcept;
+auto eGetImguiWaitTimeout() -> double;
+auto eGetImguiRenderer() -> ERenderer;
+void eAddCellRects(ImDrawList* list, const ECellRect* rects, uint32_t count);
+auto eAddGlyphText(ImDrawList* list,
+  EGlyphCache cache,
+  const ImVec2& pos,
+  uint32_t color,
+  const char* text,
+  const char* textEnd = nullptr) -> float;
@@ -0,0 +1,604 @@
+#include "context.h"
+
+#include "core.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+
+static uint32_t HighestBit(uint64_t x);
+static uint32_t LowestBit(uint64_t x);
+static void MapSize(VkDeviceSize size, uint32_t* flOut, uint32_t* slOut);
+static int ReserveNodes(struct EMemoryBlock* block, uint32_t count);
+static uint32_t NewNode(struct EMemoryBlock* block);
+static void ReleaseNode(struct EMemoryBlock* block, uint32_t index);
+static void InsertFree(struct EMemoryBlock* block, uint32_t index);
+static void RemoveFree(struct EMemoryBlock* block, uint32_t index);
+static uint32_t FindFree(struct EMemoryBlock* block, VkDeviceSize size);
+static uint32_t PlaceInBlock(struct EMemoryBlock* block,
+  VkDeviceSize size,
+  VkDeviceSize alignment);
+static void FreeInBlock(struct EMemoryBlock* block, uint32_t index);
+static struct EMemoryBlock* CreateBlock(EContext context,
+  uint32_t type,
+  int optimal,
+  VkDeviceSize size);
+static void DestroyBlock(EContext context, struct EMemoryBlock* block);
+static EResult AllocateDedicated(EContext context,
+  VkDeviceSize size,
+  uint32_t type,
+  struct EAllocation* allocationOut);
+
+
+E_EXTERN void eCreateAllocator(EContext context) {
+    if (context->result != E_SUCCESS) {
+        return;
+    }
+    struct EAllocator* allocator = &context->allocator;
+    vkGetPhysicalDeviceMemoryProperties(
+      context->physicalDevice, &allocator->properties);
+    // small heaps, like the host visible part of VRAM, get smaller blocks
+    for (uint32_t i = 0; i < allocator->properties.memoryHeapCount; ++i) {
+        VkDeviceSize heapSize = allocator->properties.memoryHeaps[i].size;
+        allocator->blockSizes[i] = heapSize / 8 < E_MEMORY_BLOCK_SIZE
+                                     ? heapSize / 8
+                                     : E_MEMORY_BLOCK_SIZE;
+    }
+}
+
+E_EXTERN void eDestroyAllocator(EContext context) {
+    struct EAllocator* allocator = &context->allocator;
+    for (uint32_t i = 0; i < VK_MAX_MEMORY_TYPES; ++i) {
+        for (uint32_t j = 0; j < 2; ++j) {
+            struct EMemoryPool* pool = &allocator->pools[i][j];
+            for (uint32_t k = 0; k < pool->blockCount; ++k) {
+                DestroyBlock(context, pool->blocks[k]);
+            }
+            eFree(pool->blocks);
+            *pool = (struct EMemoryPool){ 0 };
+        }
+    }
+}
+
+// Places the allocation in a block of the first memory type with the flags,
+// only allocations bigger than half a block call vkAllocateMemory. Optimally
+// tiled images pass optimal, everything else is placed as linear.
+E_EXTERN EResult eAllocateMemory(EContext context,
+  const VkMemoryRequirements* req,
+  VkMemoryPropertyFlags flags,
+  int optimal,
+  struct EAllocation* allocationOut) {
+    *allocationOut = (struct EAllocation){ 0 };
+    struct EAllocator* allocator = &context->allocator;
+    uint32_t type = eFindMemoryType(context, req->memoryTypeBits, flags);
+    if (type == UINT32_MAX) {
+        return E_ALLOCATE_MEMORY_FAILURE;
+    }
+    uint32_t heap = allocator->properties.memoryTypes[type].heapIndex;
+    VkDeviceSize blockSize = allocator->blockSizes[heap];
+    if (req->size > blockSize / 2) {
+        return AllocateDedicated(context, req->size, type, allocationOut);
+    }
+
+    struct EMemoryPool* pool = &allocator->pools[type][optimal ? 1 : 0];
+    struct EMemoryBlock* block = NULL;
+    uint32_t node = { E_NO_MEMORY_NODE };
+    for (uint32_t i = 0; i < pool->blockCount && node == E_NO_MEMORY_NODE;
+         ++i) {
+        block = pool->blocks[i];
+        node = PlaceInBlock(block, req->size, req->alignment);
+    }
+    if (node == E_NO_MEMORY_NODE) {
+        if (pool->blockCount == pool->blockCapacity) {
+            uint32_t capacity =
+              pool->blockCapacity ? pool->blockCapacity * 2 : 4;
+            struct EMemoryBlock** blocks = eRealloc(
+              pool->blocks, sizeof(*blocks) * capacity, E_MEMORY_SCOPE_CONTEXT);
+            if (!blocks) {
+                return E_MALLOC_FAILURE;
+            }
+            pool->blocks = blocks;
+            pool->blockCapacity = capacity;
+        }
+        block = CreateBlock(context, type, optimal, blockSize);
+        if (!block) {
+            return E_ALLOCATE_MEMORY_FAILURE;
+        }
+        pool->blocks[pool->blockCount++] = block;
+        node = PlaceInBlock(block, req->size, req->alignment);
+        if (node == E_NO_MEMORY_NODE) {
+            return E_MALLOC_FAILURE;
+        }
+    }
+
+    allocationOut->memory = block->memory;
+    allocationOut->offset = block->nodes[node].offset;
+    allocationOut->size = req->size;
+    allocationOut->block = block;
+    allocationOut->node = node;
+    allocationOut->heap = heap;
+    if (block->mapped) {
+        allocationOut->mapped = (char*)block->mapped + allocationOut->offset;
+    }
+    allocator->stats.allocationCount += 1;
+    allocator->stats.allocatedBytes += req->size;
+    allocator->heapUsedBytes[heap] += req->size;
+    return E_SUCCESS;
+}
+
+// The caller guarantees the GPU no longer uses the memory. Empty blocks are
+// released, except for the last one of a pool so that a resource freed and
+// allocated every frame doesn't reach the driver.
+E_EXTERN void eFreeMemory(EContext context, struct EAllocation* allocation) {
+    if (!allocation->memory) {
+        return;
+    }
+    struct EAllocator* allocator = &context->allocator;
+    struct EMemoryBlock* block = allocation->block;
+    if (!block) {
+        if (allocation->mapped) {
+            vkUnmapMemory(context->device, allocation->memory);
+        }
+        vkFreeMemory(context->device, allocation->memory, context->vkAllocator);
+        allocator->stats.dedicatedCount -= 1;
+        allocator->stats.dedicatedBytes -= allocation->size;
+        allocator->heapBytes[allocation->heap] -= allocation->size;
+        allocator->heapUsedBytes[allocation->heap] -= allocation->size;
+        *allocation = (struct EAllocation){ 0 };
+        return;
+    }
+
+    FreeInBlock(block, allocation->node);
+    allocator->stats.allocationCount -= 1;
+    allocator->stats.allocatedBytes -= allocation->size;
+    allocator->heapUsedBytes[allocation->heap] -= allocation->size;
+    *allocation = (struct EAllocation){ 0 };
+
+    struct EMemoryPool* pool =
+      &allocator->pools[block->memoryType][block->optimal];
+    if (block->allocationCount == 0 && pool->blockCount > 1) {
+        for (uint32_t i = 0; i < pool->blockCount; ++i) {
+            if (pool->blocks[i] == block) {
+                pool->blocks[i] = pool->blocks[--pool->blockCount];
+                break;
+            }
+        }
+        DestroyBlock(context, block);
+    }
+}
+
+E_EXTERN EResult eAllocateBufferMemory(EContext context,
+  VkBuffer buffer,
+  VkMemoryPropertyFlags flags,
+  struct EAllocation* allocationOut) {
+    VkMemoryRequirements req = { 0 };
+    vkGetBufferMemoryRequirements(context->device, buffer, &req);
+    EResult result = eAllocateMemory(context, &req, flags, 0, allocationOut);
+    if (result != E_SUCCESS) {
+        return result;
+    }
+    VkResult err = vkBindBufferMemory(context->device,
+      buffer,
+      allocationOut->memory,
+      allocationOut->offset);
+    if (err != VK_SUCCESS) {
+        eFreeMemory(context, allocationOut);
+        return E_ALLOCATE_MEMORY_FAILURE;
+    }
+    return E_SUCCESS;
+}
+
+// for optimally tiled images
+E_EXTERN EResult eAllocateImageMemory(EContext context,
+  VkImage image,
+  VkMemoryPropertyFlags flags,
+  struct EAllocation* allocationOut) {
+    VkMemoryRequirements req = { 0 };
+    vkGetImageMemoryRequirements(context->device, image, &req);
+    EResult result = eAllocateMemory(context, &req, flags, 1, allocationOut);
+    if (result != E_SUCCESS) {
+        return result;
+    }
+    VkResult err = vkBindImageMemory(context->device,
+      image,
+      allocationOut->memory,
+      allocationOut->offset);
+    if (err != VK_SUCCESS) {
+        eFreeMemory(context, allocationOut);
+        return E_ALLOCATE_MEMORY_FAILURE;
+    }
+    return E_SUCCESS;
+}
+
+E_EXTERN void eGetMemoryStats(EContext context, EMemoryStats* statsOut) {
+    *statsOut = context->allocator.stats;
+}
+
+// Queried every call, the driver's numbers change with other processes.
+// Without VK_EXT_memory_budget other processes are unknown, the estimate
+// leaves room for them and the desktop: half of the heaps when they are
+// system memory, a fifth of them on a discrete GPU.
+E_EXTERN void eGetMemoryBudget(EContext context, EMemoryBudget* budgetOut) {
+    *budgetOut = (EMemoryBudget){ .estimated = !context->memoryBudget };
+    const struct EAllocator* allocator = &context->allocator;
+    const VkPhysicalDeviceMemoryProperties* props = &allocator->properties;
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT mbp = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT,
+    };
+    VkPhysicalDeviceMemoryProperties2 pmp = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2,
+        .pNext = &mbp,
+    };
+    if (context->memoryBudget) {
+        vkGetPhysicalDeviceMemoryProperties2(context->physicalDevice, &pmp);
+    }
+    VkPhysicalDeviceType type = context->properties.deviceType;
+    int unified = type == VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU
+                  || type == VK_PHYSICAL_DEVICE_TYPE_CPU;
+
+    for (uint32_t i = 0; i < props->memoryHeapCount; ++i) {
+        if (!(props->memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)) {
+            continue;
+        }
+        VkDeviceSize unused =
+          allocator->heapBytes[i] - allocator->heapUsedBytes[i];
+        if (context->memoryBudget) {
+            VkDeviceSize usage = mbp.heapUsage[i];
+            budgetOut->budget += mbp.heapBudget[i];
+            budgetOut->usage += usage > unused ? usage - unused : 0;
+        }
+        else {
+            VkDeviceSize size = props->memoryHeaps[i].size;
+            budgetOut->budget += unified ? size / 2 : size / 5 * 4;
+            budgetOut->usage += allocator->heapUsedBytes[i];
+        }
+    }
+}
+
+E_EXTERN void eResetArena(struct EArena* arena) {
+    arena->head = 0;
+}
+
+// alignment must be a power of two
+E_EXTERN VkDeviceSize
+  eArenaPush(struct EArena* arena, VkDeviceSize size, VkDeviceSize alignment) {
+    VkDeviceSize offset = (arena->head + alignment - 1) & ~(alignment - 1);
+    arena->head = offset + size;
+    return offset;
+}
+
+// may replace the buffer, so the frame must be done with the previous one
+E_EXTERN EResult eCommitArena(EContext context,
+  struct EArena* arena,
+  VkBufferUsageFlags usage) {
+    return eReserveStreamBuffer(context, &arena->stream, arena->head, usage);
+}
+
+static uint32_t HighestBit(uint64_t x) {
+#ifdef _MSC_VER
+    unsigned long index = { 0 };
+    _BitScanReverse64(&index, x);
+    return (uint32_t)index;
+#else
+    return 63u - (uint32_t)__builtin_clzll(x);
+#endif
+}
+
+static uint32_t LowestBit(uint64_t x) {
+#ifdef _MSC_VER
+    unsigned long index = { 0 };
+    _BitScanForward64(&index, x);
+    return (uint32_t)index;
+#else
+    return (uint32_t)__builtin_ctzll(x);
+#endif
+}
+
+// Sizes below E_TLSF_SL_COUNT get a class each, above it every power of two
+// is split into E_TLSF_SL_COUNT linear classes.
+static void MapSize(VkDeviceSize size, uint32_t* flOut, uint32_t* slOut) {
+    if (size < E_TLSF_SL_COUNT) {
+        *flOut = 0;
+        *slOut = (uint32_t)size;
+        return;
+    }
+    uint32_t msb = HighestBit(size);
+    *flOut = msb - E_TLSF_SL_BITS + 1;
+    *slOut = (uint32_t)(size >> (msb - E_TLSF_SL_BITS)) - E_TLSF_SL_COUNT;
+}
+
+// Splitting takes up to two nodes, reserving them first keeps the node
+// array from moving halfway through.
+static int ReserveNodes(struct EMemoryBlock* block, uint32_t count) {
+    if (block->nodeCount + count <= block->nodeCapacity) {
+        return 1;
+    }
+    uint32_t capacity = block->nodeCapacity ? block->nodeCapacity * 2 : 64;
+    while (capacity < block->nodeCount + count) {
+        capacity *= 2;
+    }
+    struct EMemoryNode* nodes =
+      eRealloc(block->nodes, sizeof(*nodes) * capacity, E_MEMORY_SCOPE_CONTEXT);
+    if (!nodes) {
+        return 0;
+    }
+    block->nodes = nodes;
+    block->nodeCapacity = capacity;
+    return 1;
+}
+
+static uint32_t NewNode(struct EMemoryBlock* block) {
+    uint32_t index = block->firstUnused;
+    if (index != E_NO_MEMORY_NODE) {
+        block->firstUnused = block->nodes[index].nextFree;
+    }
+    else {
+        index = block->nodeCount++;
+    }
+    block->nodes[index] = (struct EMemoryNode){
+        .prevPhys = E_NO_MEMORY_NODE,
+        .nextPhys = E_NO_MEMORY_NODE,
+        .prevFree = E_NO_MEMORY_NODE,
+        .nextFree = E_NO_MEMORY_NODE,
+    };
+    return index;
+}
+
+static void ReleaseNode(struct EMemoryBlock* block, uint32_t index) {
+    block->nodes[index].nextFree = block->firstUnused;
+    block->firstUnused = index;
+}
+
+static void InsertFree(struct EMemoryBlock* block, uint32_t index) {
+    struct EMemoryNode* node = &block->nodes[index];
+    uint32_t fl = { 0 };
+    uint32_t sl = { 0 };
+    MapSize(node->size, &fl, &sl);
+    node->free = 1;
+    node->prevFree = E_NO_MEMORY_NODE;
+    node->nextFree = block->heads[fl][sl];
+    if (node->nextFree != E_NO_MEMORY_NODE) {
+        block->nodes[node->nextFree].prevFree = index;
+    }
+    block->heads[fl][sl] = index;
+    block->flMap |= 1ull << fl;
+    block->slMap[fl] |= 1u << sl;
+}
+
+static void RemoveFree(struct EMemoryBlock* block, uint32_t index) {
+    struct EMemoryNode* node = &block->nodes[index];
+    uint32_t fl = { 0 };
+    uint32_t sl = { 0 };
+    MapSize(node->size, &fl, &sl);
+    if (node->prevFree != E_NO_MEMORY_NODE) {
+        block->nodes[node->prevFree].nextFree = node->nextFree;
+    }
+    else {
+        block->heads[fl][sl] = node->nextFree;
+    }
+    if (node->nextFree != E_NO_MEMORY_NODE) {
+        block->nodes[node->nextFree].prevFree = node->prevFree;
+    }
+    if (block->heads[fl][sl] == E_NO_MEMORY_NODE) {
+        block->slMap[fl] &= ~(1u << sl);
+        if (!block->slMap[fl]) {
+            block->flMap &= ~(1ull << fl);
+        }
+    }
+    node->free = 0;
+}
+
+// Rounds the size up to the next class first, then every node of the class
+// found fits without walking its list.
+static uint32_t FindFree(struct EMemoryBlock* block, VkDeviceSize size) {
+    if (size >= E_TLSF_SL_COUNT) {
+        size += ((VkDeviceSize)1 << (HighestBit(size) - E_TLSF_SL_BITS)) - 1;
+    }
+    uint32_t fl = { 0 };
+    uint32_t sl = { 0 };
+    MapSize(size, &fl, &sl);
+    if (fl >= E_TLSF_FL_COUNT) {
+        return E_NO_MEMORY_NODE;
+    }
+    uint32_t slMap = block->slMap[fl] & (~0u << sl);
+    if (!slMap) {
+        uint64_t flMap =
+          fl + 1 < 64 ? block->flMap & (~0ull << (fl + 1)) : 0;
+        if (!flMap) {
+            return E_NO_MEMORY_NODE;
+        }
+        fl = LowestBit(flMap);
+        slMap = block->slMap[fl];
+    }
+    return block->heads[fl][LowestBit(slMap)];
+}
+
+// Takes a free node big enough for the aligned size, the space in front of
+// the aligned offset and behind the allocation stays free.
+static uint32_t PlaceInBlock(struct EMemoryBlock* block,
+  VkDeviceSize size,
+  VkDeviceSize alignment) {
+    if (!ReserveNodes(block, 2)) {
+        return E_NO_MEMORY_NODE;
+    }
+    if (!alignment) {
+        alignment = 1;
+    }
+    uint32_t index = FindFree(block, size + alignment - 1);
+    if (index == E_NO_MEMORY_NODE) {
+        return E_NO_MEMORY_NODE;
+    }
+    RemoveFree(block, index);
+
+    struct EMemoryNode* node = &block->nodes[index];
+    VkDeviceSize aligned = (node->offset + alignment - 1) & ~(alignment - 1);
+    if (aligned != node->offset) {
+        uint32_t gap = NewNode(block);
+        block->nodes[gap].offset = node->offset;
+        block->nodes[gap].size = aligned - node->offset;
+        block->nodes[gap].prevPhys = node->prevPhys;
+        block->nodes[gap].nextPhys = index;
+        if (node->prevPhys != E_NO_MEMORY_NODE) {
+            block->nodes[node->prevPhys].nextPhys = gap;
+        }
+        node->prevPhys = gap;
+        node->size -= aligned - node->offset;
+        node->offset = aligned;
+        InsertFree(block, gap);
+    }
+    if (node->size > size) {
+        uint32_t tail = NewNode(block);
+        block->nodes[tail].offset = node->offset + size;
+        block->nodes[tail].size = node->size - size;
+        block->nodes[tail].prevPhys = index;
+        block->nodes[tail].nextPhys = node->nextPhys;
+        if (node->nextPhys != E_NO_MEMORY_NODE) {
+            block->nodes[node->nextPhys].prevPhys = tail;
+        }
+        node->nextPhys = tail;
+        node->size = size;
+        InsertFree(block, tail);
+    }
+    block->allocationCount += 1;
+    return index;
+}
+
+// merges with free neighbours, so no two free nodes are ever adjacent
+static void FreeInBlock(struct EMemoryBlock* block, uint32_t index) {
+    struct EMemoryNode* nodes = block->nodes;
+    uint32_t prev = nodes[index].prevPhys;
+    if (prev != E_NO_MEMORY_NODE && nodes[prev].free) {
+        RemoveFree(block, prev);
+        nodes[prev].size += nodes[index].size;
+        nodes[prev].nextPhys = nodes[index].nextPhys;
+        if (nodes[index].nextPhys != E_NO_MEMORY_NODE) {
+            nodes[nodes[index].nextPhys].prevPhys = prev;
+        }
+        ReleaseNode(block, index);
+        index = prev;
+    }
+    uint32_t next = nodes[index].nextPhys;
+    if (next != E_NO_MEMORY_NODE && nodes[next].free) {
+        RemoveFree(block, next);
+        nodes[index].size += nodes[next].size;
+        nodes[index].nextPhys = nodes[next].nextPhys;
+        if (nodes[next].nextPhys != E_NO_MEMORY_NODE) {
+            nodes[nodes[next].nextPhys].prevPhys = index;
+        }
+        ReleaseNode(block, next);
+    }
+    InsertFree(block, index);
+    block->allocationCount -= 1;
+}
+
+// host visible blocks stay mapped for their whole life
+static struct EMemoryBlock* CreateBlock(EContext context,
+  uint32_t type,
+  int optimal,
+  VkDeviceSize size) {
+    struct EMemoryBlock* block = eAlloc(sizeof(*block), E_MEMORY_SCOPE_CONTEXT);
+    if (!block) {
+        return NULL;
+    }
+    *block = (struct EMemoryBlock){
+        .size = size,
+        .memoryType = type,
+        .optimal = optimal ? 1 : 0,
+        .firstUnused = E_NO_MEMORY_NODE,
+    };
+    memset(block->heads, 0xff, sizeof(block->heads));
+
+    VkMemoryAllocateInfo mai = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        .allocationSize = size,
+        .memoryTypeIndex = type,
+    };
+    VkResult err = vkAllocateMemory(
+      context->device, &mai, context->vkAllocator, &block->memory);
+    if (err != VK_SUCCESS) {
+        eFree(block);
+        return NULL;
+    }
+    uint32_t heap = context->allocator.properties.memoryTypes[type].heapIndex;
+    context->allocator.stats.blockCount += 1;
+    context->allocator.stats.blockBytes += size;
+    context->allocator.heapBytes[heap] += size;
+    if (!ReserveNodes(block, 1)) {
+        DestroyBlock(context, block);
+        return NULL;
+    }
+    VkMemoryPropertyFlags flags =
+      context->allocator.properties.memoryTypes[type].propertyFlags;
+    if (flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+        err = vkMapMemory(
+          context->device, block->memory, 0, VK_WHOLE_SIZE, 0, &block->mapped);
+        if (err != VK_SUCCESS) {
+            DestroyBlock(context, block);
+            return NULL;
+        }
+    }
+
+    uint32_t index = NewNode(block);
+    block->nodes[index].size = size;
+    InsertFree(block, index);
+    return block;
+}
+
+static void DestroyBlock(EContext context, struct EMemoryBlock* block) {
+    uint32_t heap =
+      context->allocator.properties.memoryTypes[block->memoryType].heapIndex;
+    context->allocator.stats.blockCount -= 1;
+    context->allocator.stats.blockBytes -= block->size;
+    context->allocator.heapBytes[heap] -= block->size;
+    if (block->mapped) {
+        vkUnmapMemory(context->device, block->memory);
+    }
+    vkFreeMemory(context->device, block->memory, context->vkAllocator);
+    eFree(block->nodes);
+    eFree(block);
+}
+
+static EResult AllocateDedicated(EContext context,
+  VkDeviceSize size,
+  uint32_t type,
+  struct EAllocation* allocationOut) {
+    VkMemoryAllocateInfo mai = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        .allocationSize = size,
+        .memoryTypeIndex = type,
+    };
+    VkResult err = vkAllocateMemory(
+      context->device, &mai, context->vkAllocator, &allocationOut->memory);
+    if (err != VK_SUCCESS) {
+        allocationOut->memory = VK_NULL_HANDLE;
+        return E_ALLOCATE_MEMORY_FAILURE;
+    }
+    VkMemoryPropertyFlags flags =
+      context->allocator.properties.memoryTypes[type].propertyFlags;
+    if (flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+        err = vkMapMemory(context->device,
+          allocationOut->memory,
+          0,
+          VK_WHOLE_SIZE,
+          0,
+          &allocationOut->mapped);
+        if (err != VK_SUCCESS) {
+            vkFreeMemory(
+              context->device, allocationOut->memory, context->vkAllocator);
+            *allocationOut = (struct EAllocation){ 0 };
+            return E_MAP_MEMORY_FAILURE;
+        }
+    }
+    allocationOut->size = size;
+    allocationOut->heap =
+      context->allocator.properties.memoryTypes[type].heapIndex;
+    context->allocator.stats.dedicatedCount += 1;
+    context->allocator.stats.dedicatedBytes += size;
+    context->allocator.heapBytes[allocationOut->heap] += size;
+    context->allocator.heapUsedBytes[allocationOut->heap] += size;
+    return E_SUCCESS;
+}
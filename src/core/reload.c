@@ -0,0 +1,331 @@
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "core.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if E_ENABLE_SHADER_RELOAD
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <errno.h>
+#include <spawn.h>
+#include <sys/inotify.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+typedef HANDLE EProcess;
+#define E_NO_PROCESS NULL
+#else
+typedef pid_t EProcess;
+#define E_NO_PROCESS 0
+extern char** environ;
+#endif
+
+#define E_RELOAD_PATH_SIZE 1024
+
+// what each stage is compiled from, as in the shaders table in meson.build
+static const char* const sources[E_SHADER_COUNT] = {
+    [E_SHADER_VERT] = "shader.vert",
+    [E_SHADER_FRAG] = "shader.frag",
+    [E_SHADER_CELL_VERT] = "cell.vert",
+    [E_SHADER_CELL_FRAG] = "cell.frag",
+};
+
+// Watches E_SHADER_DIR and recompiles all stages with E_GLSLANG in child
+// processes after a change, the frames keep going meanwhile.
+struct EShaderReload {
+#ifdef _WIN32
+    HANDLE change;  // signaled once a file in the directory was written
+#else
+    int inotify;
+#endif
+    EProcess compilers[E_SHADER_COUNT];  // E_NO_PROCESS once exited
+    int compiling;
+    int failed;  // a compiler of the current run didn't succeed
+    int changed;  // since the current run started
+    uint32_t* spirv[E_SHADER_COUNT];
+    struct EShaderCode code[E_SHADER_COUNT];
+};
+
+static int WatchSources(struct EShaderReload* reload);
+static int SourcesChanged(struct EShaderReload* reload);
+static EProcess StartCompiler(uint32_t stage, int bindless);
+static int CompilerExited(EProcess process, int* failedOut);
+static void OutputPath(uint32_t stage, char* pathOut, size_t size);
+static int ReadSpirv(struct EShaderReload* reload);
+static void FreeSpirv(struct EShaderReload* reload);
+
+// Development builds only, NULL when the sources can't be watched, the
+// shaders built in stay in use then.
+E_EXTERN struct EShaderReload* eCreateShaderReload(void) {
+    struct EShaderReload* reload =
+      eAlloc(sizeof(*reload), E_MEMORY_SCOPE_RENDERER);
+    if (!reload) {
+        return NULL;
+    }
+    *reload = (struct EShaderReload){ 0 };
+    if (!WatchSources(reload)) {
+        (void)fprintf(
+          stderr, "Can't watch %s, shaders won't reload\n", E_SHADER_DIR);
+        eFree(reload);
+        return NULL;
+    }
+#if E_VERBOSE_MESSAGING
+    (void)printf("Watching %s for shader changes\n", E_SHADER_DIR);
+#endif
+    return reload;
+}
+
+// Waits for running compilers, their output would be thrown away anyway.
+E_EXTERN void eDestroyShaderReload(struct EShaderReload* reload) {
+    if (!reload) {
+        return;
+    }
+#ifndef _WIN32
+    struct timespec pause = { .tv_nsec = 1000000 };
+#endif
+    for (uint32_t i = 0; i < E_SHADER_COUNT; ++i) {
+        int failed = { 0 };
+        while (reload->compilers[i] != E_NO_PROCESS
+               && !CompilerExited(reload->compilers[i], &failed)) {
+#ifdef _WIN32
+            Sleep(1);
+#else
+            (void)nanosleep(&pause, NULL);
+#endif
+        }
+    }
+#ifdef _WIN32
+    (void)FindCloseChangeNotification(reload->change);
+#else
+    (void)close(reload->inotify);
+#endif
+    FreeSpirv(reload);
+    eFree(reload);
+}
+
+// Called once a frame, never blocks. Returns the SPIR-V of every stage once
+// a compile started by a change finished without errors, valid until the
+// next call.
+E_EXTERN const struct EShaderCode*
+  ePollShaderReload(struct EShaderReload* reload, int bindless) {
+    if (!reload) {
+        return NULL;
+    }
+    if (SourcesChanged(reload)) {
+        reload->changed = 1;
+    }
+
+    if (reload->compiling) {
+        int running = { 0 };
+        for (uint32_t i = 0; i < E_SHADER_COUNT; ++i) {
+            if (reload->compilers[i] == E_NO_PROCESS) {
+                continue;
+            }
+            if (CompilerExited(reload->compilers[i], &reload->failed)) {
+                reload->compilers[i] = E_NO_PROCESS;
+            }
+            else {
+                running = 1;
+            }
+        }
+        if (running) {
+            return NULL;
+        }
+        reload->compiling = 0;
+        if (reload->failed) {
+            (void)fprintf(stderr,
+              "Shaders didn't compile, keeping the previous ones\n");
+            return NULL;
+        }
+        return ReadSpirv(reload) ? reload->code : NULL;
+    }
+
+    // the next change, or one made while compiling, starts a new run
+    if (reload->changed) {
+        reload->changed = 0;
+        reload->failed = 0;
+        reload->compiling = 1;
+        for (uint32_t i = 0; i < E_SHADER_COUNT; ++i) {
+            reload->compilers[i] = StartCompiler(i, bindless);
+            if (reload->compilers[i] == E_NO_PROCESS) {
+                reload->failed = 1;
+            }
+        }
+    }
+    return NULL;
+}
+
+static int WatchSources(struct EShaderReload* reload) {
+#ifdef _WIN32
+    reload->change = FindFirstChangeNotificationA(E_SHADER_DIR,
+      FALSE,
+      FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME);
+    return reload->change != INVALID_HANDLE_VALUE;
+#else
+    reload->inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (reload->inotify < 0) {
+        return 0;
+    }
+    // editors that save by renaming a temporary file only cause a move
+    if (inotify_add_watch(
+          reload->inotify, E_SHADER_DIR, IN_CLOSE_WRITE | IN_MOVED_TO)
+        < 0) {
+        (void)close(reload->inotify);
+        return 0;
+    }
+    return 1;
+#endif
+}
+
+static int SourcesChanged(struct EShaderReload* reload) {
+    int changed = { 0 };
+#ifdef _WIN32
+    while (WaitForSingleObject(reload->change, 0) == WAIT_OBJECT_0) {
+        changed = 1;
+        if (!FindNextChangeNotification(reload->change)) {
+            break;
+        }
+    }
+#else
+    _Alignas(struct inotify_event) char events[4096];
+    ssize_t size = { 0 };
+    while ((size = read(reload->inotify, events, sizeof(events))) > 0) {
+        for (char* at = events; at < events + size;) {
+            const struct inotify_event* event = (struct inotify_event*)at;
+            at += sizeof(*event) + event->len;
+            // swap and backup files of editors don't count
+            for (uint32_t i = 0; i < E_SHADER_COUNT && event->len; ++i) {
+                changed |= strcmp(event->name, sources[i]) == 0;
+            }
+        }
+    }
+#endif
+    return changed;
+}
+
+static EProcess StartCompiler(uint32_t stage, int bindless) {
+    char source[E_RELOAD_PATH_SIZE] = { 0 };
+    char output[E_RELOAD_PATH_SIZE] = { 0 };
+    (void)snprintf(
+      source, sizeof(source), "%s/%s", E_SHADER_DIR, sources[stage]);
+    OutputPath(stage, output, sizeof(output));
+    // the same variant meson.build compiles for the renderer's device
+    const char* define =
+      bindless && stage == E_SHADER_FRAG ? "-DE_BINDLESS" : NULL;
+
+#ifdef _WIN32
+    char command[3 * E_RELOAD_PATH_SIZE] = { 0 };
+    (void)snprintf(command,
+      sizeof(command),
+      "\"%s\" -V %s -o \"%s\" \"%s\"",
+      E_GLSLANG,
+      define ? define : "",
+      output,
+      source);
+    STARTUPINFOA si = { .cb = sizeof(si) };
+    PROCESS_INFORMATION pi = { 0 };
+    if (!CreateProcessA(
+          NULL, command, NULL, NULL, FALSE, 0, NULL, NULL, &si, &pi)) {
+        return E_NO_PROCESS;
+    }
+    (void)CloseHandle(pi.hThread);
+    return pi.hProcess;
+#else
+    char* argv[] = {
+        E_GLSLANG,
+        "-V",
+        "-o",
+        output,
+        source,
+        (char*)define,
+        NULL,
+    };
+    pid_t pid = { 0 };
+    if (posix_spawn(&pid, E_GLSLANG, NULL, NULL, argv, environ) != 0) {
+        return E_NO_PROCESS;
+    }
+    return pid;
+#endif
+}
+
+static int CompilerExited(EProcess process, int* failedOut) {
+#ifdef _WIN32
+    if (WaitForSingleObject(process, 0) != WAIT_OBJECT_0) {
+        return 0;
+    }
+    DWORD code = { 1 };
+    (void)GetExitCodeProcess(process, &code);
+    (void)CloseHandle(process);
+    if (code != 0) {
+        *failedOut = 1;
+    }
+    return 1;
+#else
+    int status = { 0 };
+    pid_t done = waitpid(process, &status, WNOHANG);
+    if (done == 0 || (done < 0 && errno == EINTR)) {
+        return 0;
+    }
+    if (done < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        *failedOut = 1;
+    }
+    return 1;
+#endif
+}
+
+static void OutputPath(uint32_t stage, char* pathOut, size_t size) {
+    (void)snprintf(
+      pathOut, size, "%s/%s.reload.spv", E_SHADER_BUILD_DIR, sources[stage]);
+}
+
+static int ReadSpirv(struct EShaderReload* reload) {
+    FreeSpirv(reload);
+    for (uint32_t i = 0; i < E_SHADER_COUNT; ++i) {
+        char path[E_RELOAD_PATH_SIZE] = { 0 };
+        OutputPath(i, path, sizeof(path));
+        uint32_t* spirv = { NULL };
+        long size = { 0 };
+        FILE* file = eOpenFile(path, "rb");
+        if (file) {
+            if (fseek(file, 0, SEEK_END) == 0 && (size = ftell(file)) > 0
+                && size % 4 == 0 && fseek(file, 0, SEEK_SET) == 0) {
+                spirv = eAlloc((size_t)size, E_MEMORY_SCOPE_RENDERER);
+            }
+            if (spirv
+                && fread(spirv, 1, (size_t)size, file) != (size_t)size) {
+                eFree(spirv);
+                spirv = NULL;
+            }
+            (void)fclose(file);
+        }
+        if (!spirv) {
+            (void)fprintf(stderr, "Can't read %s\n", path);
+            FreeSpirv(reload);
+            return 0;
+        }
+        reload->spirv[i] = spirv;
+        reload->code[i] = (struct EShaderCode){ spirv, (size_t)size };
+    }
+    return 1;
+}
+
+static void FreeSpirv(struct EShaderReload* reload) {
+    for (uint32_t i = 0; i < E_SHADER_COUNT; ++i) {
+        eFree(reload->spirv[i]);
+        reload->spirv[i] = NULL;
+        reload->code[i] = (struct EShaderCode){ 0 };
+    }
+}
+
+#endif
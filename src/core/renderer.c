@@ -1,19 +1,77 @@
 #include "renderer.h"
 
+#include "context.h"
 #include "core.h"
-#include "shaders/precompiled.h"
 
+// generated from shaders/ at build time, see meson.build
+#include "shader_cell_frag.spv.h"
+#include "shader_cell_vert.spv.h"
+#include "shader_frag.spv.h"
+#include "shader_frag_bindless.spv.h"
+#include "shader_vert.spv.h"
+
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
 
 
 static void CreateSampler(ERenderer renderer, EContext context);
 static void CreateDescriptorSetLayout(ERenderer renderer, EContext context);
 static void CreateDescriptorPool(ERenderer renderer, EContext context);
 static void CreatePipelineLayout(ERenderer renderer, EContext context);
+static void AllocateTextureSet(ERenderer renderer, EContext context);
+static void DescribeVertices(ERenderer renderer,
+  const struct EImguiVertData* vd);
+static void CreateShaderModules(ERenderer renderer,
+  EContext context,
+  const struct EShaderCode* code,
+  VkShaderModule* modulesOut);
 static void CreatePipeline(ERenderer renderer,
   EContext context,
-  ERendererCreateInfo* infoIn);
+  EDisplay display,
+  const VkShaderModule* shaders,
+  VkPipeline* pipelinesOut);
+static void CreateCellPipeline(ERenderer renderer,
+  EContext context,
+  EDisplay display,
+  const VkShaderModule* shaders,
+  VkPipeline* pipelinesOut);
+static void BuildPipeline(ERenderer renderer,
+  EContext context,
+  EDisplay display,
+  const VkPipelineShaderStageCreateInfo* stages,
+  const VkPipelineVertexInputStateCreateInfo* vertexInput,
+  VkPrimitiveTopology topology,
+  VkPipeline* pipelineOut);
+static void CommitFrameArena(ERenderer renderer,
+  EContext context,
+  struct ERenderFrame* frame);
+static void CreateTextureImage(ETexture texture, EContext context);
+static void CreateTextureView(ETexture texture, EContext context);
+static void AllocateTextureDescriptor(ETexture texture,
+  ERenderer renderer,
+  EContext context);
+static void
+  UploadTexture(ETexture texture, EContext context, const void* pixels);
+static VkImageLayout SampledLayout(ETexture texture);
+static VkFormat TextureFormat(ETexture texture);
+static uint32_t TexelSize(ETexture texture);
+static void UploadDrawData(ERenderer renderer,
+  EContext context,
+  struct ERenderFrame* frame);
+static void CollectRetiredTextures(ERenderer renderer,
+  EContext context,
+  uint64_t completed);
+static void CollectRetiredPipelines(ERenderer renderer,
+  EContext context,
+  uint64_t completed);
+static void EvictIdleTextures(ERenderer renderer, EContext context);
+#if E_ENABLE_SHADER_RELOAD
+static void
+  ReloadShaders(ERenderer renderer, EContext context, EDisplay display);
+#endif
 
 E_EXTERN void eCreateRenderer(ERenderer* rendererOut,
   ERendererCreateInfo* infoIn) {
@@ -22,7 +80,7 @@ E_EXTERN void eCreateRenderer(ERenderer* rendererOut,
     }
 
     EContext context = infoIn->context;
-    ERenderer renderer = malloc(sizeof(*context));
+    ERenderer renderer = eAlloc(sizeof(*renderer), E_MEMORY_SCOPE_RENDERER);
 
     if (!renderer) {
         *rendererOut = NULL;
@@ -30,144 +88,1533 @@ E_EXTERN void eCreateRenderer(ERenderer* rendererOut,
     }
     *rendererOut = renderer;
     *renderer = (struct ERenderer_t){ 0 };
+    renderer->vertSize = infoIn->imguiVertData.inputAttrSize;
+    renderer->indexSize = infoIn->imguiVertData.indexSize;
+    renderer->residencyFraction = infoIn->residencyFraction > 0.f
+                                    ? infoIn->residencyFraction
+                                    : E_DEFAULT_RESIDENCY_FRACTION;
+    eSetRecordThreads(renderer, infoIn->recordThreads);
 
     CreateSampler(renderer, context);
     CreateDescriptorSetLayout(renderer, context);
     CreateDescriptorPool(renderer, context);
+    AllocateTextureSet(renderer, context);
     CreatePipelineLayout(renderer, context);
-    CreatePipeline(renderer, context, infoIn);
+    DescribeVertices(renderer, &infoIn->imguiVertData);
+
+    struct EShaderCode code[E_SHADER_COUNT] = {
+        [E_SHADER_VERT] = {
+            __glsl_shader_vert_spv,
+            sizeof(__glsl_shader_vert_spv),
+        },
+        [E_SHADER_FRAG] = {
+            __glsl_shader_frag_spv,
+            sizeof(__glsl_shader_frag_spv),
+        },
+        [E_SHADER_CELL_VERT] = {
+            __glsl_shader_cell_vert_spv,
+            sizeof(__glsl_shader_cell_vert_spv),
+        },
+        [E_SHADER_CELL_FRAG] = {
+            __glsl_shader_cell_frag_spv,
+            sizeof(__glsl_shader_cell_frag_spv),
+        },
+    };
+    if (context->descriptorIndexing) {
+        code[E_SHADER_FRAG] = (struct EShaderCode){
+            __glsl_shader_frag_bindless_spv,
+            sizeof(__glsl_shader_frag_bindless_spv),
+        };
+    }
+    CreateShaderModules(renderer, context, code, renderer->shaders);
+    uint64_t start = { eNowNanoseconds() };
+    CreatePipeline(renderer,
+      context,
+      infoIn->display,
+      renderer->shaders,
+      renderer->pipelines);
+    CreateCellPipeline(renderer,
+      context,
+      infoIn->display,
+      renderer->shaders,
+      renderer->pipelines);
+    renderer->stats.pipelineCreateNanoseconds = eNowNanoseconds() - start;
+#if E_ENABLE_SHADER_RELOAD
+    if (renderer->result == E_SUCCESS) {
+        renderer->reload = eCreateShaderReload();
+    }
+#endif
+
+    if (renderer->result == E_SUCCESS) {
+        infoIn->display->renderer = renderer;
+    }
 }
 
 E_EXTERN void eDestroyRenderer(ERenderer renderer, EContext context) {
-    vkDestroyPipeline(context->device, renderer->pipeline, NULL);
-    vkDestroyShaderModule(context->device, renderer->fragShader, NULL);
-    vkDestroyShaderModule(context->device, renderer->vertShader, NULL);
-    vkDestroyPipelineLayout(context->device, renderer->pipelineLayout, NULL);
-    vkDestroyDescriptorPool(context->device, renderer->descPool, NULL);
+    eDestroyWorkerPool(&renderer->workers);
+    while (renderer->retiredTextureCount--) {
+        eDestroyTexture(
+          renderer->retiredTextures[renderer->retiredTextureCount].texture,
+          renderer,
+          context);
+    }
+    for (uint32_t i = 0; i < E_MAX_FRAMES; ++i) {
+        struct ERenderFrame* frame = &renderer->frames[i];
+        eDestroyStreamBuffer(context, &frame->arena.stream);
+        // frees the secondaries along with them
+        while (frame->poolCount--) {
+            vkDestroyCommandPool(context->device,
+              frame->pools[frame->poolCount],
+              context->vkAllocator);
+        }
+    }
+#if E_ENABLE_SHADER_RELOAD
+    eDestroyShaderReload(renderer->reload);
+#endif
+    CollectRetiredPipelines(renderer, context, UINT64_MAX);
+    for (uint32_t i = 0; i < E_PIPELINE_COUNT; ++i) {
+        vkDestroyPipeline(
+          context->device, renderer->pipelines[i], context->vkAllocator);
+    }
+    for (uint32_t i = 0; i < E_SHADER_COUNT; ++i) {
+        vkDestroyShaderModule(
+          context->device, renderer->shaders[i], context->vkAllocator);
+    }
+    vkDestroyPipelineLayout(
+      context->device, renderer->pipelineLayout, context->vkAllocator);
+    vkDestroyDescriptorPool(
+      context->device, renderer->descPool, context->vkAllocator);
     vkDestroyDescriptorSetLayout(
-      context->device, renderer->descSetLayout, NULL);
-    vkDestroySampler(context->device, renderer->sampler, NULL);
-    free(renderer);
+      context->device, renderer->descSetLayout, context->vkAllocator);
+    vkDestroySampler(context->device, renderer->sampler, context->vkAllocator);
+    eFree(renderer->batches);
+    eFree(renderer->retiredTextures);
+    eFree(renderer);
 }
 
-E_EXTERN void eDestroyTexture(ERenderer renderer, EContext context);
-E_EXTERN void eCreateTexture(ERenderer renderer, EContext context) {
-    if (renderer->result != E_SUCCESS) {
+E_EXTERN void eSetDrawData(ERenderer renderer, const EDrawData* drawData) {
+    renderer->drawData = drawData;
+}
+
+E_EXTERN void eGetRendererStats(ERenderer renderer, ERendererStats* statsOut) {
+    if (!renderer || !statsOut) {
         return;
     }
+    *statsOut = renderer->stats;
+}
+
+static uint64_t HashBytes(uint64_t hash, const void* data, size_t size) {
+    const unsigned char* bytes = data;
+    uint64_t word = { 0 };
+    // word at a time, draw data of big sheets is several megabytes per frame
+    while (size >= sizeof(word)) {
+        memcpy(&word, bytes, sizeof(word));
+        hash = (hash ^ word) * 0x100000001B3ull;
+        hash ^= hash >> 29;
+        bytes += sizeof(word);
+        size -= sizeof(word);
+    }
+    while (size--) {
+        hash = (hash ^ *bytes++) * 0x100000001B3ull;
+    }
+    return hash;
+}
+
+// Cheap fingerprint of everything the current draw data would render.
+E_EXTERN uint64_t eHashDrawData(ERenderer renderer) {
+    const EDrawData* dd = renderer->drawData;
+    uint64_t hash = { 0xCBF29CE484222325ull };
+    if (!dd) {
+        return hash;
+    }
+    hash = HashBytes(hash, dd->displayPos, sizeof(dd->displayPos));
+    hash = HashBytes(hash, dd->displaySize, sizeof(dd->displaySize));
+    hash = HashBytes(hash, dd->framebufferScale, sizeof(dd->framebufferScale));
+    for (uint32_t i = 0; i < dd->listCount; ++i) {
+        const struct EDrawList* list = &dd->lists[i];
+        // trailing padding of EDrawCmd isn't guaranteed to be zeroed
+        for (uint32_t j = 0; j < list->cmdCount; ++j) {
+            const struct EDrawCmd* dc = &list->cmds[j];
+            hash = HashBytes(hash,
+              dc,
+              offsetof(struct EDrawCmd, cellCount) + sizeof(uint32_t));
+            hash = HashBytes(
+              hash, dc->cells, sizeof(*dc->cells) * dc->cellCount);
+        }
+        hash = HashBytes(
+          hash, list->vtxData, (size_t)list->vtxCount * renderer->vertSize);
+        hash = HashBytes(
+          hash, list->idxData, (size_t)list->idxCount * renderer->indexSize);
+    }
+    return hash;
+}
+
+static int FramebufferSize(const EDrawData* dd, int* widthOut, int* heightOut) {
+    *widthOut = (int)(dd->displaySize[0] * dd->framebufferScale[0]);
+    *heightOut = (int)(dd->displaySize[1] * dd->framebufferScale[1]);
+    return *widthOut > 0 && *heightOut > 0;
+}
+
+// Cells draw from their own pipeline and instance buffer, the texture
+// variants only specialize the fragment shader differently. Push constants
+// and descriptor sets stay bound across the switch, all pipelines share a
+// layout.
+static void BindPipeline(ERenderer renderer,
+  VkCommandBuffer cmd,
+  struct ERenderFrame* frame,
+  enum EPipelineKind kind) {
+    VkDeviceSize offset = {
+        kind == E_PIPELINE_CELLS ? frame->cellOffset : frame->vertexOffset
+    };
+    vkCmdBindPipeline(
+      cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, renderer->pipelines[kind]);
+    vkCmdBindVertexBuffers(cmd, 0, 1, &frame->arena.stream.buffer, &offset);
+}
+
+// state every command buffer drawing the draw data starts with
+static void BindDrawState(ERenderer renderer,
+  VkCommandBuffer cmd,
+  struct ERenderFrame* frame,
+  int fbWidth,
+  int fbHeight) {
+    const EDrawData* dd = renderer->drawData;
+
+    BindPipeline(renderer, cmd, frame, E_PIPELINE_IMGUI);
+    vkCmdBindIndexBuffer(cmd,
+      frame->arena.stream.buffer,
+      frame->indexOffset,
+      renderer->indexSize == 2 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32);
+
+    VkViewport viewport = {
+        .width = (float)fbWidth,
+        .height = (float)fbHeight,
+        .minDepth = 0.f,
+        .maxDepth = 1.f,
+    };
+    vkCmdSetViewport(cmd, 0, 1, &viewport);
+
+    // scale, translate
+    float pc[4] = { 0 };
+    pc[0] = 2.f / dd->displaySize[0];
+    pc[1] = 2.f / dd->displaySize[1];
+    pc[2] = -1.f - dd->displayPos[0] * pc[0];
+    pc[3] = -1.f - dd->displayPos[1] * pc[1];
+    vkCmdPushConstants(cmd,
+      renderer->pipelineLayout,
+      VK_SHADER_STAGE_VERTEX_BIT,
+      0,
+      sizeof(pc),
+      pc);
+
+    // with descriptor indexing textures are picked by a push constant
+    if (renderer->textureSet) {
+        vkCmdBindDescriptorSets(cmd,
+          VK_PIPELINE_BIND_POINT_GRAPHICS,
+          renderer->pipelineLayout,
+          0,
+          1,
+          &renderer->textureSet,
+          0,
+          NULL);
+    }
+}
+
+static void
+  BindTexture(ERenderer renderer, VkCommandBuffer cmd, ETexture texture) {
+    if (renderer->textureSet) {
+        vkCmdPushConstants(cmd,
+          renderer->pipelineLayout,
+          VK_SHADER_STAGE_FRAGMENT_BIT,
+          sizeof(float) * 4,
+          sizeof(texture->id),
+          &texture->id);
+        return;
+    }
+    vkCmdBindDescriptorSets(cmd,
+      VK_PIPELINE_BIND_POINT_GRAPHICS,
+      renderer->pipelineLayout,
+      0,
+      1,
+      &texture->descriptorSet,
+      0,
+      NULL);
+}
+
+// Appends batch to last if both draw the same way over adjacent indices or
+// adjacent cells.
+static int MergeBatch(struct EBatch* last, const struct EBatch* batch) {
+    if (last->list != batch->list
+        || memcmp(&last->scissor, &batch->scissor, sizeof(VkRect2D)) != 0) {
+        return 0;
+    }
+    if (last->cellCount && batch->cellCount) {
+        if (last->firstCell + last->cellCount != batch->firstCell) {
+            return 0;
+        }
+        last->cellCount += batch->cellCount;
+        return 1;
+    }
+    if (last->cellCount || batch->cellCount || last->texture != batch->texture
+        || last->vertexOffset != batch->vertexOffset
+        || last->firstIndex + last->indexCount != batch->firstIndex) {
+        return 0;
+    }
+    last->indexCount += batch->indexCount;
+    return 1;
+}
+
+// Turns the draw data into batches: commands clipped away entirely or using
+// textures that aren't drawable yet are dropped, and runs of commands with
+// the same scissor and texture over adjacent indices become one draw, as do
+// runs of cell commands.
+static void BuildBatches(ERenderer renderer, int fbWidth, int fbHeight) {
+    const EDrawData* dd = renderer->drawData;
+    renderer->batchCount = 0;
+
+    uint32_t cmdCount = { 0 };
+    for (uint32_t i = 0; i < dd->listCount; ++i) {
+        cmdCount += dd->lists[i].cmdCount;
+    }
+    renderer->stats.frameDrawCmds = cmdCount;
+    // at most one batch per command
+    if (cmdCount > renderer->batchCapacity) {
+        uint32_t capacity = renderer->batchCapacity * 2;
+        capacity = capacity < cmdCount ? cmdCount : capacity;
+        struct EBatch* batches = eRealloc(renderer->batches,
+          sizeof(*batches) * capacity,
+          E_MEMORY_SCOPE_RENDERER);
+        if (!batches) {
+            renderer->result = E_MALLOC_FAILURE;
+            return;
+        }
+        renderer->batches = batches;
+        renderer->batchCapacity = capacity;
+    }
+
+    struct EBatch* last = { NULL };
+    uint32_t globalVtxOffset = { 0 };
+    uint32_t globalIdxOffset = { 0 };
+    uint32_t globalCellOffset = { 0 };
+    for (uint32_t i = 0; i < dd->listCount; ++i) {
+        const struct EDrawList* list = &dd->lists[i];
+        for (uint32_t j = 0; j < list->cmdCount; ++j) {
+            const struct EDrawCmd* dc = &list->cmds[j];
+            uint32_t firstCell = { globalCellOffset };
+            globalCellOffset += dc->cellCount;
+            if (dc->elemCount == 0 && dc->cellCount == 0) {
+                continue;
+            }
+
+            // project clip rect into framebuffer space
+            float minX = (dc->clipRect[0] - dd->displayPos[0])
+                         * dd->framebufferScale[0];
+            float minY = (dc->clipRect[1] - dd->displayPos[1])
+                         * dd->framebufferScale[1];
+            float maxX = (dc->clipRect[2] - dd->displayPos[0])
+                         * dd->framebufferScale[0];
+            float maxY = (dc->clipRect[3] - dd->displayPos[1])
+                         * dd->framebufferScale[1];
+            minX = minX < 0.f ? 0.f : minX;
+            minY = minY < 0.f ? 0.f : minY;
+            maxX = maxX > (float)fbWidth ? (float)fbWidth : maxX;
+            maxY = maxY > (float)fbHeight ? (float)fbHeight : maxY;
+            if (maxX <= minX || maxY <= minY) {
+                continue;
+            }
+            ETexture texture = dc->textureId < E_MAX_TEXTURES
+                                 ? renderer->textures[dc->textureId]
+                                 : NULL;
+            if (dc->textureId && (!texture || !eTextureIsReady(texture))) {
+                continue;
+            }
+            if (texture) {
+                texture->lastDrawn = renderer->frameCount;
+            }
+
+            struct EBatch batch = {
+                .scissor = {
+                    .offset = { (int32_t)minX, (int32_t)minY },
+                    .extent = {
+                        (uint32_t)(maxX - minX),
+                        (uint32_t)(maxY - minY),
+                    },
+                },
+                .texture = texture,
+                .list = i,
+                .firstIndex = dc->idxOffset + globalIdxOffset,
+                .vertexOffset = (int32_t)(dc->vtxOffset + globalVtxOffset),
+                .indexCount = dc->elemCount,
+                .firstCell = firstCell,
+                .cellCount = dc->cellCount,
+            };
+            if (last && MergeBatch(last, &batch)) {
+                continue;
+            }
+            last = &renderer->batches[renderer->batchCount++];
+            *last = batch;
+        }
+        globalVtxOffset += list->vtxCount;
+        globalIdxOffset += list->idxCount;
+    }
+}
+
+// state changes and draws one command buffer recorded
+struct ERecordCounts {
+    uint32_t draws;
+    uint32_t scissorSets;
+    uint32_t textureBinds;
+};
+
+// Records the batches in [first, end). The first batch of every list writes
+// the list's start timestamp to queries, so each is written exactly once no
+// matter how the batches are split across recording threads.
+static void RecordBatches(ERenderer renderer,
+  VkCommandBuffer cmd,
+  struct ERenderFrame* frame,
+  VkQueryPool queries,
+  uint32_t first,
+  uint32_t end,
+  struct ERecordCounts* countsOut) {
+    struct ERecordCounts counts = { 0 };
+    const VkRect2D* scissor = { NULL };
+    ETexture bound = { NULL };
+    // BindDrawState starts out with the imgui pipeline
+    enum EPipelineKind bindKind = { E_PIPELINE_IMGUI };
+
+    for (uint32_t i = first; i < end; ++i) {
+        const struct EBatch* batch = &renderer->batches[i];
+        int listStart = i == 0 || renderer->batches[i - 1].list != batch->list;
+        if (queries && listStart && batch->list < E_MAX_TIMED_DRAW_LISTS) {
+            vkCmdWriteTimestamp(cmd,
+              VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+              queries,
+              1 + batch->list);
+        }
+        if (!scissor
+            || memcmp(scissor, &batch->scissor, sizeof(VkRect2D)) != 0) {
+            vkCmdSetScissor(cmd, 0, 1, &batch->scissor);
+            scissor = &batch->scissor;
+            counts.scissorSets++;
+        }
+        if (batch->texture && batch->texture != bound) {
+            BindTexture(renderer, cmd, batch->texture);
+            bound = batch->texture;
+            counts.textureBinds++;
+        }
+        // geometry follows the texture it samples, NULL ones keep it bound
+        enum EPipelineKind kind = { E_PIPELINE_IMGUI };
+        if (batch->cellCount) {
+            kind = E_PIPELINE_CELLS;
+        }
+        else if (bound) {
+            kind = (bound->alphaOnly ? E_PIPELINE_ALPHA : 0)
+                   | (bound->distanceField ? E_PIPELINE_SDF : 0);
+        }
+        if (kind != bindKind) {
+            bindKind = kind;
+            BindPipeline(renderer, cmd, frame, kind);
+        }
+        if (kind == E_PIPELINE_CELLS) {
+            vkCmdDraw(cmd, 4, batch->cellCount, 0, batch->firstCell);
+        }
+        else {
+            vkCmdDrawIndexed(cmd,
+              batch->indexCount,
+              1,
+              batch->firstIndex,
+              batch->vertexOffset,
+              0);
+        }
+        counts.draws++;
+    }
+    *countsOut = counts;
+}
+
+static void AddRecordCounts(ERenderer renderer,
+  const struct ERecordCounts* counts) {
+    renderer->stats.frameDraws += counts->draws;
+    renderer->stats.frameScissorSets += counts->scissorSets;
+    renderer->stats.frameTextureBinds += counts->textureBinds;
+}
+
+// one frame's draw data split across the recording threads
+struct ERecordTask {
+    ERenderer renderer;
+    VkDevice device;
+    struct ERenderFrame* frame;
+    VkQueryPool queries;
+    const VkCommandBufferInheritanceInfo* inheritance;
+    int fbWidth;
+    int fbHeight;
+    uint32_t firstBatch[E_MAX_RECORD_THREADS + 1];
+    VkResult results[E_MAX_RECORD_THREADS];
+    struct ERecordCounts counts[E_MAX_RECORD_THREADS];
+};
+
+static void RecordSecondary(void* arg, uint32_t index) {
+    struct ERecordTask* task = arg;
+    VkCommandBuffer cmd = task->frame->secondaries[index];
+
+    VkResult err =
+      vkResetCommandPool(task->device, task->frame->pools[index], 0);
+    VkCommandBufferBeginInfo cbbi = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
+                 | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT,
+        .pInheritanceInfo = task->inheritance,
+    };
+    if (err == VK_SUCCESS) {
+        err = vkBeginCommandBuffer(cmd, &cbbi);
+    }
+    if (err == VK_SUCCESS) {
+        // secondaries inherit no state, each binds everything itself
+        BindDrawState(
+          task->renderer, cmd, task->frame, task->fbWidth, task->fbHeight);
+        RecordBatches(task->renderer,
+          cmd,
+          task->frame,
+          task->queries,
+          task->firstBatch[index],
+          task->firstBatch[index + 1],
+          &task->counts[index]);
+        err = vkEndCommandBuffer(cmd);
+    }
+    task->results[index] = err;
+}
+
+static void ReserveSecondaries(ERenderer renderer,
+  EContext context,
+  struct ERenderFrame* frame,
+  uint32_t count) {
     VkResult err = { 0 };
 
-    if (renderer->texture->descriptorSet) {
-        vkQueueWaitIdle(context->queue);
-        eDestroyTexture(renderer, context);
+    while (frame->poolCount < count) {
+        uint32_t i = { frame->poolCount };
+        VkCommandPoolCreateInfo cpci = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+            .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+            .queueFamilyIndex = context->graphicsQueueFamilyIndex,
+        };
+        err = vkCreateCommandPool(
+          context->device, &cpci, context->vkAllocator, &frame->pools[i]);
+        if (err != VK_SUCCESS) {
+            renderer->result = E_CREATE_COMMAND_POOL_FAILURE;
+            return;
+        }
+        frame->poolCount++;
+
+        VkCommandBufferAllocateInfo cbai = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+            .commandBufferCount = 1,
+            .commandPool = frame->pools[i],
+            .level = VK_COMMAND_BUFFER_LEVEL_SECONDARY,
+        };
+        err = vkAllocateCommandBuffers(
+          context->device, &cbai, &frame->secondaries[i]);
+        if (err != VK_SUCCESS) {
+            renderer->result = E_CREATE_COMMAND_BUFFER_FAILURE;
+            return;
+        }
     }
 }
 
+// Splits the batches evenly across the worker threads, each records its run
+// into a secondary command buffer of its own.
+static void RecordSecondaries(ERenderer renderer,
+  EContext context,
+  EDisplay display,
+  struct ERenderFrame* frame) {
+    if (renderer->workers.count != renderer->recordThreads) {
+        eDestroyWorkerPool(&renderer->workers);
+        if (eCreateWorkerPool(&renderer->workers, renderer->recordThreads)
+            != E_SUCCESS) {
+            // not fatal, the frame gets recorded inline instead
+            renderer->recordThreads = 1;
+            return;
+        }
+    }
+    uint32_t threads = { renderer->workers.count };
+    ReserveSecondaries(renderer, context, frame, threads);
+    if (renderer->result != E_SUCCESS) {
+        return;
+    }
+    uint64_t start = { eNowNanoseconds() };
 
-static void CreatePipeline(ERenderer renderer,
+    VkCommandBufferInheritanceRenderingInfo cbiri = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO,
+        .colorAttachmentCount = 1,
+        .pColorAttachmentFormats = &display->surfaceFormat.format,
+        .rasterizationSamples = VK_SAMPLE_COUNT_1_BIT,
+    };
+    VkCommandBufferInheritanceInfo cbii = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+        .pNext = context->dynamicRendering ? &cbiri : NULL,
+        .renderPass = display->renderPass,
+        .subpass = 0,
+    };
+    struct ERecordTask task = {
+        .renderer = renderer,
+        .device = context->device,
+        .frame = frame,
+        .queries = display->frames[display->frameIndex].queryPool,
+        .inheritance = &cbii,
+    };
+    (void)FramebufferSize(renderer->drawData, &task.fbWidth, &task.fbHeight);
+    for (uint32_t i = 0; i <= threads; ++i) {
+        task.firstBatch[i] =
+          (uint32_t)((uint64_t)renderer->batchCount * i / threads);
+    }
+
+    eRunWorkers(&renderer->workers, RecordSecondary, &task);
+
+    for (uint32_t i = 0; i < threads; ++i) {
+        if (task.results[i] != VK_SUCCESS) {
+            renderer->result = E_FRAME_RENDER_ERROR;
+            return;
+        }
+        AddRecordCounts(renderer, &task.counts[i]);
+    }
+    frame->secondaryCount = threads;
+    renderer->stats.frameRecordNanoseconds = eNowNanoseconds() - start;
+    renderer->stats.frameRecordThreads = threads;
+}
+
+// Uploads the current draw data for the display's current frame, after the
+// frame's last submit was waited on, as it overwrites that frame's stream
+// buffers. Big draw data is recorded into secondary command buffers right
+// away, the pass then has to be begun for secondary contents, which is what
+// a nonzero return means.
+E_EXTERN int
+  ePrepareDrawData(ERenderer renderer, EContext context, EDisplay display) {
+    if (renderer->result != E_SUCCESS) {
+        return 0;
+    }
+    renderer->frameCount++;
+    CollectRetiredTextures(
+      renderer, context, context->graphicsTimeline.completed);
+    CollectRetiredPipelines(
+      renderer, context, context->graphicsTimeline.completed);
+#if E_ENABLE_SHADER_RELOAD
+    ReloadShaders(renderer, context, display);
+#endif
+    const EDrawData* dd = renderer->drawData;
+    struct ERenderFrame* frame = &renderer->frames[display->frameIndex];
+    frame->prepared = 0;
+    frame->secondaryCount = 0;
+    renderer->stats.frameBytesUploaded = 0;
+    renderer->stats.frameRecordNanoseconds = 0;
+    renderer->stats.frameRecordThreads = 0;
+    renderer->stats.frameDrawCmds = 0;
+    renderer->stats.frameDraws = 0;
+    renderer->stats.frameScissorSets = 0;
+    renderer->stats.frameTextureBinds = 0;
+    if (!dd || dd->totalVtxCount == 0 || dd->totalIdxCount == 0) {
+        return 0;
+    }
+    int fbWidth = { 0 };
+    int fbHeight = { 0 };
+    if (!FramebufferSize(dd, &fbWidth, &fbHeight)) {
+        return 0;
+    }
+
+    UploadDrawData(renderer, context, frame);
+    if (renderer->result != E_SUCCESS) {
+        return 0;
+    }
+    BuildBatches(renderer, fbWidth, fbHeight);
+    if (renderer->result != E_SUCCESS) {
+        return 0;
+    }
+    // after the batches, so nothing this frame draws counts as idle
+    EvictIdleTextures(renderer, context);
+    frame->prepared = 1;
+
+    if (renderer->recordThreads > 1
+        && renderer->batchCount >= E_PARALLEL_RECORD_MIN_BATCHES) {
+        RecordSecondaries(renderer, context, display, frame);
+    }
+    return frame->secondaryCount > 0;
+}
+
+// Records the prepared draw data into the command buffer of the display's
+// current frame. Has to be called inside of the pass, begun for secondary
+// contents if ePrepareDrawData said so.
+E_EXTERN void
+  eRecordDrawData(ERenderer renderer, EContext context, EDisplay display) {
+    (void)context;
+    if (renderer->result != E_SUCCESS) {
+        return;
+    }
+    struct ERenderFrame* frame = &renderer->frames[display->frameIndex];
+    if (!frame->prepared) {
+        return;
+    }
+    struct EFrame* curF = &display->frames[display->frameIndex];
+    VkCommandBuffer cmd = curF->commandBuffer;
+
+    if (frame->secondaryCount) {
+        vkCmdExecuteCommands(cmd, frame->secondaryCount, frame->secondaries);
+        return;
+    }
+
+    uint64_t start = { eNowNanoseconds() };
+    int fbWidth = { 0 };
+    int fbHeight = { 0 };
+    (void)FramebufferSize(renderer->drawData, &fbWidth, &fbHeight);
+    BindDrawState(renderer, cmd, frame, fbWidth, fbHeight);
+    struct ERecordCounts counts = { 0 };
+    RecordBatches(renderer,
+      cmd,
+      frame,
+      curF->queryPool,
+      0,
+      renderer->batchCount,
+      &counts);
+    AddRecordCounts(renderer, &counts);
+    renderer->stats.frameRecordNanoseconds = eNowNanoseconds() - start;
+    renderer->stats.frameRecordThreads = 1;
+}
+
+// 0 picks one thread per core. Takes effect with the next big frame.
+E_EXTERN void eSetRecordThreads(ERenderer renderer, uint32_t count) {
+    if (count == 0) {
+        count = eGetCpuCount();
+    }
+    count = count > E_MAX_RECORD_THREADS ? E_MAX_RECORD_THREADS : count;
+    renderer->recordThreads = count;
+}
+
+static void UploadDrawData(ERenderer renderer,
   EContext context,
-  ERendererCreateInfo* infoIn) {
+  struct ERenderFrame* frame) {
+    const EDrawData* dd = renderer->drawData;
+
+    VkDeviceSize vertBytes =
+      (VkDeviceSize)dd->totalVtxCount * renderer->vertSize;
+    VkDeviceSize idxBytes =
+      (VkDeviceSize)dd->totalIdxCount * renderer->indexSize;
+    VkDeviceSize cellBytes =
+      (VkDeviceSize)dd->totalCellCount * sizeof(ECellRect);
+    // the frame's fences guarantee the GPU is done with the arena
+    eResetArena(&frame->arena);
+    frame->vertexOffset = eArenaPush(&frame->arena, vertBytes, 16);
+    frame->indexOffset = eArenaPush(&frame->arena, idxBytes, 16);
+    frame->cellOffset = eArenaPush(&frame->arena, cellBytes, 16);
+    CommitFrameArena(renderer, context, frame);
+    if (renderer->result != E_SUCCESS) {
+        return;
+    }
+
+    // memory is host coherent, one copy per draw list and stream is enough
+    char* base = frame->arena.stream.mapped;
+    char* vertDst = base + frame->vertexOffset;
+    char* idxDst = base + frame->indexOffset;
+    ECellRect* cellDst = (ECellRect*)(base + frame->cellOffset);
+    for (uint32_t i = 0; i < dd->listCount; ++i) {
+        const struct EDrawList* list = &dd->lists[i];
+        size_t vertSize = (size_t)list->vtxCount * renderer->vertSize;
+        size_t idxSize = (size_t)list->idxCount * renderer->indexSize;
+        memcpy(vertDst, list->vtxData, vertSize);
+        memcpy(idxDst, list->idxData, idxSize);
+        vertDst += vertSize;
+        idxDst += idxSize;
+        // cells are few commands with many instances each
+        for (uint32_t j = 0; j < list->cmdCount; ++j) {
+            const struct EDrawCmd* dc = &list->cmds[j];
+            if (dc->cellCount) {
+                memcpy(cellDst, dc->cells, sizeof(*cellDst) * dc->cellCount);
+                cellDst += dc->cellCount;
+            }
+        }
+    }
+    renderer->stats.frameBytesUploaded = vertBytes + idxBytes + cellBytes;
+    renderer->stats.bytesUploaded += vertBytes + idxBytes + cellBytes;
+}
+
+static void CommitFrameArena(ERenderer renderer,
+  EContext context,
+  struct ERenderFrame* frame) {
     if (renderer->result != E_SUCCESS) {
         return;
     }
+    VkDeviceSize oldSize = { frame->arena.stream.size };
+    renderer->result = eCommitArena(context,
+      &frame->arena,
+      VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+    if (frame->arena.stream.size != oldSize) {
+        renderer->stats.bufferReallocations++;
+    }
+}
+
+// Creates the texture and queues its upload on the transfer queue without
+// waiting for it. The texture is skipped while drawing until eUpdateUploads
+// sees the upload finished.
+E_EXTERN void eCreateTexture(ETexture* textureOut,
+  ERenderer renderer,
+  EContext context,
+  ETextureCreateInfo* infoIn) {
+    if (!textureOut || !renderer || !context) {
+        return;
+    }
+    ETexture texture = eAlloc(sizeof(*texture), E_MEMORY_SCOPE_TEXTURE);
+    if (!texture) {
+        *textureOut = NULL;
+        return;
+    }
+    *textureOut = texture;
+    *texture = (struct ETexture_t){ 0 };
+    if (!infoIn) {
+        texture->result = E_CREATE_INFO_MISSING;
+        return;
+    }
+    if ((!infoIn->pixels && !infoIn->dynamic) || !infoIn->width
+        || !infoIn->height) {
+        texture->result = E_CREATE_INFO_MISSING_VALUE;
+        return;
+    }
+    texture->width = infoIn->width;
+    texture->height = infoIn->height;
+    texture->alphaOnly = infoIn->alphaOnly;
+    texture->distanceField = infoIn->distanceField;
+    texture->dynamic = infoIn->dynamic;
+    texture->lastDrawn = renderer->frameCount;
+    texture->evict = infoIn->evict;
+    texture->evictUserData = infoIn->evictUserData;
+
+    CreateTextureImage(texture, context);
+    CreateTextureView(texture, context);
+    AllocateTextureDescriptor(texture, renderer, context);
+    UploadTexture(texture, context, infoIn->pixels);
+}
+
+// The texture must not be used by any frame still in flight.
+E_EXTERN void
+  eDestroyTexture(ETexture texture, ERenderer renderer, EContext context) {
+    if (!texture) {
+        return;
+    }
+    eWaitForUpload(context, texture);
+    if (texture->id) {
+        renderer->textures[texture->id] = NULL;
+    }
+    if (texture->descriptorSet) {
+        (void)vkFreeDescriptorSets(
+          context->device, renderer->descPool, 1, &texture->descriptorSet);
+    }
+    vkDestroyImageView(
+      context->device, texture->imageView, context->vkAllocator);
+    vkDestroyImage(context->device, texture->image, context->vkAllocator);
+    eFreeMemory(context, &texture->allocation);
+    eFree(texture);
+}
+
+// Destroys the texture once every frame submitted so far finished, for
+// textures replaced while still drawn.
+E_EXTERN void
+  eRetireTexture(ETexture texture, ERenderer renderer, EContext context) {
+    if (!texture) {
+        return;
+    }
+    texture->evict = NULL;
+    if (renderer->retiredTextureCount == renderer->retiredTextureCapacity) {
+        uint32_t capacity = renderer->retiredTextureCapacity
+                              ? renderer->retiredTextureCapacity * 2
+                              : 16;
+        struct ERetiredTexture* retired = eRealloc(renderer->retiredTextures,
+          sizeof(*retired) * capacity,
+          E_MEMORY_SCOPE_RENDERER);
+        if (!retired) {
+            // leaked rather than destroyed under a frame that may sample it
+            renderer->result = E_MALLOC_FAILURE;
+            return;
+        }
+        renderer->retiredTextures = retired;
+        renderer->retiredTextureCapacity = capacity;
+    }
+    renderer->retiredTextures[renderer->retiredTextureCount++] =
+      (struct ERetiredTexture){
+          .texture = texture,
+          .serial = context->graphicsTimeline.submitted,
+      };
+}
+
+static void CollectRetiredTextures(ERenderer renderer,
+  EContext context,
+  uint64_t completed) {
+    uint32_t kept = { 0 };
+    for (uint32_t i = 0; i < renderer->retiredTextureCount; ++i) {
+        struct ERetiredTexture* ret = &renderer->retiredTextures[i];
+        if (ret->serial <= completed) {
+            eDestroyTexture(ret->texture, renderer, context);
+        }
+        else {
+            renderer->retiredTextures[kept++] = *ret;
+        }
+    }
+    renderer->retiredTextureCount = kept;
+}
+
+static void CollectRetiredPipelines(ERenderer renderer,
+  EContext context,
+  uint64_t completed) {
+    uint32_t kept = { 0 };
+    for (uint32_t i = 0; i < renderer->retiredPipelineCount; ++i) {
+        struct ERetiredPipelines* ret = &renderer->retiredPipelines[i];
+        if (ret->serial <= completed) {
+            for (uint32_t j = 0; j < E_PIPELINE_COUNT; ++j) {
+                vkDestroyPipeline(
+                  context->device, ret->pipelines[j], context->vkAllocator);
+            }
+        }
+        else {
+            renderer->retiredPipelines[kept++] = *ret;
+        }
+    }
+    renderer->retiredPipelineCount = kept;
+}
+
+// Checks the memory budget every E_RESIDENCY_INTERVAL frames. Past the
+// renderer's fraction of it, evictable textures idle for
+// E_RESIDENCY_IDLE_FRAMES are handed back to their owners, least recently
+// drawn first, until usage is below it again. Retired textures count as
+// freed, the frames in flight release them soon.
+static void EvictIdleTextures(ERenderer renderer, EContext context) {
+    if (renderer->frameCount % E_RESIDENCY_INTERVAL != 0) {
+        return;
+    }
+    EMemoryBudget budget = { 0 };
+    eGetMemoryBudget(context, &budget);
+    uint64_t limit =
+      (uint64_t)((double)budget.budget * renderer->residencyFraction);
+    uint64_t usage = { budget.usage };
+    for (uint32_t i = 0; i < renderer->retiredTextureCount; ++i) {
+        ETexture texture = renderer->retiredTextures[i].texture;
+        VkDeviceSize size = texture->allocation.size;
+        usage -= usage > size ? size : usage;
+    }
+
+    while (usage > limit) {
+        ETexture oldest = { NULL };
+        for (uint32_t id = 1; id < E_MAX_TEXTURES; ++id) {
+            ETexture texture = renderer->textures[id];
+            if (texture && texture->evict && eTextureIsReady(texture)
+                && renderer->frameCount - texture->lastDrawn
+                     >= E_RESIDENCY_IDLE_FRAMES
+                && (!oldest || texture->lastDrawn < oldest->lastDrawn)) {
+                oldest = texture;
+            }
+        }
+        if (!oldest) {
+            return;
+        }
+        if (!oldest->evict(oldest->evictUserData, oldest)) {
+            // the owner keeps it, asked again after another idle stretch
+            oldest->lastDrawn = renderer->frameCount;
+            continue;
+        }
+        VkDeviceSize size = oldest->allocation.size;
+        usage -= usage > size ? size : usage;
+        eRetireTexture(oldest, renderer, context);
+        renderer->stats.texturesEvicted++;
+    }
+}
+
+#if E_ENABLE_SHADER_RELOAD
+// Swaps in pipelines built from shaders recompiled since the last frame.
+// Frames in flight keep drawing with the old ones until they finish, a
+// shader that doesn't build leaves the old ones in place.
+static void
+  ReloadShaders(ERenderer renderer, EContext context, EDisplay display) {
+    const struct EShaderCode* code =
+      ePollShaderReload(renderer->reload, context->descriptorIndexing);
+    if (!code) {
+        return;
+    }
+    VkShaderModule shaders[E_SHADER_COUNT] = { 0 };
+    VkPipeline pipelines[E_PIPELINE_COUNT] = { 0 };
+    CreateShaderModules(renderer, context, code, shaders);
+    CreatePipeline(renderer, context, display, shaders, pipelines);
+    CreateCellPipeline(renderer, context, display, shaders, pipelines);
+    if (renderer->result != E_SUCCESS) {
+        (void)fprintf(stderr,
+          "Shader reload failed: %d, keeping the old pipelines\n",
+          renderer->result);
+        renderer->result = E_SUCCESS;
+        for (uint32_t i = 0; i < E_PIPELINE_COUNT; ++i) {
+            vkDestroyPipeline(
+              context->device, pipelines[i], context->vkAllocator);
+        }
+        for (uint32_t i = 0; i < E_SHADER_COUNT; ++i) {
+            vkDestroyShaderModule(
+              context->device, shaders[i], context->vkAllocator);
+        }
+        return;
+    }
+
+    if (renderer->retiredPipelineCount == E_MAX_RETIRED_PIPELINES) {
+        eWaitForQueues(context);
+        CollectRetiredPipelines(renderer, context, UINT64_MAX);
+    }
+    struct ERetiredPipelines* ret =
+      &renderer->retiredPipelines[renderer->retiredPipelineCount++];
+    ret->serial = context->graphicsTimeline.submitted;
+    for (uint32_t i = 0; i < E_PIPELINE_COUNT; ++i) {
+        ret->pipelines[i] = renderer->pipelines[i];
+        renderer->pipelines[i] = pipelines[i];
+    }
+    // modules are only read while pipelines are created
+    for (uint32_t i = 0; i < E_SHADER_COUNT; ++i) {
+        vkDestroyShaderModule(
+          context->device, renderer->shaders[i], context->vkAllocator);
+        renderer->shaders[i] = shaders[i];
+    }
+#if E_VERBOSE_MESSAGING
+    (void)printf("Reloaded shaders\n");
+#endif
+}
+#endif
+
+// What draw commands reference the texture by, ImTextureID for imgui.
+E_EXTERN uint64_t eGetTextureId(ETexture texture) {
+    return texture ? texture->id : 0;
+}
+
+E_EXTERN int eTextureIsReady(ETexture texture) {
+    return texture->result == E_SUCCESS && !texture->upload;
+}
+
+// Dynamic textures take one eUpdateTexture at a time.
+E_EXTERN int eTextureCanUpdate(ETexture texture) {
+    return texture->dynamic && eTextureIsReady(texture)
+           && !texture->regionUpload;
+}
+
+// Copies the regions into the dynamic texture on the transfer queue. The
+// texture stays drawable meanwhile, the regions must not be drawn from until
+// eTextureCanUpdate says the copy finished. One staging buffer and one
+// submit cover all regions.
+E_EXTERN EResult eUpdateTexture(ETexture texture,
+  EContext context,
+  const ETextureRegion* regions,
+  uint32_t regionCount) {
+    if (!eTextureCanUpdate(texture)) {
+        return E_UPLOAD_FAILURE;
+    }
+    if (!regionCount) {
+        return E_SUCCESS;
+    }
+    VkBufferImageCopy* copies =
+      eAlloc(sizeof(*copies) * regionCount, E_MEMORY_SCOPE_TEXTURE);
+    if (!copies) {
+        return E_MALLOC_FAILURE;
+    }
+    uint32_t texelSize = TexelSize(texture);
+    VkDeviceSize size = { 0 };
+    for (uint32_t i = 0; i < regionCount; ++i) {
+        const ETextureRegion* region = &regions[i];
+        // copies of one byte texels still start 4 byte aligned
+        size = (size + 3) & ~(VkDeviceSize)3;
+        copies[i] = (VkBufferImageCopy){
+            .bufferOffset = size,
+            .imageSubresource = {
+                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                .layerCount = 1,
+            },
+            .imageOffset = {
+                .x = (int32_t)region->x,
+                .y = (int32_t)region->y,
+            },
+            .imageExtent = {
+                .width = region->width,
+                .height = region->height,
+                .depth = 1,
+            },
+        };
+        size += (VkDeviceSize)region->width * region->height * texelSize;
+    }
+
+    struct EUploadSlot* slot = eAcquireUploadSlot(context);
+    if (!slot) {
+        eFree(copies);
+        return E_UPLOAD_FAILURE;
+    }
+    EResult res = eReserveStreamBuffer(
+      context, &slot->staging, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+    if (res != E_SUCCESS) {
+        (void)vkEndCommandBuffer(slot->commandBuffer);
+        eFree(copies);
+        return res;
+    }
+    for (uint32_t i = 0; i < regionCount; ++i) {
+        const ETextureRegion* region = &regions[i];
+        unsigned char* dst =
+          (unsigned char*)slot->staging.mapped + copies[i].bufferOffset;
+        const unsigned char* src = region->pixels;
+        for (uint32_t row = 0; row < region->height; ++row) {
+            memcpy(dst + (size_t)row * region->width * texelSize,
+              src + (size_t)row * region->pitch,
+              (size_t)region->width * texelSize);
+        }
+    }
+    // the image stays in the general layout, texels outside the regions
+    // are sampled by frames in flight while the copy runs
+    vkCmdCopyBufferToImage(slot->commandBuffer,
+      slot->staging.buffer,
+      texture->image,
+      VK_IMAGE_LAYOUT_GENERAL,
+      regionCount,
+      copies);
+    eFree(copies);
+    return eSubmitUpload(context, slot, texture, 1);
+}
+
+static void CreateTextureImage(ETexture texture, EContext context) {
+    if (texture->result != E_SUCCESS) {
+        return;
+    }
+    VkResult err = { 0 };
+
+    // sharing the image avoids queue family ownership transfers, uploads are
+    // ordered against drawing by the frame waiting on the transfer timeline
+    uint32_t families[2] = {
+        context->graphicsQueueFamilyIndex,
+        context->transferQueueFamilyIndex,
+    };
+    int shared = { families[0] != families[1] };
+
+    VkImageCreateInfo ici = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+        .imageType = VK_IMAGE_TYPE_2D,
+        .format = TextureFormat(texture),
+        .extent = {
+            .width = texture->width,
+            .height = texture->height,
+            .depth = 1,
+        },
+        .mipLevels = 1,
+        .arrayLayers = 1,
+        .samples = VK_SAMPLE_COUNT_1_BIT,
+        .tiling = VK_IMAGE_TILING_OPTIMAL,
+        .usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+        .sharingMode =
+          shared ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE,
+        .queueFamilyIndexCount = shared ? 2 : 0,
+        .pQueueFamilyIndices = shared ? families : NULL,
+        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+    };
+    err = vkCreateImage(
+      context->device, &ici, context->vkAllocator, &texture->image);
+    if (err != VK_SUCCESS) {
+        texture->result = E_CREATE_IMAGE_FAILURE;
+        return;
+    }
+
+    // icon sized textures share blocks instead of allocating one each
+    texture->result = eAllocateImageMemory(context,
+      texture->image,
+      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+      &texture->allocation);
+}
+
+static void CreateTextureView(ETexture texture, EContext context) {
+    if (texture->result != E_SUCCESS) {
+        return;
+    }
     VkResult err = { 0 };
 
-    // uint32_t* vert = { NULL };
-    // uint32_t* frag = { NULL };
-    // uint32_t fileSize = { 0 };
+    VkImageViewCreateInfo ivci = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+        .image = texture->image,
+        .viewType = VK_IMAGE_VIEW_TYPE_2D,
+        .format = TextureFormat(texture),
+        .subresourceRange = {
+            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+            .levelCount = 1,
+            .layerCount = 1,
+        },
+    };
+    err = vkCreateImageView(
+      context->device, &ivci, context->vkAllocator, &texture->imageView);
+    if (err != VK_SUCCESS) {
+        texture->result = E_CREATE_IMAGE_VIEW_FAILURE;
+    }
+}
 
-    // FILE* file = { NULL };
-    // errno_t ferr = { 0 };
+static uint32_t AcquireTextureId(ERenderer renderer, ETexture texture) {
+    for (uint32_t i = 0; i < E_MAX_TEXTURES - 1; ++i) {
+        uint32_t id = 1 + (renderer->textureHint + i) % (E_MAX_TEXTURES - 1);
+        if (!renderer->textures[id]) {
+            renderer->textures[id] = texture;
+            renderer->textureHint = id;
+            return id;
+        }
+    }
+    return 0;
+}
 
-    // (void)fopen_s(&file,
-    //   "C:"
-    //   "\\Users\\danie\\Desktop\\Sources\\projects\\EldenSheet\\src\\core\\shade"
-    //   "rs\\shader.vert.in",
-    //   "rb");
+static void AllocateTextureDescriptor(ETexture texture,
+  ERenderer renderer,
+  EContext context) {
+    if (texture->result != E_SUCCESS) {
+        return;
+    }
+    VkResult err = { 0 };
 
-    // (void)fseek(file, 0, SEEK_END);
-    // fileSize = ftell(file);
-    // (void)fseek(file, 0, SEEK_SET);
+    texture->id = AcquireTextureId(renderer, texture);
+    if (!texture->id) {
+        texture->result = E_ALLOCATE_DESCRIPTOR_SET_FAILURE;
+        return;
+    }
 
-    // vert = malloc(fileSize);
-    // (void)fread_s(vert, fileSize, 1, fileSize, file);
-    // (void)fclose(file);
+    VkDescriptorImageInfo dii = {
+        .sampler = renderer->sampler,
+        .imageView = texture->imageView,
+        .imageLayout = SampledLayout(texture),
+    };
+    VkWriteDescriptorSet wds = {
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .dstSet = renderer->textureSet,
+        .dstArrayElement = texture->id,
+        .descriptorCount = 1,
+        .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+        .pImageInfo = &dii,
+    };
+    // the element isn't used by frames in flight, the id was free
+    if (renderer->textureSet) {
+        vkUpdateDescriptorSets(context->device, 1, &wds, 0, NULL);
+        return;
+    }
 
-    VkShaderModuleCreateInfo vsmci = {
-        .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
-        .codeSize = sizeof(__glsl_shader_vert_spv),
-        .pCode = __glsl_shader_vert_spv,
+    VkDescriptorSetAllocateInfo dsai = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .descriptorPool = renderer->descPool,
+        .descriptorSetCount = 1,
+        .pSetLayouts = &renderer->descSetLayout,
     };
-    vkCreateShaderModule(context->device, &vsmci, NULL, &renderer->vertShader);
+    err = vkAllocateDescriptorSets(
+      context->device, &dsai, &texture->descriptorSet);
+    if (err != VK_SUCCESS) {
+        texture->result = E_ALLOCATE_DESCRIPTOR_SET_FAILURE;
+        return;
+    }
+    wds.dstSet = texture->descriptorSet;
+    wds.dstArrayElement = 0;
+    vkUpdateDescriptorSets(context->device, 1, &wds, 0, NULL);
+}
 
-    // (void)fopen_s(&file,
-    //   "\\Users\\danie\\Desktop\\Sources\\projects\\EldenSheet\\src\\core\\shade"
-    //   "rs\\shader.frag.in",
-    //   "rb");
+static void
+  UploadTexture(ETexture texture, EContext context, const void* pixels) {
+    if (texture->result != E_SUCCESS) {
+        return;
+    }
+    EResult res = { E_SUCCESS };
 
-    // (void)fseek(file, 0, SEEK_END);
-    // fileSize = ftell(file);
-    // (void)fseek(file, 0, SEEK_SET);
+    struct EUploadSlot* slot = eAcquireUploadSlot(context);
+    if (!slot) {
+        texture->result = E_UPLOAD_FAILURE;
+        return;
+    }
+    VkDeviceSize size =
+      (VkDeviceSize)texture->width * texture->height * TexelSize(texture);
+    res = eReserveStreamBuffer(
+      context, &slot->staging, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+    if (res != E_SUCCESS) {
+        // leave the slot in a state the next acquire can reset
+        (void)vkEndCommandBuffer(slot->commandBuffer);
+        texture->result = res;
+        return;
+    }
+    // dynamic textures may start out transparent
+    if (pixels) {
+        memcpy(slot->staging.mapped, pixels, size);
+    }
+    else {
+        memset(slot->staging.mapped, 0, size);
+    }
 
-    // frag = malloc(fileSize);
-    // (void)fread_s(frag, fileSize, 1, fileSize, file);
-    // (void)fclose(file);
+    VkImageMemoryBarrier imb = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .srcAccessMask = 0,
+        .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = texture->image,
+        .subresourceRange = {
+            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+            .levelCount = 1,
+            .layerCount = 1,
+        },
+    };
+    vkCmdPipelineBarrier(slot->commandBuffer,
+      VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+      VK_PIPELINE_STAGE_TRANSFER_BIT,
+      0,
+      0,
+      NULL,
+      0,
+      NULL,
+      1,
+      &imb);
 
-    VkShaderModuleCreateInfo fsmci = {
-        .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
-        .codeSize = sizeof(__glsl_shader_frag_spv),
-        .pCode = __glsl_shader_frag_spv,
+    VkBufferImageCopy bic = {
+        .imageSubresource = {
+            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+            .layerCount = 1,
+        },
+        .imageExtent = {
+            .width = texture->width,
+            .height = texture->height,
+            .depth = 1,
+        },
     };
-    vkCreateShaderModule(context->device, &fsmci, NULL, &renderer->fragShader);
+    vkCmdCopyBufferToImage(slot->commandBuffer,
+      slot->staging.buffer,
+      texture->image,
+      VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+      1,
+      &bic);
+
+    // transfer queues can't name shader stages, the graphics submit of the
+    // first frame drawing it waits for this upload's timeline value
+    imb.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    imb.dstAccessMask = 0;
+    imb.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    imb.newLayout = SampledLayout(texture);
+    vkCmdPipelineBarrier(slot->commandBuffer,
+      VK_PIPELINE_STAGE_TRANSFER_BIT,
+      VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+      0,
+      0,
+      NULL,
+      0,
+      NULL,
+      1,
+      &imb);
+
+    texture->result = eSubmitUpload(context, slot, texture, 0);
+}
+
+// Dynamic textures are copied into while drawn, which only the general
+// layout allows without transitions.
+static VkImageLayout SampledLayout(ETexture texture) {
+    return texture->dynamic ? VK_IMAGE_LAYOUT_GENERAL
+                            : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+}
+
+static VkFormat TextureFormat(ETexture texture) {
+    return texture->alphaOnly ? VK_FORMAT_R8_UNORM : VK_FORMAT_R8G8B8A8_UNORM;
+}
+
+static uint32_t TexelSize(ETexture texture) {
+    return texture->alphaOnly ? 1 : 4;
+}
+
+// every format reads as a float vector in the vertex shader
+static VkFormat VertexFormat(EVertexFormat format) {
+    switch (format) {
+        case E_VERTEX_FORMAT_HALF2:
+            return VK_FORMAT_R16G16_SFLOAT;
+        case E_VERTEX_FORMAT_UNORM16X2:
+            return VK_FORMAT_R16G16_UNORM;
+        case E_VERTEX_FORMAT_UNORM8X4:
+            return VK_FORMAT_R8G8B8A8_UNORM;
+        case E_VERTEX_FORMAT_FLOAT2:
+        default:
+            return VK_FORMAT_R32G32_SFLOAT;
+    }
+}
+
+// Keeps the vertex layout, the create info's arrays don't outlive
+// eCreateRenderer and reloads build the pipelines again.
+static void DescribeVertices(ERenderer renderer,
+  const struct EImguiVertData* vd) {
+    for (uint32_t i = 0; i < 3; ++i) {
+        renderer->vertexAttrs[i] = (VkVertexInputAttributeDescription){
+            .format = VertexFormat(vd->inputAttrFormats[i]),
+            .location = i,
+            .offset = vd->inputAttrOffsets[i],
+        };
+    }
+}
+
+static void CreateShaderModules(ERenderer renderer,
+  EContext context,
+  const struct EShaderCode* code,
+  VkShaderModule* modulesOut) {
+    if (renderer->result != E_SUCCESS) {
+        return;
+    }
+    VkResult err = { 0 };
+
+    for (uint32_t i = 0; i < E_SHADER_COUNT; ++i) {
+        VkShaderModuleCreateInfo smci = {
+            .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+            .codeSize = code[i].size,
+            .pCode = code[i].code,
+        };
+        err = vkCreateShaderModule(
+          context->device, &smci, context->vkAllocator, &modulesOut[i]);
+        if (err != VK_SUCCESS) {
+            renderer->result = E_CREATE_SHADER_MODULE_FAILURE;
+            return;
+        }
+    }
+}
+
+// the imgui pipelines, one per way of sampling textures
+static void CreatePipeline(ERenderer renderer,
+  EContext context,
+  EDisplay display,
+  const VkShaderModule* shaders,
+  VkPipeline* pipelinesOut) {
+    if (renderer->result != E_SUCCESS) {
+        return;
+    }
 
     VkPipelineShaderStageCreateInfo pssci[2] = {
         (VkPipelineShaderStageCreateInfo){
           .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
           .pName = "main",
-          .module = renderer->vertShader,
+          .module = shaders[E_SHADER_VERT],
           .stage = VK_SHADER_STAGE_VERTEX_BIT,
         },
         (VkPipelineShaderStageCreateInfo){
           .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
           .pName = "main",
-          .module = renderer->fragShader,
+          .module = shaders[E_SHADER_FRAG],
           .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
         },
     };
     VkVertexInputBindingDescription vertBindDesc = {
         .inputRate = VK_VERTEX_INPUT_RATE_VERTEX,
-        .stride = infoIn->imguiVertData.inputAttrSize,
+        .stride = renderer->vertSize,
+    };
+    VkPipelineVertexInputStateCreateInfo pvisci = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+        .pVertexAttributeDescriptions = renderer->vertexAttrs,
+        .vertexAttributeDescriptionCount = 3,
+        .pVertexBindingDescriptions = &vertBindDesc,
+        .vertexBindingDescriptionCount = 1,
+    };
+    // kAlphaOnly and kDistanceField in shader.frag, set from the kind's bits
+    VkSpecializationMapEntry constantEntries[2] = {
+        (VkSpecializationMapEntry){
+          .constantID = 0,
+          .offset = 0,
+          .size = sizeof(VkBool32),
+        },
+        (VkSpecializationMapEntry){
+          .constantID = 1,
+          .offset = sizeof(VkBool32),
+          .size = sizeof(VkBool32),
+        },
+    };
+    for (uint32_t kind = E_PIPELINE_IMGUI;
+         kind <= E_PIPELINE_SDF_ALPHA && renderer->result == E_SUCCESS;
+         ++kind) {
+        VkBool32 constants[2] = {
+            (kind & E_PIPELINE_ALPHA) != 0,
+            (kind & E_PIPELINE_SDF) != 0,
+        };
+        VkSpecializationInfo si = {
+            .mapEntryCount = 2,
+            .pMapEntries = constantEntries,
+            .dataSize = sizeof(constants),
+            .pData = constants,
+        };
+        pssci[1].pSpecializationInfo = &si;
+        BuildPipeline(renderer,
+          context,
+          display,
+          pssci,
+          &pvisci,
+          VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+          &pipelinesOut[kind]);
+    }
+}
+
+// One instance per cell, the strip's corners come from the vertex index.
+static void CreateCellPipeline(ERenderer renderer,
+  EContext context,
+  EDisplay display,
+  const VkShaderModule* shaders,
+  VkPipeline* pipelinesOut) {
+    if (renderer->result != E_SUCCESS) {
+        return;
+    }
+
+    VkPipelineShaderStageCreateInfo pssci[2] = {
+        (VkPipelineShaderStageCreateInfo){
+          .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+          .pName = "main",
+          .module = shaders[E_SHADER_CELL_VERT],
+          .stage = VK_SHADER_STAGE_VERTEX_BIT,
+        },
+        (VkPipelineShaderStageCreateInfo){
+          .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+          .pName = "main",
+          .module = shaders[E_SHADER_CELL_FRAG],
+          .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
+        },
+    };
+    VkVertexInputBindingDescription instBindDesc = {
+        .inputRate = VK_VERTEX_INPUT_RATE_INSTANCE,
+        .stride = sizeof(ECellRect),
     };
-    VkVertexInputAttributeDescription vertAttrDesc[3] = {
+    VkVertexInputAttributeDescription instAttrDesc[4] = {
         (VkVertexInputAttributeDescription){
-          .binding = vertBindDesc.binding,
-          .format = VK_FORMAT_R32G32_SFLOAT,
+          .format = VK_FORMAT_R32G32B32A32_SFLOAT,
           .location = 0,
-          .offset = infoIn->imguiVertData.inputAttrOffsets[0],
+          .offset = offsetof(ECellRect, rect),
         },
         (VkVertexInputAttributeDescription){
-          .binding = vertBindDesc.binding,
-          .format = VK_FORMAT_R32G32_SFLOAT,
+          .format = VK_FORMAT_R8G8B8A8_UNORM,
           .location = 1,
-          .offset = infoIn->imguiVertData.inputAttrOffsets[1],
+          .offset = offsetof(ECellRect, fill),
         },
         (VkVertexInputAttributeDescription){
-          .binding = vertBindDesc.binding,
           .format = VK_FORMAT_R8G8B8A8_UNORM,
           .location = 2,
-          .offset = infoIn->imguiVertData.inputAttrOffsets[2],
+          .offset = offsetof(ECellRect, border),
+        },
+        // radius and border width
+        (VkVertexInputAttributeDescription){
+          .format = VK_FORMAT_R32G32_SFLOAT,
+          .location = 3,
+          .offset = offsetof(ECellRect, radius),
         },
     };
     VkPipelineVertexInputStateCreateInfo pvisci = {
         .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
-        .pVertexAttributeDescriptions = vertAttrDesc,
-        .vertexAttributeDescriptionCount = 3,
-        .pVertexBindingDescriptions = &vertBindDesc,
+        .pVertexAttributeDescriptions = instAttrDesc,
+        .vertexAttributeDescriptionCount = 4,
+        .pVertexBindingDescriptions = &instBindDesc,
         .vertexBindingDescriptionCount = 1,
     };
+    BuildPipeline(renderer,
+      context,
+      display,
+      pssci,
+      &pvisci,
+      VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP,
+      &pipelinesOut[E_PIPELINE_CELLS]);
+}
+
+// fixed function state shared by all pipelines
+static void BuildPipeline(ERenderer renderer,
+  EContext context,
+  EDisplay display,
+  const VkPipelineShaderStageCreateInfo* stages,
+  const VkPipelineVertexInputStateCreateInfo* vertexInput,
+  VkPrimitiveTopology topology,
+  VkPipeline* pipelineOut) {
+    VkResult err = { 0 };
+
     VkPipelineInputAssemblyStateCreateInfo piasci = {
         .sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
-        .topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+        .topology = topology,
     };
     VkPipelineViewportStateCreateInfo pvsci = {
         .sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
@@ -213,13 +1660,20 @@ static void CreatePipeline(ERenderer renderer,
         .dynamicStateCount = 2,
         .pDynamicStates = dynStates,
     };
+    // without a render pass the attachment formats come from here
+    VkPipelineRenderingCreateInfo prci = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO,
+        .colorAttachmentCount = 1,
+        .pColorAttachmentFormats = &display->surfaceFormat.format,
+    };
     VkGraphicsPipelineCreateInfo gpci = {
         .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+        .pNext = context->dynamicRendering ? &prci : NULL,
         .layout = renderer->pipelineLayout,
-        .renderPass = infoIn->display->renderPass,
+        .renderPass = display->renderPass,
         .stageCount = 2,
-        .pStages = pssci,
-        .pVertexInputState = &pvisci,
+        .pStages = stages,
+        .pVertexInputState = vertexInput,
         .pInputAssemblyState = &piasci,
         .pViewportState = &pvsci,
         .pRasterizationState = &prsci,
@@ -229,11 +1683,26 @@ static void CreatePipeline(ERenderer renderer,
         .pDynamicState = &pdsci,
     };
 
-    err = vkCreateGraphicsPipelines(
-      context->device, VK_NULL_HANDLE, 1, &gpci, NULL, &renderer->pipeline);
+#if E_VERBOSE_MESSAGING
+    struct timespec start = { 0 };
+    struct timespec end = { 0 };
+    (void)timespec_get(&start, TIME_UTC);
+#endif
+    err = vkCreateGraphicsPipelines(context->device,
+      context->pipelineCache,
+      1,
+      &gpci,
+      context->vkAllocator,
+      pipelineOut);
     if (err != VK_SUCCESS) {
         renderer->result = E_CREATE_PIPELINE_FAILURE;
     }
+#if E_VERBOSE_MESSAGING
+    (void)timespec_get(&end, TIME_UTC);
+    printf("Pipeline creation took %.3f ms\n",
+      (double)(end.tv_sec - start.tv_sec) * 1e3
+        + (double)(end.tv_nsec - start.tv_nsec) / 1e6);
+#endif
 }
 
 static void CreatePipelineLayout(ERenderer renderer, EContext context) {
@@ -242,19 +1711,27 @@ static void CreatePipelineLayout(ERenderer renderer, EContext context) {
     }
     VkResult err = { 0 };
 
-    VkPushConstantRange pushConstant = {
-        .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
-        .size = sizeof(float) * 4,
+    // scale and translate, then the texture id for the bindless shader
+    VkPushConstantRange pushConstants[2] = {
+        {
+          .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+          .size = sizeof(float) * 4,
+        },
+        {
+          .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+          .offset = sizeof(float) * 4,
+          .size = sizeof(uint32_t),
+        },
     };
     VkPipelineLayoutCreateInfo plci = {
         .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
         .pSetLayouts = &renderer->descSetLayout,
         .setLayoutCount = 1,
-        .pPushConstantRanges = &pushConstant,
-        .pushConstantRangeCount = 1,
+        .pPushConstantRanges = pushConstants,
+        .pushConstantRangeCount = context->descriptorIndexing ? 2 : 1,
     };
     err = vkCreatePipelineLayout(
-      context->device, &plci, NULL, &renderer->pipelineLayout);
+      context->device, &plci, context->vkAllocator, &renderer->pipelineLayout);
     if (err != VK_SUCCESS) {
         renderer->result = E_CREATE_PIPELINE_LAYOUT_FAILURE;
     }
@@ -267,7 +1744,7 @@ static void CreateDescriptorPool(ERenderer renderer, EContext context) {
     VkResult err = { 0 };
 
     VkDescriptorPoolSize poolSizes[] = {
-        { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1 },
+        { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, E_MAX_TEXTURES },
     };
     renderer->descPoolSize = sizeof(poolSizes) / sizeof(*poolSizes);
 
@@ -275,6 +1752,10 @@ static void CreateDescriptorPool(ERenderer renderer, EContext context) {
     for (int i = 0; i < sizeof(poolSizes) / sizeof(*poolSizes); ++i) {
         maxSets += poolSizes[i].descriptorCount;
     }
+    // a single set holds every texture
+    if (context->descriptorIndexing) {
+        maxSets = 1;
+    }
     VkDescriptorPoolCreateInfo dpci = (VkDescriptorPoolCreateInfo){
         .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
         .flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT,
@@ -282,13 +1763,32 @@ static void CreateDescriptorPool(ERenderer renderer, EContext context) {
         .poolSizeCount = renderer->descPoolSize,
         .maxSets = maxSets,
     };
-    err =
-      vkCreateDescriptorPool(context->device, &dpci, NULL, &renderer->descPool);
+    err = vkCreateDescriptorPool(
+      context->device, &dpci, context->vkAllocator, &renderer->descPool);
     if (err != VK_SUCCESS) {
         context->result = E_CREATE_DESCRIPTOR_POOL_FAILURE;
     }
 }
 
+static void AllocateTextureSet(ERenderer renderer, EContext context) {
+    if (renderer->result != E_SUCCESS || !context->descriptorIndexing) {
+        return;
+    }
+    VkResult err = { 0 };
+
+    VkDescriptorSetAllocateInfo dsai = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .descriptorPool = renderer->descPool,
+        .descriptorSetCount = 1,
+        .pSetLayouts = &renderer->descSetLayout,
+    };
+    err = vkAllocateDescriptorSets(
+      context->device, &dsai, &renderer->textureSet);
+    if (err != VK_SUCCESS) {
+        renderer->result = E_ALLOCATE_DESCRIPTOR_SET_FAILURE;
+    }
+}
+
 static void CreateDescriptorSetLayout(ERenderer renderer, EContext context) {
     if (renderer->result != E_SUCCESS) {
         return;
@@ -300,13 +1800,28 @@ static void CreateDescriptorSetLayout(ERenderer renderer, EContext context) {
         .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
         .descriptorCount = 1,
     };
+    // Unused elements may stay unwritten, and new textures may be written
+    // while frames that don't sample them are in flight.
+    VkDescriptorBindingFlags bindingFlags =
+      VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT
+      | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+    VkDescriptorSetLayoutBindingFlagsCreateInfo dslbfci = {
+        .sType =
+          VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO,
+        .bindingCount = 1,
+        .pBindingFlags = &bindingFlags,
+    };
     VkDescriptorSetLayoutCreateInfo dslci = {
         .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
         .bindingCount = 1,
         .pBindings = &dscBinding,
     };
+    if (context->descriptorIndexing) {
+        dscBinding.descriptorCount = E_MAX_TEXTURES;
+        dslci.pNext = &dslbfci;
+    }
     err = vkCreateDescriptorSetLayout(
-      context->device, &dslci, NULL, &renderer->descSetLayout);
+      context->device, &dslci, context->vkAllocator, &renderer->descSetLayout);
     if (err != VK_SUCCESS) {
         renderer->result = E_CREATE_DESCRIPTOR_POOL_FAILURE;
     }
@@ -330,7 +1845,8 @@ static void CreateSampler(ERenderer renderer, EContext context) {
         .maxLod = -1000,
         .maxAnisotropy = 1.0f,
     };
-    err = vkCreateSampler(context->device, &sci, NULL, &renderer->sampler);
+    err = vkCreateSampler(
+      context->device, &sci, context->vkAllocator, &renderer->sampler);
     if (err != VK_SUCCESS) {
         renderer->result = E_CREATE_SAMPLER_FAILURE;
     }
@@ -5,3 +5,26 @@
 E_EXTERN void eCreateRenderer(ERenderer* rendererOut,
   ERendererCreateInfo* infoIn);
 E_EXTERN void eDestroyRenderer(ERenderer renderer, EContext context);
+E_EXTERN void eSetDrawData(ERenderer renderer, const EDrawData* drawData);
+E_EXTERN int
+  ePrepareDrawData(ERenderer renderer, EContext context, EDisplay display);
+E_EXTERN void
+  eRecordDrawData(ERenderer renderer, EContext context, EDisplay display);
+E_EXTERN void eSetRecordThreads(ERenderer renderer, uint32_t count);
+E_EXTERN void eGetRendererStats(ERenderer renderer, ERendererStats* statsOut);
+E_EXTERN void eCreateTexture(ETexture* textureOut,
+  ERenderer renderer,
+  EContext context,
+  ETextureCreateInfo* infoIn);
+E_EXTERN void
+  eDestroyTexture(ETexture texture, ERenderer renderer, EContext context);
+E_EXTERN void
+  eRetireTexture(ETexture texture, ERenderer renderer, EContext context);
+E_EXTERN uint64_t eGetTextureId(ETexture texture);
+E_EXTERN int eTextureIsReady(ETexture texture);
+E_EXTERN int eTextureCanUpdate(ETexture texture);
+E_EXTERN EResult eUpdateTexture(ETexture texture,
+  EContext context,
+  const ETextureRegion* regions,
+  uint32_t regionCount);
+E_EXTERN uint64_t eHashDrawData(ERenderer renderer);
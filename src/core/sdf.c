@@ -0,0 +1,126 @@
+#include "sdf.h"
+
+#include "core.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+// stands in for infinity, squares of it still fit a float
+#define E_SDF_FAR 1e20f
+
+// Squared euclidean distance transform of one row or column, after
+// Felzenszwalb and Huttenlocher. v and z are scratch of n and n + 1.
+static void
+  Transform1D(const float* f, float* d, int* v, float* z, uint32_t n) {
+    int k = { 0 };
+    v[0] = 0;
+    z[0] = -E_SDF_FAR;
+    z[1] = E_SDF_FAR;
+    for (int q = 1; q < (int)n; ++q) {
+        float s = ((f[q] + (float)(q * q)) - (f[v[k]] + (float)(v[k] * v[k])))
+                  / (float)(2 * q - 2 * v[k]);
+        while (s <= z[k]) {
+            --k;
+            s = ((f[q] + (float)(q * q)) - (f[v[k]] + (float)(v[k] * v[k])))
+                / (float)(2 * q - 2 * v[k]);
+        }
+        ++k;
+        v[k] = q;
+        z[k] = s;
+        z[k + 1] = E_SDF_FAR;
+    }
+    k = 0;
+    for (int q = 0; q < (int)n; ++q) {
+        while (z[k + 1] < (float)q) {
+            ++k;
+        }
+        d[q] = (float)((q - v[k]) * (q - v[k])) + f[v[k]];
+    }
+}
+
+// columns, then rows, f and d are scratch of max(width, height)
+static void Transform2D(float* grid,
+  uint32_t width,
+  uint32_t height,
+  float* f,
+  float* d,
+  int* v,
+  float* z) {
+    for (uint32_t x = 0; x < width; ++x) {
+        for (uint32_t y = 0; y < height; ++y) {
+            f[y] = grid[(size_t)y * width + x];
+        }
+        Transform1D(f, d, v, z, height);
+        for (uint32_t y = 0; y < height; ++y) {
+            grid[(size_t)y * width + x] = d[y];
+        }
+    }
+    for (uint32_t y = 0; y < height; ++y) {
+        float* row = &grid[(size_t)y * width];
+        for (uint32_t x = 0; x < width; ++x) {
+            f[x] = row[x];
+        }
+        Transform1D(f, row, v, z, width);
+    }
+}
+
+// Turns 8 bit coverage into an 8 bit signed distance field of the same
+// size: 128 on the outline, rising inwards and falling outwards to reach
+// 255 and 0 spread texels away. Texels that are partially covered place
+// the outline inside of themselves by their coverage.
+E_EXTERN EResult eBuildDistanceField(const unsigned char* coverage,
+  uint32_t width,
+  uint32_t height,
+  uint32_t spread,
+  unsigned char* fieldOut) {
+    size_t count = (size_t)width * height;
+    uint32_t n = width > height ? width : height;
+    // squared distances to the nearest texel inside and outside the outline
+    float* toInside = eAlloc(sizeof(float) * count, E_MEMORY_SCOPE_TEXTURE);
+    float* toOutside = eAlloc(sizeof(float) * count, E_MEMORY_SCOPE_TEXTURE);
+    float* f = eAlloc(sizeof(float) * n, E_MEMORY_SCOPE_TEXTURE);
+    float* d = eAlloc(sizeof(float) * n, E_MEMORY_SCOPE_TEXTURE);
+    int* v = eAlloc(sizeof(int) * n, E_MEMORY_SCOPE_TEXTURE);
+    float* z = eAlloc(sizeof(float) * (n + 1), E_MEMORY_SCOPE_TEXTURE);
+    EResult res = { E_SUCCESS };
+    if (!toInside || !toOutside || !f || !d || !v || !z) {
+        res = E_MALLOC_FAILURE;
+        goto cleanup;
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        int inside = coverage[i] >= 128;
+        toInside[i] = inside ? 0.f : E_SDF_FAR;
+        toOutside[i] = inside ? E_SDF_FAR : 0.f;
+    }
+    Transform2D(toInside, width, height, f, d, v, z);
+    Transform2D(toOutside, width, height, f, d, v, z);
+
+    float scale = { spread ? 0.5f / (float)spread : 0.5f };
+    for (size_t i = 0; i < count; ++i) {
+        // signed, in texels, positive outside, the outline runs halfway
+        // between the centers of a covered and an uncovered texel
+        float dist = { 0.f };
+        if (coverage[i] == 0) {
+            dist = sqrtf(toInside[i]) - 0.5f;
+        }
+        else if (coverage[i] == 255) {
+            dist = 0.5f - sqrtf(toOutside[i]);
+        }
+        else {
+            dist = 0.5f - (float)coverage[i] / 255.f;
+        }
+        float value = 0.5f - dist * scale;
+        value = value < 0.f ? 0.f : value > 1.f ? 1.f : value;
+        fieldOut[i] = (unsigned char)(value * 255.f + 0.5f);
+    }
+
+cleanup:
+    eFree(z);
+    eFree(v);
+    eFree(d);
+    eFree(f);
+    eFree(toOutside);
+    eFree(toInside);
+    return res;
+}
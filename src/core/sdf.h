@@ -0,0 +1,9 @@
+#pragma once
+
+#include "../graphics.h"
+
+E_EXTERN EResult eBuildDistanceField(const unsigned char* coverage,
+  uint32_t width,
+  uint32_t height,
+  uint32_t spread,
+  unsigned char* fieldOut);
@@ -0,0 +1,18 @@
+#version 450 core
+layout(location = 0) out vec4 fColor;
+
+layout(location = 0) flat in vec4 vFill;
+layout(location = 1) flat in vec4 vBorder;
+layout(location = 2) in vec2 vLocal;
+layout(location = 3) flat in vec4 vShape;
+
+void main()
+{
+    // signed distance to the rounded rect in pixels, negative inside
+    vec2 q = abs(vLocal) - vShape.xy;
+    float d = length(max(q, 0.0)) + min(max(q.x, q.y), 0.0) - vShape.z;
+    float coverage = clamp(0.5 - d, 0.0, 1.0);
+    float border = clamp(d + vShape.w + 0.5, 0.0, 1.0) * min(vShape.w, 1.0);
+    vec4 color = mix(vFill, vBorder, border);
+    fColor = vec4(color.rgb, color.a * coverage);
+}
@@ -0,0 +1,34 @@
+#version 450 core
+// one instance per cell rect, drawn as a 4 vertex triangle strip
+layout(location = 0) in vec4 aRect;  // min x, min y, max x, max y
+layout(location = 1) in vec4 aFill;
+layout(location = 2) in vec4 aBorder;
+layout(location = 3) in vec2 aShape;  // corner radius, border width
+
+layout(push_constant) uniform uPushConstant {
+    vec2 uScale;
+    vec2 uTranslate;
+} pc;
+
+out gl_PerVertex {
+    vec4 gl_Position;
+};
+
+layout(location = 0) flat out vec4 vFill;
+layout(location = 1) flat out vec4 vBorder;
+layout(location = 2) out vec2 vLocal;  // from the rect center
+// half size without the radius, radius, border width
+layout(location = 3) flat out vec4 vShape;
+
+void main()
+{
+    vec2 corner = vec2(gl_VertexIndex & 1, gl_VertexIndex >> 1);
+    vec2 size = aRect.zw - aRect.xy;
+    vec2 pos = aRect.xy + corner * size;
+    float radius = min(aShape.x, min(size.x, size.y) * 0.5);
+    vFill = aFill;
+    vBorder = aBorder;
+    vLocal = (corner - 0.5) * size;
+    vShape = vec4(size * 0.5 - radius, radius, aShape.y);
+    gl_Position = vec4(pos * pc.uScale + pc.uTranslate, 0, 1);
+}
@@ -1,2 +0,0 @@
-glslangValidator -V -x -o shader.frag.in shader.frag
-glslangValidator -V -x -o shader.vert.in shader.vert
@@ -1,7 +1,22 @@
 #version 450 core
 layout(location = 0) out vec4 fColor;
 
+// fixed per pipeline, the branches on them are folded away when it's built
+// coverage is in red of a one channel texture
+layout(constant_id = 0) const bool kAlphaOnly = false;
+// alpha is 0.5 on the glyph outline and grows inwards
+layout(constant_id = 1) const bool kDistanceField = false;
+
+#ifdef E_BINDLESS
+// indexed with a push constant, so dynamically uniform
+layout(set=0, binding=0) uniform sampler2D sTextures[1024];
+
+layout(push_constant) uniform uPushConstant {
+    layout(offset = 16) uint uTexture;
+} pc;
+#else
 layout(set=0, binding=0) uniform sampler2D sTexture;
+#endif
 
 layout(location = 0) in struct {
     vec4 Color;
@@ -10,5 +25,21 @@ layout(location = 0) in struct {
 
 void main()
 {
-    fColor = In.Color * texture(sTexture, In.UV.st);
+#ifdef E_BINDLESS
+    vec4 texel = texture(sTextures[pc.uTexture], In.UV.st);
+#else
+    vec4 texel = texture(sTexture, In.UV.st);
+#endif
+    if (!kAlphaOnly && !kDistanceField) {
+        fColor = In.Color * texel;
+        return;
+    }
+    float coverage = kAlphaOnly ? texel.r : texel.a;
+    if (kDistanceField) {
+        // fading over about a pixel keeps the edge sharp however far the
+        // quad is scaled
+        float w = max(fwidth(coverage), 1.0 / 255.0);
+        coverage = clamp((coverage - 0.5) / (2.0 * w) + 0.5, 0.0, 1.0);
+    }
+    fColor = vec4(In.Color.rgb, In.Color.a * coverage);
 }
@@ -1,3 +1,7 @@
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 199309L
+#endif
+
 #include "window.h"
 
 #include "core.h"
@@ -6,12 +10,118 @@
 #include <stdlib.h>
 #include <string.h>
 
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+#else
+#include <errno.h>
+#include <time.h>
+#endif
+
 #if E_ENABLE_ERROR_CALLBACK
 static void GlfwErrorCallback(int error, const char* description) {
     (void)fprintf(stderr, "(GLFW) Error: %d: %s\n", error, description);
 }
 #endif
 
+static void* GlfwAlloc(size_t size, void* user) {
+    (void)user;
+    return eAlloc(size, E_MEMORY_SCOPE_WINDOW);
+}
+
+static void* GlfwRealloc(void* block, size_t size, void* user) {
+    (void)user;
+    return eRealloc(block, size, E_MEMORY_SCOPE_WINDOW);
+}
+
+static void GlfwFree(void* block, void* user) {
+    (void)user;
+    eFree(block);
+}
+
+// any input or window change invalidates the current frame
+static void InvalidateFromGlfw(GLFWwindow* glfwWindow) {
+    EWindow window = glfwGetWindowUserPointer(glfwWindow);
+    if (window) {
+        window->dirtyFrames = E_DIRTY_FRAMES;
+    }
+}
+
+static void CursorPosCallback(GLFWwindow* window, double x, double y) {
+    (void)x;
+    (void)y;
+    InvalidateFromGlfw(window);
+}
+
+static void CursorEnterCallback(GLFWwindow* window, int entered) {
+    (void)entered;
+    InvalidateFromGlfw(window);
+}
+
+static void
+  MouseButtonCallback(GLFWwindow* window, int button, int action, int mods) {
+    (void)button;
+    (void)action;
+    (void)mods;
+    InvalidateFromGlfw(window);
+}
+
+static void ScrollCallback(GLFWwindow* window, double x, double y) {
+    (void)x;
+    (void)y;
+    InvalidateFromGlfw(window);
+}
+
+static void KeyCallback(GLFWwindow* window,
+  int key,
+  int scancode,
+  int action,
+  int mods) {
+    (void)key;
+    (void)scancode;
+    (void)action;
+    (void)mods;
+    InvalidateFromGlfw(window);
+}
+
+static void CharCallback(GLFWwindow* window, unsigned int codepoint) {
+    (void)codepoint;
+    InvalidateFromGlfw(window);
+}
+
+static void WindowFocusCallback(GLFWwindow* window, int focused) {
+    (void)focused;
+    InvalidateFromGlfw(window);
+}
+
+static void
+  FramebufferSizeCallback(GLFWwindow* window, int width, int height) {
+    (void)width;
+    (void)height;
+    InvalidateFromGlfw(window);
+}
+
+static void InstallCallbacks(EWindow window) {
+    if (window->result != E_SUCCESS) {
+        return;
+    }
+    // installed before imgui's backend, which chains to these
+    glfwSetWindowUserPointer(window->window, window);
+    (void)glfwSetCursorPosCallback(window->window, CursorPosCallback);
+    (void)glfwSetCursorEnterCallback(window->window, CursorEnterCallback);
+    (void)glfwSetMouseButtonCallback(window->window, MouseButtonCallback);
+    (void)glfwSetScrollCallback(window->window, ScrollCallback);
+    (void)glfwSetKeyCallback(window->window, KeyCallback);
+    (void)glfwSetCharCallback(window->window, CharCallback);
+    (void)glfwSetWindowFocusCallback(window->window, WindowFocusCallback);
+    (void)glfwSetWindowRefreshCallback(window->window, InvalidateFromGlfw);
+    (void)glfwSetFramebufferSizeCallback(
+      window->window, FramebufferSizeCallback);
+}
+
 static void InitWindow(EWindow window, EWindowCreateInfo* infoIn) {
     if (window->result != E_SUCCESS) {
         return;
@@ -30,12 +140,30 @@ static void InitWindow(EWindow window, EWindowCreateInfo* infoIn) {
           .width = infoIn->size.width,
           .height = infoIn->size.height,
         },
+        .presentMode = infoIn->presentMode,
+        .framesInFlight = infoIn->framesInFlight,
+        .frameInterval =
+          infoIn->frameRateLimit > 0.0 ? 1.0 / infoIn->frameRateLimit : 0.0,
     };
 
+#ifdef _WIN32
+    // plain Sleep() rounds up to the scheduler tick, too coarse for pacing
+    window->sleepTimer = CreateWaitableTimerExW(NULL,
+      NULL,
+      CREATE_WAITABLE_TIMER_HIGH_RESOLUTION,
+      TIMER_ALL_ACCESS);
+    if (!window->sleepTimer) {
+        window->sleepTimer =
+          CreateWaitableTimerExW(NULL, NULL, 0, TIMER_ALL_ACCESS);
+    }
+#endif
+
 #if E_ENABLE_ERROR_CALLBACK
     (void)glfwSetErrorCallback(GlfwErrorCallback);
 #endif
 
+    GLFWallocator allocator = { GlfwAlloc, GlfwRealloc, GlfwFree, NULL };
+    glfwInitAllocator(&allocator);
     if (!glfwInit()) {
         window->result = E_GLFW_FAILURE;
         return;
@@ -43,9 +171,10 @@ static void InitWindow(EWindow window, EWindowCreateInfo* infoIn) {
     glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
     window->window = glfwCreateWindow(
       infoIn->size.width, infoIn->size.height, infoIn->title, NULL, NULL);
-    if (!glfwVulkanSupported()) {
+    if (!window->window || !glfwVulkanSupported()) {
         window->result = E_GLFW_FAILURE;
     }
+    window->dirtyFrames = E_DIRTY_FRAMES;
 }
 
 // GLFW initialization
@@ -53,7 +182,7 @@ E_EXTERN void eCreateWindow(EWindow* windowOut, EWindowCreateInfo* infoIn) {
     if (!windowOut) {
         return;
     }
-    EWindow window = malloc(sizeof(*window));
+    EWindow window = eAlloc(sizeof(*window), E_MEMORY_SCOPE_WINDOW);
     if (!window) {
         *windowOut = NULL;
         return;
@@ -62,12 +191,18 @@ E_EXTERN void eCreateWindow(EWindow* windowOut, EWindowCreateInfo* infoIn) {
     *window = (struct EWindow_t){ 0 };
 
     InitWindow(window, infoIn);
+    InstallCallbacks(window);
 }
 
 // cleanup
 E_EXTERN void eDestroyWindow(EWindow window) {
+#ifdef _WIN32
+    if (window->sleepTimer) {
+        CloseHandle(window->sleepTimer);
+    }
+#endif
     glfwDestroyWindow(window->window);
-    free(window);
+    eFree(window);
     glfwTerminate();
 }
 
@@ -75,10 +210,39 @@ E_EXTERN int eWindowShouldClose(EWindow window) {
     return glfwWindowShouldClose(window->window);
 }
 
+E_EXTERN void eCloseWindow(EWindow window) {
+    glfwSetWindowShouldClose(window->window, GLFW_TRUE);
+}
+
+E_EXTERN void eSetWindowSize(EWindow window, int width, int height) {
+    glfwSetWindowSize(window->window, width, height);
+}
+
 E_EXTERN void ePollEvents(void) {
     glfwPollEvents();
 }
 
+// Sleeps until an event, a wake-up or the timeout, negative timeout waits
+// indefinitely. Callbacks invalidate the window for a few frames, waking up
+// for any other reason (wake-up, animation timeout) is worth one frame.
+E_EXTERN void eWaitEvents(EWindow window, double timeout) {
+    if (timeout < 0.0) {
+        glfwWaitEvents();
+    }
+    else {
+        glfwWaitEventsTimeout(timeout);
+    }
+    if (window->dirtyFrames < 1) {
+        window->dirtyFrames = 1;
+    }
+}
+
+// Safe to call from any thread, used by data producers after publishing
+// new data so that a waiting main loop builds a frame.
+E_EXTERN void ePostWakeUp(void) {
+    glfwPostEmptyEvent();
+}
+
 E_EXTERN int eWindowShouldResize(EWindow window) {
     int newWidth = { 0 };
     int newHeight = { 0 };
@@ -93,3 +257,60 @@ E_EXTERN int eWindowShouldResize(EWindow window) {
 E_EXTERN int eWindowIsMinimized(EWindow window) {
     return glfwGetWindowAttrib(window->window, GLFW_ICONIFIED);
 }
+
+E_EXTERN void eInvalidateWindow(EWindow window) {
+    window->dirtyFrames = E_DIRTY_FRAMES;
+}
+
+E_EXTERN int eWindowIsDirty(EWindow window) {
+    return window->dirtyFrames > 0;
+}
+
+E_EXTERN void eWindowFrameBuilt(EWindow window) {
+    if (window->dirtyFrames > 0) {
+        window->dirtyFrames--;
+    }
+}
+
+static void SleepFor(EWindow window, double seconds) {
+#ifdef _WIN32
+    LARGE_INTEGER due = { 0 };
+    // relative due time in 100ns units
+    due.QuadPart = -(LONGLONG)(seconds * 1e7);
+    if (window->sleepTimer
+        && SetWaitableTimer(window->sleepTimer, &due, 0, NULL, NULL, FALSE)) {
+        (void)WaitForSingleObject(window->sleepTimer, INFINITE);
+        return;
+    }
+    Sleep((DWORD)(seconds * 1e3));
+#else
+    (void)window;
+    struct timespec ts = {
+        .tv_sec = (time_t)seconds,
+        .tv_nsec = (long)((seconds - (double)(time_t)seconds) * 1e9),
+    };
+    while (nanosleep(&ts, &ts) == -1 && errno == EINTR) {
+    }
+#endif
+}
+
+// Sleeps until the next frame deadline of the frame rate limit. Deadlines
+// advance by a fixed interval so the rate doesn't drift, but a frame that ran
+// long resets them instead of being followed by a burst of catch up frames.
+E_EXTERN void ePaceFrame(EWindow window) {
+    if (window->frameInterval <= 0.0) {
+        return;
+    }
+    double now = glfwGetTime();
+    double remaining = window->nextFrameTime - now;
+    if (remaining > 0.0) {
+        SleepFor(window, remaining);
+        now = glfwGetTime();
+    }
+    if (now - window->nextFrameTime > window->frameInterval) {
+        window->nextFrameTime = now + window->frameInterval;
+    }
+    else {
+        window->nextFrameTime += window->frameInterval;
+    }
+}
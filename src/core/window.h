@@ -5,6 +5,14 @@
 E_EXTERN void eCreateWindow(EWindow* windowOut, EWindowCreateInfo* infoIn);
 E_EXTERN void eDestroyWindow(EWindow window);
 E_EXTERN int eWindowShouldClose(EWindow window);
+E_EXTERN void eCloseWindow(EWindow window);
+E_EXTERN void eSetWindowSize(EWindow window, int width, int height);
 E_EXTERN void ePollEvents(void);
+E_EXTERN void eWaitEvents(EWindow window, double timeout);
+E_EXTERN void ePostWakeUp(void);
+E_EXTERN void eInvalidateWindow(EWindow window);
 E_EXTERN int eWindowShouldResize(EWindow window);
 E_EXTERN int eWindowIsMinimized(EWindow window);
+E_EXTERN int eWindowIsDirty(EWindow window);
+E_EXTERN void eWindowFrameBuilt(EWindow window);
+E_EXTERN void ePaceFrame(EWindow window);
@@ -0,0 +1,233 @@
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "core.h"
+
+#include <stdlib.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+typedef HANDLE EThread;
+typedef CRITICAL_SECTION EMutex;
+typedef CONDITION_VARIABLE ECond;
+#else
+typedef pthread_t EThread;
+typedef pthread_mutex_t EMutex;
+typedef pthread_cond_t ECond;
+#endif
+
+struct EWorkerShared;
+
+struct EWorker {
+    struct EWorkerShared* shared;
+    uint32_t index;
+    EThread thread;
+};
+
+// everything the threads touch, guarded by mutex
+struct EWorkerShared {
+    EMutex mutex;
+    ECond wake;
+    ECond done;
+    EWorkFn fn;
+    void* arg;
+    uint64_t generation;  // bumped once per eRunWorkers
+    uint32_t pending;  // workers yet to finish the current generation
+    int quit;
+    uint32_t threadCount;
+    struct EWorker workers[E_MAX_RECORD_THREADS];
+};
+
+static void Lock(EMutex* mutex) {
+#ifdef _WIN32
+    EnterCriticalSection(mutex);
+#else
+    (void)pthread_mutex_lock(mutex);
+#endif
+}
+
+static void Unlock(EMutex* mutex) {
+#ifdef _WIN32
+    LeaveCriticalSection(mutex);
+#else
+    (void)pthread_mutex_unlock(mutex);
+#endif
+}
+
+static void Wait(ECond* cond, EMutex* mutex) {
+#ifdef _WIN32
+    (void)SleepConditionVariableCS(cond, mutex, INFINITE);
+#else
+    (void)pthread_cond_wait(cond, mutex);
+#endif
+}
+
+static void Broadcast(ECond* cond) {
+#ifdef _WIN32
+    WakeAllConditionVariable(cond);
+#else
+    (void)pthread_cond_broadcast(cond);
+#endif
+}
+
+static void WorkerLoop(struct EWorker* worker) {
+    struct EWorkerShared* shared = worker->shared;
+    uint64_t seen = { 0 };
+
+    Lock(&shared->mutex);
+    for (;;) {
+        while (shared->generation == seen && !shared->quit) {
+            Wait(&shared->wake, &shared->mutex);
+        }
+        if (shared->quit) {
+            break;
+        }
+        seen = shared->generation;
+        EWorkFn fn = shared->fn;
+        void* arg = shared->arg;
+        Unlock(&shared->mutex);
+
+        fn(arg, worker->index);
+
+        Lock(&shared->mutex);
+        if (--shared->pending == 0) {
+            Broadcast(&shared->done);
+        }
+    }
+    Unlock(&shared->mutex);
+}
+
+#ifdef _WIN32
+static DWORD WINAPI ThreadMain(LPVOID param) {
+    WorkerLoop(param);
+    return 0;
+}
+#else
+static void* ThreadMain(void* param) {
+    WorkerLoop(param);
+    return NULL;
+}
+#endif
+
+static int StartThread(struct EWorker* worker) {
+#ifdef _WIN32
+    worker->thread = CreateThread(NULL, 0, ThreadMain, worker, 0, NULL);
+    return worker->thread != NULL;
+#else
+    return pthread_create(&worker->thread, NULL, ThreadMain, worker) == 0;
+#endif
+}
+
+static void JoinThread(struct EWorker* worker) {
+#ifdef _WIN32
+    (void)WaitForSingleObject(worker->thread, INFINITE);
+    (void)CloseHandle(worker->thread);
+#else
+    (void)pthread_join(worker->thread, NULL);
+#endif
+}
+
+E_EXTERN uint32_t eGetCpuCount(void) {
+#ifdef _WIN32
+    SYSTEM_INFO info = { 0 };
+    GetSystemInfo(&info);
+    long count = (long)info.dwNumberOfProcessors;
+#else
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    return count > 0 ? (uint32_t)count : 1;
+}
+
+// Starts count - 1 threads, the caller of eRunWorkers is the first worker.
+E_EXTERN EResult eCreateWorkerPool(struct EWorkerPool* pool, uint32_t count) {
+    *pool = (struct EWorkerPool){ 0 };
+    count = count < 1 ? 1 : count;
+    count = count > E_MAX_RECORD_THREADS ? E_MAX_RECORD_THREADS : count;
+
+    struct EWorkerShared* shared =
+      eAlloc(sizeof(*shared), E_MEMORY_SCOPE_RENDERER);
+    if (!shared) {
+        return E_MALLOC_FAILURE;
+    }
+    *shared = (struct EWorkerShared){ 0 };
+#ifdef _WIN32
+    InitializeCriticalSection(&shared->mutex);
+    InitializeConditionVariable(&shared->wake);
+    InitializeConditionVariable(&shared->done);
+#else
+    (void)pthread_mutex_init(&shared->mutex, NULL);
+    (void)pthread_cond_init(&shared->wake, NULL);
+    (void)pthread_cond_init(&shared->done, NULL);
+#endif
+    pool->shared = shared;
+    pool->count = 1;
+
+    for (uint32_t i = 1; i < count; ++i) {
+        struct EWorker* worker = &shared->workers[shared->threadCount];
+        worker->shared = shared;
+        worker->index = i;
+        if (!StartThread(worker)) {
+            eDestroyWorkerPool(pool);
+            return E_CREATE_THREAD_FAILURE;
+        }
+        shared->threadCount++;
+        pool->count++;
+    }
+    return E_SUCCESS;
+}
+
+E_EXTERN void eDestroyWorkerPool(struct EWorkerPool* pool) {
+    struct EWorkerShared* shared = pool->shared;
+    if (!shared) {
+        return;
+    }
+    Lock(&shared->mutex);
+    shared->quit = 1;
+    Broadcast(&shared->wake);
+    Unlock(&shared->mutex);
+    for (uint32_t i = 0; i < shared->threadCount; ++i) {
+        JoinThread(&shared->workers[i]);
+    }
+#ifdef _WIN32
+    DeleteCriticalSection(&shared->mutex);
+#else
+    (void)pthread_cond_destroy(&shared->done);
+    (void)pthread_cond_destroy(&shared->wake);
+    (void)pthread_mutex_destroy(&shared->mutex);
+#endif
+    eFree(shared);
+    *pool = (struct EWorkerPool){ 0 };
+}
+
+// Calls fn(arg, i) for every i below pool->count, index 0 on the calling
+// thread, and returns once all of them returned.
+E_EXTERN void eRunWorkers(struct EWorkerPool* pool, EWorkFn fn, void* arg) {
+    struct EWorkerShared* shared = pool->shared;
+    if (!shared || pool->count < 2) {
+        fn(arg, 0);
+        return;
+    }
+    Lock(&shared->mutex);
+    shared->fn = fn;
+    shared->arg = arg;
+    shared->pending = shared->threadCount;
+    shared->generation++;
+    Broadcast(&shared->wake);
+    Unlock(&shared->mutex);
+
+    fn(arg, 0);
+
+    Lock(&shared->mutex);
+    while (shared->pending) {
+        Wait(&shared->done, &shared->mutex);
+    }
+    Unlock(&shared->mutex);
+}
@@ -1,5 +1,6 @@
 #pragma once
 #include "../../config.h"
+#include <stddef.h>
 #include <stdint.h>
 
 #ifdef __cplusplus
@@ -33,6 +34,17 @@ typedef enum EResult {
     E_CREATE_DESCRIPTOR_SET_LAYOUT_FAILURE,
     E_CREATE_PIPELINE_LAYOUT_FAILURE,
     E_CREATE_PIPELINE_FAILURE,
+    E_CREATE_SHADER_MODULE_FAILURE,
+    E_CREATE_BUFFER_FAILURE,
+    E_ALLOCATE_MEMORY_FAILURE,
+    E_MAP_MEMORY_FAILURE,
+    E_CREATE_IMAGE_FAILURE,
+    E_ALLOCATE_DESCRIPTOR_SET_FAILURE,
+    E_UPLOAD_FAILURE,
+    E_CREATE_THREAD_FAILURE,
+    E_ATLAS_FULL,
+    E_LOAD_FONT_FAILURE,
+    E_UNEXPECTED_HOST_ALLOCATION,
 
     E_CREATE_INFO_MISSING,
     E_CREATE_INFO_MISSING_VALUE,
@@ -53,6 +65,76 @@ E_OPAQUE_HANDLE(EWindow);
 E_OPAQUE_HANDLE(EDisplay);
 E_OPAQUE_HANDLE(ERenderer);
 E_OPAQUE_HANDLE(ETexture);
+E_OPAQUE_HANDLE(EIconAtlas);
+E_OPAQUE_HANDLE(EGlyphCache);
+E_OPAQUE_HANDLE(EHostTracker);
+E_OPAQUE_HANDLE(EHostPool);
+E_OPAQUE_HANDLE(EHostArena);
+
+// what host memory is for, EHostTracker keeps its stats per scope
+typedef enum EMemoryScope {
+    E_MEMORY_SCOPE_CONTEXT = 0,
+    E_MEMORY_SCOPE_WINDOW,  // GLFW included
+    E_MEMORY_SCOPE_DISPLAY,
+    E_MEMORY_SCOPE_RENDERER,
+    E_MEMORY_SCOPE_TEXTURE,  // textures, icon atlases and glyph caches
+    E_MEMORY_SCOPE_VULKAN,  // the driver, through VkAllocationCallbacks
+    E_MEMORY_SCOPE_IMGUI,
+    E_MEMORY_SCOPE_COUNT,
+} EMemoryScope;
+
+// Host memory of the core, GLFW, the Vulkan driver and imgui, installed
+// with eSetHostAllocator. Alignment is a power of two. realloc gets memory
+// from alloc with the alignment it was made with and a nonzero size, and
+// leaves the memory alone when it fails. free never gets NULL. Any thread
+// may call them.
+typedef struct EHostAllocator {
+    void* (*alloc)(void* userData,
+      size_t size,
+      size_t alignment,
+      EMemoryScope scope);
+    void* (*realloc)(void* userData,
+      void* memory,
+      size_t size,
+      size_t alignment);
+    void (*free)(void* userData, void* memory);
+    void* userData;
+} EHostAllocator;
+
+typedef struct EHostTrackerCreateInfo {
+    const EHostAllocator* parent;  // NULL picks the default allocator
+} EHostTrackerCreateInfo;
+
+// Allocations of at most objectSize bytes come from chunks of slots, bigger
+// or more aligned ones from the parent.
+typedef struct EHostPoolCreateInfo {
+    const EHostAllocator* parent;  // NULL picks the default allocator
+    size_t objectSize;
+    uint32_t objectsPerChunk;  // 0 picks 64
+} EHostPoolCreateInfo;
+
+// Bump allocation from one buffer, freeing is a no-op except for the last
+// allocation. Allocations that don't fit come from the parent.
+typedef struct EHostArenaCreateInfo {
+    const EHostAllocator* parent;  // NULL picks the default allocator
+    size_t size;
+} EHostArenaCreateInfo;
+
+typedef struct EHostMemoryStats {
+    uint64_t bytes[E_MEMORY_SCOPE_COUNT];  // live
+    uint64_t count[E_MEMORY_SCOPE_COUNT];  // live
+    // alloc and realloc calls so far
+    uint64_t allocations[E_MEMORY_SCOPE_COUNT];
+    // the ones made in a scope eExpectNoHostAllocations named
+    uint64_t unexpectedAllocations;
+} EHostMemoryStats;
+
+typedef enum EPresentMode {
+    E_PRESENT_MODE_FIFO = 0,
+    E_PRESENT_MODE_FIFO_RELAXED,
+    E_PRESENT_MODE_MAILBOX,
+    E_PRESENT_MODE_IMMEDIATE,
+} EPresentMode;
 
 typedef struct EWindowCreateInfo {
     const char* title;
@@ -60,16 +142,218 @@ typedef struct EWindowCreateInfo {
         int width;
         int height;
     } size;
+    // preferred, falls back towards FIFO when the surface lacks support
+    EPresentMode presentMode;
+    // CPU side frame limit in frames per second, 0 disables pacing
+    double frameRateLimit;
+    // frames the CPU may record ahead of the GPU, 0 picks the default
+    uint32_t framesInFlight;
 } EWindowCreateInfo;
 
+typedef struct EOffscreenDisplayCreateInfo {
+    int width;
+    int height;
+    // frames the CPU may record ahead of the GPU, 0 picks the default
+    uint32_t framesInFlight;
+} EOffscreenDisplayCreateInfo;
+
+typedef struct ETextureCreateInfo {
+    // tightly packed RGBA8, or one byte each when alphaOnly, may be NULL when
+    // dynamic
+    const void* pixels;
+    uint32_t width;
+    uint32_t height;
+    // Texels are coverage drawn as white with that alpha, a quarter of the
+    // memory of RGBA8 for fonts and glyphs.
+    int alphaOnly;
+    // alpha, or the one channel, holds a distance field like
+    // eBuildDistanceField makes, drawn with a shader that keeps its edges
+    // sharp at any scale
+    int distanceField;
+    // Updated with eUpdateTexture while drawn. Without pixels it starts out
+    // transparent.
+    int dynamic;
+    // Called when the renderer wants the memory back from a texture that
+    // wasn't drawn for a while. Returning nonzero hands the texture over,
+    // the owner forgets it and makes a new one once it is needed again, the
+    // renderer retires it. NULL keeps the texture resident.
+    int (*evict)(void* userData, ETexture texture);
+    void* evictUserData;
+} ETextureCreateInfo;
+
+// part of a dynamic texture replaced by eUpdateTexture
+typedef struct ETextureRegion {
+    const void* pixels;  // in the texture's format
+    uint32_t pitch;  // bytes from one row of pixels to the next
+    uint32_t x;
+    uint32_t y;
+    uint32_t width;
+    uint32_t height;
+} ETextureRegion;
+
+typedef struct EIconAtlasCreateInfo {
+    ERenderer renderer;
+    uint32_t pageSize;  // width and height of a page, 0 picks 1024
+} EIconAtlasCreateInfo;
+
+// where an icon currently is, ImGui::Image arguments
+typedef struct EIconUv {
+    uint64_t textureId;
+    float uv0[2];
+    float uv1[2];
+} EIconUv;
+
+typedef struct EGlyphCacheCreateInfo {
+    ERenderer renderer;
+    const void* fontData;  // TrueType file, must outlive the cache
+    float pixelHeight;  // from the highest ascender to the lowest descender
+    uint32_t pageSize;  // width and height of a page, 0 picks 512
+    // Bytes of page textures, past it the least recently used page is
+    // evicted. 0 picks 4 MiB.
+    uint64_t memoryBudget;
+} EGlyphCacheCreateInfo;
+
+// Where to draw a glyph, relative to the pen at the top left of the line.
+// The rect is empty for glyphs without pixels.
+typedef struct EGlyphQuad {
+    uint64_t textureId;  // 0 while the glyph isn't drawable yet
+    float rect[4];  // min x, min y, max x, max y
+    float uv0[2];
+    float uv1[2];
+    float advance;
+} EGlyphQuad;
+
+typedef enum EVertexFormat {
+    E_VERTEX_FORMAT_FLOAT2 = 0,
+    E_VERTEX_FORMAT_HALF2,
+    E_VERTEX_FORMAT_UNORM16X2,  // 16 bit fixed point in [0, 1]
+    E_VERTEX_FORMAT_UNORM8X4,
+} EVertexFormat;
+
+// position, uv and color, in that order
 struct EImguiVertData {
     const uint32_t* inputAttrOffsets;
+    const EVertexFormat* inputAttrFormats;
     uint32_t inputAttrCount;
     uint32_t inputAttrSize;
+    uint32_t indexSize;
 };
 
 typedef struct ERendererCreateInfo {
     EContext context;
     EDisplay display;
     struct EImguiVertData imguiVertData;
+    uint32_t recordThreads;  // 0 picks one per core
+    // of the memory budget, past it idle evictable textures are evicted,
+    // 0 picks 0.9
+    float residencyFraction;
 } ERendererCreateInfo;
+
+// One rect of a sheet grid, drawn as an instance of a single quad instead
+// of tessellated imgui geometry. Colors are packed like ImU32.
+typedef struct ECellRect {
+    float rect[4];  // min x, min y, max x, max y
+    uint32_t fill;
+    uint32_t border;  // drawn inside the rect
+    float radius;  // at most half the shorter side
+    float borderWidth;
+} ECellRect;
+
+// C view of ImDrawData, filled by the imgui layer every frame
+struct EDrawCmd {
+    float clipRect[4];
+    uint64_t textureId;
+    uint32_t vtxOffset;
+    uint32_t idxOffset;
+    uint32_t elemCount;
+    // nonzero for a command drawing cells instead of indexed geometry
+    uint32_t cellCount;
+    const ECellRect* cells;
+};
+
+struct EDrawList {
+    const void* vtxData;
+    const void* idxData;
+    const struct EDrawCmd* cmds;
+    uint32_t vtxCount;
+    uint32_t idxCount;
+    uint32_t cmdCount;
+};
+
+typedef struct EDrawData {
+    const struct EDrawList* lists;
+    uint32_t listCount;
+    uint32_t totalVtxCount;
+    uint32_t totalIdxCount;
+    uint32_t totalCellCount;
+    float displayPos[2];
+    float displaySize[2];
+    float framebufferScale[2];
+} EDrawData;
+
+typedef struct ERendererStats {
+    uint64_t bytesUploaded;
+    uint64_t frameBytesUploaded;
+    uint32_t bufferReallocations;
+    uint64_t frameRecordNanoseconds;  // CPU time recording the draw data
+    uint32_t frameRecordThreads;  // 1 when recorded inline
+    // Without culling and merging every command was one draw and one
+    // scissor set, frameDrawCmds compares against the recorded counts.
+    uint32_t frameDrawCmds;
+    uint32_t frameDraws;
+    uint32_t frameScissorSets;
+    uint32_t frameTextureBinds;
+    uint32_t texturesEvicted;
+    // building the pipelines in eCreateRenderer, what the cache shortens
+    uint64_t pipelineCreateNanoseconds;
+} ERendererStats;
+
+// draw lists past the last timed one count towards it
+#define E_MAX_TIMED_DRAW_LISTS 32
+
+typedef enum ECpuPhase {
+    E_CPU_PHASE_POLL = 0,
+    E_CPU_PHASE_BUILD,  // building the imgui frame
+    E_CPU_PHASE_RECORD,
+    E_CPU_PHASE_SUBMIT,
+    E_CPU_PHASE_PRESENT,
+    E_CPU_PHASE_COUNT,
+} ECpuPhase;
+
+typedef struct EFrameTimings {
+    // of the last presented frame
+    uint64_t cpuNanoseconds[E_CPU_PHASE_COUNT];
+    // of the last frame the GPU finished, which trails the CPU timings by
+    // the frames in flight, zero while gpuValid is 0
+    int gpuValid;
+    uint64_t gpuNanoseconds;  // whole command buffer
+    uint64_t gpuListNanoseconds[E_MAX_TIMED_DRAW_LISTS];
+    uint32_t gpuListCount;
+} EFrameTimings;
+
+// device memory held by the context's allocator
+typedef struct EMemoryStats {
+    uint32_t blockCount;
+    uint64_t blockBytes;
+    uint32_t allocationCount;  // placed in blocks
+    uint64_t allocatedBytes;
+    // allocations too big for a block, each with memory of its own
+    uint32_t dedicatedCount;
+    uint64_t dedicatedBytes;
+} EMemoryStats;
+
+// device local memory summed over its heaps, what the process may use
+// without the driver paging and what it uses
+typedef struct EMemoryBudget {
+    uint64_t budget;
+    // Leaves out the unused parts of the allocator's blocks, allocations go
+    // there before more memory is requested.
+    uint64_t usage;
+    int estimated;  // without VK_EXT_memory_budget, from heap sizes
+} EMemoryBudget;
+
+typedef struct EDisplayStats {
+    uint64_t renderedFrames;
+    uint64_t skippedFrames;
+    uint64_t processCpuNanoseconds;  // all threads, user and kernel time
+} EDisplayStats;
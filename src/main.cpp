@@ -1,14 +1,51 @@
 #include "app.hpp"
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <string>
 
-auto main() -> int {
+namespace {
+auto Usage(const char* program) -> int {
+    (void)std::fprintf(stderr, "Usage: %s [--headless <frames>]\n", program);
+    return 1;
+}
+
+// a whole positive count, nothing before or after the digits
+auto ParseFrames(const char* text, uint32_t* framesOut) -> bool {
+    if (*text < '0' || *text > '9') {
+        return false;
+    }
+    char* end{ nullptr };
+    errno = 0;
+    unsigned long frames = std::strtoul(text, &end, 10);
+    if (errno != 0 || *end != '\0' || frames == 0 || frames > UINT32_MAX) {
+        return false;
+    }
+    *framesOut = static_cast<uint32_t>(frames);
+    return true;
+}
+}  // namespace
+
+auto main(int argc, char** argv) -> int {
     AppCreateInfo aci{};
     aci.title = "Tymek";
     aci.size = { 1280, 720 };
+    // --headless <frames> renders offscreen, without a window
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--headless") != 0) {
+            continue;
+        }
+        if (i + 1 == argc || !ParseFrames(argv[i + 1], &aci.headlessFrames)) {
+            return Usage(argv[0]);
+        }
+        ++i;
+    }
     try {
         App app(aci);
     } catch (std::exception& err) {
         return std::stoi(err.what());
     }
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,146 @@
+#include "record_benchmark.hpp"
+
+#include "display.h"
+#include "renderer.h"
+#include "window.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <numeric>
+
+
+namespace {
+const uint32_t threadCounts[] = { 1, 2, 4, 8 };
+constexpr int configCount = sizeof(threadCounts) / sizeof(*threadCounts);
+}  // namespace
+
+RecordBenchmark::RecordBenchmark(EWindow window,
+  EDisplay display,
+  ERenderer renderer)
+    : m_window(window), m_display(display), m_renderer(renderer) {
+    m_recordTimes.resize(configCount);
+    BuildDrawData();
+}
+
+// Every list draws the same 1000 small quads, each with its own command, so
+// recording cost and not fill rate dominates. The commands visit the quads
+// out of order, so the renderer can't merge them into one draw.
+void RecordBenchmark::BuildDrawData() {
+    const ImGuiIO& io = ImGui::GetIO();
+    ImVec2 uv = io.Fonts->TexUvWhitePixel;
+    ImU32 col = IM_COL32(255, 255, 255, 8);
+    for (int i = 0; i < s_cmdsPerList; ++i) {
+        float x = static_cast<float>(i % 40) * 20.f;
+        float y = static_cast<float>(i / 40) * 20.f;
+        auto base = static_cast<ImDrawIdx>(m_vertices.size());
+        m_vertices.push_back({ { x, y }, uv, col });
+        m_vertices.push_back({ { x + 16, y }, uv, col });
+        m_vertices.push_back({ { x + 16, y + 16 }, uv, col });
+        m_vertices.push_back({ { x, y + 16 }, uv, col });
+        for (int idx : { 0, 1, 2, 0, 2, 3 }) {
+            m_indices.push_back(static_cast<ImDrawIdx>(base + idx));
+        }
+    }
+
+    m_cmds.resize(static_cast<size_t>(s_listCount) * s_cmdsPerList);
+    for (size_t i = 0; i < m_cmds.size(); ++i) {
+        EDrawCmd& dc = m_cmds[i];
+        // clipped to the framebuffer, so always visible
+        dc.clipRect[0] = 0.f;
+        dc.clipRect[1] = 0.f;
+        dc.clipRect[2] = 1e6f;
+        dc.clipRect[3] = 1e6f;
+        dc.textureId = io.Fonts->TexID;
+        // 7 is coprime to the command count, every quad is still drawn once
+        dc.idxOffset = static_cast<uint32_t>((i * 7) % s_cmdsPerList) * 6;
+        dc.elemCount = 6;
+    }
+
+    m_lists.resize(s_listCount);
+    for (int i = 0; i < s_listCount; ++i) {
+        EDrawList& dl = m_lists[i];
+        dl.vtxData = m_vertices.data();
+        dl.vtxCount = static_cast<uint32_t>(m_vertices.size());
+        dl.idxData = m_indices.data();
+        dl.idxCount = static_cast<uint32_t>(m_indices.size());
+        dl.cmds = m_cmds.data() + static_cast<size_t>(i) * s_cmdsPerList;
+        dl.cmdCount = s_cmdsPerList;
+    }
+    m_drawData.lists = m_lists.data();
+    m_drawData.listCount = s_listCount;
+    m_drawData.totalVtxCount =
+      static_cast<uint32_t>(m_vertices.size()) * s_listCount;
+    m_drawData.totalIdxCount =
+      static_cast<uint32_t>(m_indices.size()) * s_listCount;
+}
+
+void RecordBenchmark::Step() {
+    constexpr int framesPerConfig = s_warmupFrames + s_frames;
+
+    // stats describe the frame rendered since the previous step, frames that
+    // were skipped or dropped for a resize don't count
+    EDisplayStats displayStats{};
+    eGetDisplayStats(m_display, &displayStats);
+    if (m_step > 0 && displayStats.renderedFrames != m_renderedFrames) {
+        int config = (m_step - 1) / framesPerConfig;
+        int frame = (m_step - 1) % framesPerConfig;
+        ERendererStats stats{};
+        eGetRendererStats(m_renderer, &stats);
+        if (config < configCount && frame >= s_warmupFrames) {
+            m_recordTimes[config].push_back(
+              static_cast<double>(stats.frameRecordNanoseconds) / 1e6);
+        }
+    }
+    m_renderedFrames = displayStats.renderedFrames;
+
+    int config = m_step / framesPerConfig;
+    if (config == configCount) {
+        Report();
+        eCloseWindow(m_window);
+        ++m_step;
+        return;
+    }
+    if (config > configCount) {
+        return;
+    }
+    if (m_step % framesPerConfig == 0) {
+        eSetRecordThreads(m_renderer, threadCounts[config]);
+    }
+
+    const ImGuiIO& io = ImGui::GetIO();
+    m_drawData.displaySize[0] = io.DisplaySize.x;
+    m_drawData.displaySize[1] = io.DisplaySize.y;
+    m_drawData.framebufferScale[0] = io.DisplayFramebufferScale.x;
+    m_drawData.framebufferScale[1] = io.DisplayFramebufferScale.y;
+    // a changing clip rect keeps the frame from being skipped as identical
+    m_cmds[0].clipRect[2] = (m_step % 2) != 0 ? 1e6f : 1e5f;
+
+    eSetDrawData(m_renderer, &m_drawData);
+    eInvalidateWindow(m_window);
+    ++m_step;
+}
+
+void RecordBenchmark::Report() const {
+    (void)std::printf("Record benchmark, %d draw commands:\n",
+      s_listCount * s_cmdsPerList);
+    double baseline = 0.0;
+    for (int i = 0; i < configCount; ++i) {
+        std::vector<double> sorted = m_recordTimes[i];
+        if (sorted.empty()) {
+            continue;
+        }
+        std::sort(sorted.begin(), sorted.end());
+        double mean = std::accumulate(sorted.begin(), sorted.end(), 0.0)
+                      / static_cast<double>(sorted.size());
+        double median = sorted[sorted.size() / 2];
+        if (i == 0) {
+            baseline = median;
+        }
+        (void)std::printf(
+          "\t%u threads: mean %.3f ms, median %.3f ms, speedup %.2fx\n",
+          threadCounts[i],
+          mean,
+          median,
+          median > 0.0 ? baseline / median : 0.0);
+    }
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include "../graphics.h"
+
+#include <imgui.h>
+
+#include <vector>
+
+// Replaces the imgui draw data with a synthetic frame of 50k draw commands
+// and renders it with 1, 2, 4 and 8 recording threads in turn, then reports
+// the CPU time spent recording for each.
+class RecordBenchmark {
+public:
+    RecordBenchmark(EWindow window, EDisplay display, ERenderer renderer);
+
+    // called once per main loop iteration after the imgui frame was built,
+    // closes the window when finished
+    void Step();
+
+private:
+    void BuildDrawData();
+    void Report() const;
+
+    static constexpr int s_listCount{ 50 };
+    static constexpr int s_cmdsPerList{ 1000 };
+    static constexpr int s_warmupFrames{ 10 };
+    static constexpr int s_frames{ 100 };
+
+    EWindow m_window{ nullptr };
+    EDisplay m_display{ nullptr };
+    ERenderer m_renderer{ nullptr };
+    std::vector<ImDrawVert> m_vertices;
+    std::vector<ImDrawIdx> m_indices;
+    std::vector<EDrawCmd> m_cmds;
+    std::vector<EDrawList> m_lists;
+    EDrawData m_drawData{};
+    std::vector<std::vector<double>> m_recordTimes;
+    uint64_t m_renderedFrames{ 0 };
+    int m_step{ 0 };
+};
@@ -0,0 +1,58 @@
+#include "resize_benchmark.hpp"
+
+#include "window.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <numeric>
+
+
+ResizeBenchmark::ResizeBenchmark(EWindow window) : m_window(window) {
+    m_frameTimes.reserve(s_sizeCount);
+}
+
+void ResizeBenchmark::Step() {
+    auto now = std::chrono::steady_clock::now();
+    if (m_step > 0) {
+        m_frameTimes.push_back(
+          std::chrono::duration<double, std::milli>(now - m_last).count());
+    }
+    m_last = now;
+
+    if (m_step == s_sizeCount) {
+        Report();
+        eCloseWindow(m_window);
+        ++m_step;
+        return;
+    }
+    if (m_step > s_sizeCount) {
+        return;
+    }
+    // coprime strides walk both axes through their whole range
+    int width = 400 + (m_step * 53) % 1200;
+    int height = 300 + (m_step * 31) % 700;
+    eSetWindowSize(m_window, width, height);
+    ++m_step;
+}
+
+void ResizeBenchmark::Report() const {
+    if (m_frameTimes.empty()) {
+        return;
+    }
+    std::vector<double> sorted = m_frameTimes;
+    std::sort(sorted.begin(), sorted.end());
+
+    double mean = std::accumulate(sorted.begin(), sorted.end(), 0.0)
+                  / static_cast<double>(sorted.size());
+    double median = sorted[sorted.size() / 2];
+    double p99 = sorted[(sorted.size() * 99) / 100];
+    auto spikes = std::count_if(sorted.begin(), sorted.end(), [&](double t) {
+        return t > 2.0 * median;
+    });
+
+    (void)std::printf("Resize benchmark, %zu frames:\n", sorted.size());
+    (void)std::printf("\tmean %.3f ms, median %.3f ms\n", mean, median);
+    (void)std::printf("\tp99 %.3f ms, max %.3f ms\n", p99, sorted.back());
+    (void)std::printf(
+      "\tspikes over 2x median: %d\n", static_cast<int>(spikes));
+}
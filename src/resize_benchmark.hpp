@@ -0,0 +1,26 @@
+#pragma once
+#include "../graphics.h"
+
+#include <chrono>
+#include <vector>
+
+// Drags the window through a fixed sequence of sizes, one per frame, and
+// reports frame times once done. Frame time spikes show swapchain recreation
+// stalls.
+class ResizeBenchmark {
+public:
+    explicit ResizeBenchmark(EWindow window);
+
+    // called once per main loop iteration, closes the window when finished
+    void Step();
+
+private:
+    void Report() const;
+
+    static constexpr int s_sizeCount{ 200 };
+
+    EWindow m_window{ nullptr };
+    std::vector<double> m_frameTimes;
+    std::chrono::steady_clock::time_point m_last;
+    int m_step{ 0 };
+};